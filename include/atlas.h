@@ -0,0 +1,75 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "surface.h"
+
+// Sprite atlas: every sprite image packed into one RGB565 texture with a
+// matching 8-bit alpha plane, so blits of any sprite read from a single
+// contiguous allocation. Packing happens once, at load time, with a
+// skyline packer (tallest sprites first, each placed where it rests
+// lowest). Sprites keep a transparent 1-pixel gutter on their right and
+// bottom edges so filtered sampling never picks up a neighbour.
+//
+// Sprite lists (.hws) are text files, one sprite per line:
+//   name path
+// where path is a binary PPM (P6) or a TGA (truecolour, raw or RLE)
+// relative to the list. Blank lines and lines starting with '#' are
+// skipped. TGA alpha is kept; in PPM images pure magenta is transparent.
+
+#define ATLAS_MAX_SIZE 4096
+#define ATLAS_MAX_SPRITES 1024
+#define ATLAS_NAME_MAX 32
+
+struct atlas_sprite {
+    char name[ATLAS_NAME_MAX];
+    int x, y;                 // Top-left corner in the atlas
+    int width, height;
+};
+
+struct atlas {
+    int width, height;
+    uint16_t *pixels;         // width * height, row by row
+    uint8_t *alpha;           // Same layout; 0 is transparent, 255 opaque
+    struct atlas_sprite *sprites;
+    int sprite_count;
+};
+
+// Source image for atlas_pack; alpha may be NULL for opaque images
+struct atlas_image {
+    const char *name;
+    int width, height;
+    const uint16_t *pixels;
+    const uint8_t *alpha;
+};
+
+// Pack images into a new atlas, placing the tallest first; sprite indices
+// follow the order given. Returns false and leaves atlas zeroed if they do
+// not fit or memory runs out
+bool atlas_pack(struct atlas *atlas, const struct atlas_image *images, int count);
+
+// Load and pack the images named in a sprite list
+bool atlas_load(struct atlas *atlas, const char *path);
+
+void atlas_free(struct atlas *atlas);
+
+// Index of the sprite with this name, or -1
+int atlas_find(const struct atlas *atlas, const char *name);
+
+// Draw a sprite with its top-left corner at (x, y). Pixels with alpha
+// below 128 are skipped.
+void atlas_blit(const struct surface *target, const struct atlas *atlas, int sprite, int x, int y);
+
+// Same, blended by the sprite's alpha times opacity (0-255)
+void atlas_blit_blend(const struct surface *target, const struct atlas *atlas, int sprite,
+                      int x, int y, uint8_t opacity);
+
+// Draw a sprite scaled by scale and rotated by angle (radians, clockwise
+// on screen) about its centre, which lands at (cx, cy). Each destination
+// pixel inside the rotated bounding box is mapped back into the sprite
+// with 16.16 steps, nearest neighbour; alpha below 128 is skipped.
+void atlas_blit_affine(const struct surface *target, const struct atlas *atlas, int sprite,
+                       float cx, float cy, float angle, float scale);
+
+#endif // ATLAS_H
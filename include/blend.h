@@ -0,0 +1,44 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "simd.h"
+
+// RGB565 blending. Weights are 8-bit (0 keeps dst, 255 replaces it);
+// channels are unpacked into 16-bit vector lanes, moved towards the
+// source by the weight and repacked. In blend565_fill_span, and in
+// blend565_span for opaque pixels, an alpha or opacity of exactly 128 is an
+// exact 50% mix done with bit tricks on the packed pixels.
+
+// Blend in approximately linear light (gamma 2.0) instead of directly on
+// the stored values. Off by default; applies to every function below.
+void blend565_set_gamma(bool enabled);
+
+// Blend color over count RGB565 pixels, weighting each pixel by its 8-bit
+// coverage (0 keeps dst, 255 replaces it with color)
+void blend565_coverage_span(uint16_t *dst, const uint8_t *coverage, uint16_t color, int count);
+
+// Blend color over count pixels with one alpha for all of them
+void blend565_fill_span(uint16_t *dst, uint16_t color, uint8_t alpha, int count);
+
+// Blend src over dst, weighting each pixel by its alpha times opacity
+// (both 0-255)
+void blend565_span(uint16_t *dst, const uint16_t *src, const uint8_t *alpha,
+                   uint8_t opacity, int count);
+
+// Exact 50% mix of two RGB565 pixels without unpacking: halve each
+// channel of the differing bits (the mask drops the bit that would cross
+// into the next channel). Same result as blending at a weight of 128.
+static inline uint16_t blend565_half(uint16_t a, uint16_t b) {
+    return (uint16_t)((a & b) + (((a ^ b) & 0xF7DE) >> 1));
+}
+
+#ifdef HAVE_SSE2
+static inline __m128i blend565_half_sse2(__m128i a, __m128i b) {
+    __m128i diff = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi16((short)0xF7DE));
+    return _mm_add_epi16(_mm_and_si128(a, b), _mm_srli_epi16(diff, 1));
+}
+#endif
+
+#endif // BLEND_H
@@ -0,0 +1,29 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include <libretro.h>
+#include "surface.h"
+
+// On-screen log console. Lines live in a fixed ring buffer; the console
+// keeps its own pixel buffer so a new line costs one memmove of the rows
+// plus rasterizing that single line.
+#define CONSOLE_WIDTH      320  // Pixels, matches the core's framebuffer
+#define CONSOLE_HEIGHT     80
+#define CONSOLE_HISTORY    128  // Lines kept for scrollback
+#define CONSOLE_LINE_BYTES 256
+
+// Append a log message; it is split on '\n' and wrapped to the console width
+void console_push(enum retro_log_level level, const char *msg);
+
+// Scroll the view by lines (positive scrolls back to older lines)
+void console_scroll(int lines);
+
+// Copy the console onto an RGB565 surface with its bottom edge at bottom,
+// clipped to the surface's scissor
+void console_blit(const struct surface *dst, int bottom);
+
+// Drop every line
+void console_clear(void);
+
+#endif // CONSOLE_H
@@ -0,0 +1,10 @@
+#ifndef CORE_LOG_H
+#define CORE_LOG_H
+
+#include <libretro.h>
+
+// Log through the frontend's log interface when available, otherwise to
+// core.log and stderr. Shared by every translation unit of the core.
+void core_log(enum retro_log_level level, const char *fmt, ...);
+
+#endif // CORE_LOG_H
@@ -0,0 +1,30 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Runtime CPU feature detection for picking SIMD kernels
+#define CPU_FEATURE_SSE2  (1u << 0)
+#define CPU_FEATURE_SSSE3 (1u << 1)
+#define CPU_FEATURE_SSE41 (1u << 2)
+#define CPU_FEATURE_AVX2  (1u << 3)
+
+// Features usable on this machine (CPU and OS support); detected once
+unsigned cpu_features(void);
+
+// Number of online logical CPUs, at least 1
+int cpu_count(void);
+
+// Mark a function as compiled for AVX2 so it can live next to baseline code
+// and be selected at run time. MSVC accepts AVX2 intrinsics without it.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Compilers able to build the AVX2 kernels alongside the baseline code
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+    (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#define HAVE_AVX2_KERNELS 1
+#endif
+
+#endif // CPU_H
@@ -0,0 +1,44 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include <stdint.h>
+#include "surface.h"
+
+// 2D primitives for RGB565 surfaces. Every shape is clipped to the
+// surface's scissor and reduced to horizontal spans, which are filled 8
+// pixels at a time.
+
+// Largest circle/ellipse radius; larger radii are clamped
+#define DRAW_MAX_RADIUS 4096
+
+struct draw_point {
+    int x, y;
+};
+
+// Fill pixels x0..x1 (inclusive, either order) of row y
+void draw_span(const struct surface *dst, int x0, int x1, int y, uint16_t color);
+
+// Fill a width x height rectangle with its top-left corner at (x, y)
+void draw_rect(const struct surface *dst, int x, int y, int width, int height, uint16_t color);
+
+// Same rectangle blended over the surface with alpha 0-255 (see blend.h)
+void draw_rect_blend(const struct surface *dst, int x, int y, int width, int height,
+                     uint16_t color, uint8_t alpha);
+
+// Bresenham line from (x0, y0) to (x1, y1), both ends included
+void draw_line(const struct surface *dst, int x0, int y0, int x1, int y1, uint16_t color);
+
+// Midpoint circle and ellipse outlines and fills centred on (cx, cy)
+void draw_circle(const struct surface *dst, int cx, int cy, int r, uint16_t color);
+void draw_circle_fill(const struct surface *dst, int cx, int cy, int r, uint16_t color);
+void draw_ellipse(const struct surface *dst, int cx, int cy, int rx, int ry, uint16_t color);
+void draw_ellipse_fill(const struct surface *dst, int cx, int cy, int rx, int ry, uint16_t color);
+
+// Closed polygon outline, and even-odd scanline fill sampled at pixel
+// centres (so polygons sharing an edge never overlap)
+void draw_polygon(const struct surface *dst, const struct draw_point *points, int count,
+                  uint16_t color);
+void draw_polygon_fill(const struct surface *dst, const struct draw_point *points, int count,
+                       uint16_t color);
+
+#endif // DRAW_H
@@ -0,0 +1,23 @@
+#ifndef DRAW_AA_H
+#define DRAW_AA_H
+
+#include <stdint.h>
+#include "surface.h"
+
+// Anti-aliased shapes for RGB565 surfaces. Coordinates are in pixels with
+// pixel (x, y) covering [x, x + 1) x [y, y + 1), so its centre is at
+// (x + 0.5, y + 0.5). Each shape computes 8-bit coverage one row span at a
+// time and blends the span in one call.
+
+// One-pixel-wide Wu line from (x0, y0) to (x1, y1)
+void draw_aa_line(const struct surface *dst, float x0, float y0, float x1, float y1, uint16_t color);
+
+// Filled circle and ellipse with analytic edge coverage
+void draw_aa_circle_fill(const struct surface *dst, float cx, float cy, float r, uint16_t color);
+void draw_aa_ellipse_fill(const struct surface *dst, float cx, float cy, float rx, float ry,
+                          uint16_t color);
+
+// Circle outline of the given stroke width, centred on radius r
+void draw_aa_ring(const struct surface *dst, float cx, float cy, float r, float width, uint16_t color);
+
+#endif // DRAW_AA_H
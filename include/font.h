@@ -2,199 +2,86 @@
 #define FONT_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "mapfile.h"
+#include "sdf.h"
 
-// 8x8 font data for ASCII characters 32-126
-static const uint8_t font_8x8[95][8] = {
-    // Space (32)
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    // ! (33)
-    {0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x18, 0x00},
-    // " (34)
-    {0x6C, 0x6C, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00},
-    // # (35)
-    {0x6C, 0x6C, 0xFE, 0x6C, 0xFE, 0x6C, 0x6C, 0x00},
-    // $ (36)
-    {0x30, 0x7C, 0xC0, 0x78, 0x0C, 0xF8, 0x30, 0x00},
-    // % (37)
-    {0x00, 0xC6, 0xCC, 0x18, 0x30, 0x66, 0xC6, 0x00},
-    // & (38)
-    {0x38, 0x6C, 0x38, 0x76, 0xDC, 0xCC, 0x76, 0x00},
-    // ' (39)
-    {0x18, 0x18, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00},
-    // ( (40)
-    {0x0C, 0x18, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00},
-    // ) (41)
-    {0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x18, 0x30, 0x00},
-    // * (42)
-    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},
-    // + (43)
-    {0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00},
-    // , (44)
-    {0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x30, 0x00},
-    // - (45)
-    {0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00},
-    // . (46)
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00},
-    // / (47)
-    {0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x80, 0x00},
-    // 0 (48)
-    {0x7C, 0xC6, 0xCE, 0xD6, 0xE6, 0xC6, 0x7C, 0x00},
-    // 1 (49)
-    {0x18, 0x38, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x00},
-    // 2 (50)
-    {0x7C, 0xC6, 0x06, 0x3C, 0x60, 0xC0, 0xFE, 0x00},
-    // 3 (51)
-    {0x7C, 0xC6, 0x06, 0x3C, 0x06, 0xC6, 0x7C, 0x00},
-    // 4 (52)
-    {0x0C, 0x1C, 0x3C, 0x6C, 0xCC, 0xFE, 0x0C, 0x00},
-    // 5 (53)
-    {0xFE, 0xC0, 0xC0, 0xFC, 0x06, 0xC6, 0x7C, 0x00},
-    // 6 (54)
-    {0x7C, 0xC6, 0xC0, 0xFC, 0xC6, 0xC6, 0x7C, 0x00},
-    // 7 (55)
-    {0xFE, 0xC6, 0x0C, 0x18, 0x30, 0x30, 0x30, 0x00},
-    // 8 (56)
-    {0x7C, 0xC6, 0xC6, 0x7C, 0xC6, 0xC6, 0x7C, 0x00},
-    // 9 (57)
-    {0x7C, 0xC6, 0xC6, 0x7E, 0x06, 0xC6, 0x7C, 0x00},
-    // : (58)
-    {0x00, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00},
-    // ; (59)
-    {0x00, 0x18, 0x18, 0x00, 0x18, 0x18, 0x30, 0x00},
-    // < (60)
-    {0x0C, 0x18, 0x30, 0x60, 0x30, 0x18, 0x0C, 0x00},
-    // = (61)
-    {0x00, 0x00, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00},
-    // > (62)
-    {0x30, 0x18, 0x0C, 0x06, 0x0C, 0x18, 0x30, 0x00},
-    // ? (63)
-    {0x7C, 0xC6, 0x0C, 0x18, 0x18, 0x00, 0x18, 0x00},
-    // @ (64)
-    {0x7C, 0xC6, 0xDE, 0xDE, 0xDC, 0xC0, 0x7C, 0x00},
-    // A (65)
-    {0x38, 0x6C, 0xC6, 0xC6, 0xFE, 0xC6, 0xC6, 0x00},
-    // B (66)
-    {0xFC, 0xC6, 0xC6, 0xFC, 0xC6, 0xC6, 0xFC, 0x00},
-    // C (67)
-    {0x7C, 0xC6, 0xC0, 0xC0, 0xC0, 0xC6, 0x7C, 0x00},
-    // D (68)
-    {0xF8, 0xCC, 0xC6, 0xC6, 0xC6, 0xCC, 0xF8, 0x00},
-    // E (69)
-    {0xFE, 0xC0, 0xC0, 0xFC, 0xC0, 0xC0, 0xFE, 0x00},
-    // F (70)
-    {0xFE, 0xC0, 0xC0, 0xFC, 0xC0, 0xC0, 0xC0, 0x00},
-    // G (71)
-    {0x7C, 0xC6, 0xC0, 0xCE, 0xC6, 0xC6, 0x7C, 0x00},
-    // H (72)
-    {0xC6, 0xC6, 0xC6, 0xFE, 0xC6, 0xC6, 0xC6, 0x00},
-    // I (73)
-    {0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x00},
-    // J (74)
-    {0x06, 0x06, 0x06, 0x06, 0x06, 0xC6, 0x7C, 0x00},
-    // K (75)
-    {0xC6, 0xCC, 0xD8, 0xF0, 0xD8, 0xCC, 0xC6, 0x00},
-    // L (76)
-    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xFE, 0x00},
-    // M (77)
-    {0xC6, 0xEE, 0xFE, 0xD6, 0xC6, 0xC6, 0xC6, 0x00},
-    // N (78)
-    {0xC6, 0xE6, 0xF6, 0xDE, 0xCE, 0xC6, 0xC6, 0x00},
-    // O (79)
-    {0x7C, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00},
-    // P (80)
-    {0xFC, 0xC6, 0xC6, 0xFC, 0xC0, 0xC0, 0xC0, 0x00},
-    // Q (81)
-    {0x7C, 0xC6, 0xC6, 0xC6, 0xD6, 0xDE, 0x7C, 0x06},
-    // R (82)
-    {0xFC, 0xC6, 0xC6, 0xFC, 0xD8, 0xCC, 0xC6, 0x00},
-    // S (83)
-    {0x7C, 0xC6, 0xC0, 0x7C, 0x06, 0xC6, 0x7C, 0x00},
-    // T (84)
-    {0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},
-    // U (85)
-    {0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00},
-    // V (86)
-    {0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x6C, 0x38, 0x00},
-    // W (87)
-    {0xC6, 0xC6, 0xC6, 0xD6, 0xFE, 0xEE, 0xC6, 0x00},
-    // X (88)
-    {0xC6, 0xC6, 0x6C, 0x38, 0x6C, 0xC6, 0xC6, 0x00},
-    // Y (89)
-    {0xC6, 0xC6, 0xC6, 0x7C, 0x18, 0x18, 0x18, 0x00},
-    // Z (90)
-    {0xFE, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFE, 0x00},
-    // [ (91)
-    {0x7C, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7C, 0x00},
-    // \ (92)
-    {0xC0, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x02, 0x00},
-    // ] (93)
-    {0x7C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x7C, 0x00},
-    // ^ (94)
-    {0x10, 0x38, 0x6C, 0xC6, 0x00, 0x00, 0x00, 0x00},
-    // _ (95)
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},
-    // ` (96)
-    {0x30, 0x18, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00},
-    // a (97)
-    {0x00, 0x00, 0x7C, 0x06, 0x7E, 0xC6, 0x7E, 0x00},
-    // b (98)
-    {0xC0, 0xC0, 0xFC, 0xC6, 0xC6, 0xC6, 0xFC, 0x00},
-    // c (99)
-    {0x00, 0x00, 0x7C, 0xC6, 0xC0, 0xC6, 0x7C, 0x00},
-    // d (100)
-    {0x06, 0x06, 0x7E, 0xC6, 0xC6, 0xC6, 0x7E, 0x00},
-    // e (101)
-    {0x00, 0x00, 0x7C, 0xC6, 0xFE, 0xC0, 0x7C, 0x00},
-    // f (102)
-    {0x1C, 0x36, 0x30, 0x78, 0x30, 0x30, 0x30, 0x00},
-    // g (103)
-    {0x00, 0x00, 0x7E, 0xC6, 0xC6, 0x7E, 0x06, 0x7C},
-    // h (104)
-    {0xC0, 0xC0, 0xFC, 0xC6, 0xC6, 0xC6, 0xC6, 0x00},
-    // i (105)
-    {0x18, 0x00, 0x38, 0x18, 0x18, 0x18, 0x3C, 0x00},
-    // j (106)
-    {0x06, 0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x7C},
-    // k (107)
-    {0xC0, 0xC0, 0xCC, 0xD8, 0xF0, 0xD8, 0xCC, 0x00},
-    // l (108)
-    {0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00},
-    // m (109)
-    {0x00, 0x00, 0x6C, 0xFE, 0xD6, 0xC6, 0xC6, 0x00},
-    // n (110)
-    {0x00, 0x00, 0xFC, 0xC6, 0xC6, 0xC6, 0xC6, 0x00},
-    // o (111)
-    {0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0x7C, 0x00},
-    // p (112)
-    {0x00, 0x00, 0xFC, 0xC6, 0xC6, 0xFC, 0xC0, 0xC0},
-    // q (113)
-    {0x00, 0x00, 0x7E, 0xC6, 0xC6, 0x7E, 0x06, 0x06},
-    // r (114)
-    {0x00, 0x00, 0xDC, 0xF6, 0xC0, 0xC0, 0xC0, 0x00},
-    // s (115)
-    {0x00, 0x00, 0x7E, 0xC0, 0x7C, 0x06, 0xFC, 0x00},
-    // t (116)
-    {0x30, 0x30, 0xFC, 0x30, 0x30, 0x36, 0x1C, 0x00},
-    // u (117)
-    {0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0x7E, 0x00},
-    // v (118)
-    {0x00, 0x00, 0xC6, 0xC6, 0xC6, 0x6C, 0x38, 0x00},
-    // w (119)
-    {0x00, 0x00, 0xC6, 0xC6, 0xD6, 0xFE, 0x6C, 0x00},
-    // x (120)
-    {0x00, 0x00, 0xC6, 0x6C, 0x38, 0x6C, 0xC6, 0x00},
-    // y (121)
-    {0x00, 0x00, 0xC6, 0xC6, 0xC6, 0x7E, 0x06, 0x7C},
-    // z (122)
-    {0x00, 0x00, 0xFE, 0x0C, 0x38, 0x60, 0xFE, 0x00},
-    // { (123)
-    {0x0E, 0x18, 0x18, 0x70, 0x18, 0x18, 0x0E, 0x00},
-    // | (124)
-    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},
-    // } (125)
-    {0x70, 0x18, 0x18, 0x0E, 0x18, 0x18, 0x70, 0x00},
-    // ~ (126)
-    {0x76, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+// Built-in 8x8 font covering ASCII characters 32-126
+#define FONT_FIRST_CHAR  32
+#define FONT_LAST_CHAR   126
+#define FONT_GLYPH_COUNT (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
+// Tight bounding box of a glyph's set pixels, inclusive. Empty glyphs
+// (space) have y0 > y1 so callers can skip them with a single compare.
+struct font_glyph_box {
+    uint8_t x0, y0;
+    uint8_t x1, y1;
 };
 
-#endif // FONT_H
\ No newline at end of file
+// The tables below are generated at build time by tools/fontgen.c from
+// tools/font_8x8.inc and compiled once into font_tables.c.
+
+// 1bpp glyph rows, MSB is the leftmost pixel
+extern const uint8_t font_8x8[FONT_GLYPH_COUNT][8];
+
+// Per-glyph bounding boxes with empty rows and columns trimmed
+extern const struct font_glyph_box font_8x8_box[FONT_GLYPH_COUNT];
+
+// Glyph row byte expanded to 8 RGB565 pixel masks (0x0000 or 0xFFFF),
+// so a row is drawn as (dst & ~mask) | (color & mask) without bit tests
+extern const uint16_t font_row_mask[256][8];
+
+// Signed distance field atlas of the built-in font (see sdf.h)
+#define FONT_SDF_SCALE 3
+#define FONT_SDF_CELL  SDF_CELL_SIZE(8, FONT_SDF_SCALE)
+extern const uint8_t font_8x8_sdf[FONT_GLYPH_COUNT][FONT_SDF_CELL * FONT_SDF_CELL];
+
+// Largest glyph cell accepted from font files
+#define FONT_MAX_SIZE   64
+#define FONT_MAX_GLYPHS 65536
+
+// A bitmap font: glyphs packed into one 1bpp atlas plus a codepoint index.
+// PSF2 atlases point straight into the mapped file; BDF fonts are parsed
+// into an owned atlas once at load time.
+struct font {
+    int width, height;            // Glyph cell size in pixels
+    int stride;                   // Bytes per glyph row
+    int glyph_bytes;              // stride * height
+    uint32_t glyph_count;
+    const uint8_t *glyphs;        // glyph_count * glyph_bytes
+    const struct font_glyph_box *boxes;
+
+    // Codepoints in [direct_first, direct_first + direct_count) map straight
+    // to glyph (codepoint - direct_first); everything else goes through the
+    // open-addressed hash below.
+    uint32_t direct_first;
+    uint32_t direct_count;
+    uint32_t *hash_keys;          // FONT_HASH_EMPTY marks a free slot
+    uint32_t *hash_glyphs;
+    uint32_t hash_mask;           // Capacity - 1 (power of two), 0 if unused
+    uint32_t hash_used;
+
+    uint8_t *atlas;               // Owned atlas storage, NULL when mapped
+    struct font_glyph_box *owned_boxes;
+    struct mapped_file map;
+};
+
+#define FONT_HASH_EMPTY 0xFFFFFFFFu
+
+// The built-in 8x8 font as a struct font (always available)
+const struct font *font_builtin(void);
+
+// Load a PSF2 or BDF font file; returns false and leaves font zeroed on error
+bool font_load(struct font *font, const char *path);
+
+// Release a font filled in by font_load
+void font_free(struct font *font);
+
+// Glyph index for a codepoint, or -1 when the font has no such glyph
+int font_find_glyph(const struct font *font, uint32_t codepoint);
+
+static inline const uint8_t *font_glyph_bits(const struct font *font, int glyph) {
+    return font->glyphs + (size_t)glyph * font->glyph_bytes;
+}
+
+#endif // FONT_H
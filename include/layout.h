@@ -0,0 +1,50 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "surface.h"
+
+enum layout_align {
+    LAYOUT_ALIGN_LEFT,
+    LAYOUT_ALIGN_CENTER,
+    LAYOUT_ALIGN_RIGHT
+};
+
+// One laid-out line: a byte range of the source text
+struct layout_line {
+    uint32_t start;   // Byte offset of the first character
+    uint32_t length;  // Bytes, without the whitespace the line broke on
+    int width;        // Pixels
+};
+
+// Result of laying out a paragraph with the selected font
+struct layout {
+    const struct layout_line *lines;
+    int line_count;
+    int line_height;
+    int width, height; // Measured extent in pixels
+};
+
+// Lay out UTF-8 text, wrapping at spaces to max_width pixels (<= 0 means
+// no wrapping) and at '\n'. Words wider than max_width are split.
+// Results are cached by (text, max_width, font); the returned layout stays
+// valid until the next layout call that evicts it or layout_cache_clear().
+const struct layout *layout_text(const char *text, int max_width);
+
+// Measure text as layout_text would lay it out
+void layout_measure(const char *text, int max_width, int *width, int *height);
+
+// Lay out text and draw it inside a box of box_width pixels starting at
+// (x, y), aligning each line within the box
+void layout_draw(const struct surface *dst, int x, int y,
+                 const char *text, int box_width, enum layout_align align, uint16_t color);
+
+// Same for an 8-bit indexed buffer, setting text pixels to palette index
+void layout_draw8(uint8_t *fb, int fb_width, int fb_height, int x, int y,
+                  const char *text, int box_width, enum layout_align align, uint8_t index);
+
+// Free every cached layout
+void layout_cache_clear(void);
+
+#endif // LAYOUT_H
@@ -0,0 +1,29 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Read-only memory mapping of a whole file
+struct mapped_file {
+    const uint8_t *data;
+    size_t size;
+#ifdef _WIN32
+    void *file;
+    void *mapping;
+#endif
+};
+
+// Map the file at path; returns false (and leaves mf zeroed) on failure
+bool mapfile_open(struct mapped_file *mf, const char *path);
+
+// Unmap and reset; safe to call on a zeroed or already closed mapping
+void mapfile_close(struct mapped_file *mf);
+
+// Copy the next line of the text in [*cur, end) into buf, without its line
+// ending and truncated to buf_size - 1 characters, and advance *cur past
+// it; returns false at end of data
+bool mapfile_next_line(const char **cur, const char *end, char *buf, size_t buf_size);
+
+#endif // MAPFILE_H
@@ -0,0 +1,40 @@
+#ifndef MODE7_H
+#define MODE7_H
+
+#include <stdint.h>
+
+// Mode 7-style plane: a large wrapping RGB565 texture drawn with its own
+// affine transform on every row. Each row is reduced to a start point and
+// a per-pixel step in 16.16 fixed point and filled by stepping, with rows
+// split across the worker pool.
+
+// Texture that repeats in both directions; sizes are powers of two
+struct mode7_texture {
+    const uint16_t *pixels;
+    int width_log2, height_log2;
+};
+
+// Perspective view of the plane from a camera at (x, y) in texels, height
+// texels above it, looking along angle (radians, 0 is +x). Rows from
+// horizon down show the plane; rows above it are left untouched. focal is
+// the distance to the screen in pixels and sets the field of view.
+struct mode7_view {
+    float x, y;
+    float angle;
+    float height;
+    float focal;
+    int horizon;
+};
+
+void mode7_draw_perspective(uint16_t *fb, int fb_width, int fb_height,
+                            const struct mode7_texture *texture, const struct mode7_view *view);
+
+// Flat rotation and zoom over the whole buffer: texel (cx, cy) lands on
+// the centre of the screen and each pixel covers 1 / scale texels
+void mode7_draw_affine(uint16_t *fb, int fb_width, int fb_height,
+                       const struct mode7_texture *texture,
+                       float cx, float cy, float angle, float scale);
+
+void mode7_free(void);
+
+#endif // MODE7_H
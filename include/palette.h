@@ -0,0 +1,32 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 256-colour palettes for 8-bit indexed framebuffers. Each entry is kept
+// in both output formats, so expanding a frame is a single table lookup
+// per pixel; changing an entry recolours every pixel using it for free.
+#define PALETTE_SIZE 256
+
+struct palette {
+    uint32_t xrgb8888[PALETTE_SIZE];
+    uint32_t rgb565[PALETTE_SIZE];  // Widened to 32 bits for gathered loads
+};
+
+// Set entry index from 8-bit channels
+void palette_set(struct palette *pal, int index, uint8_t r, uint8_t g, uint8_t b);
+
+// Rotate entries [first, first + count) up by one; the last wraps to first
+void palette_rotate(struct palette *pal, int first, int count);
+
+// Expand width x height indices into RGB565 or XRGB8888 pixels.
+// Pitches are in bytes.
+void palette_expand_rgb565(const uint8_t *src, size_t src_pitch,
+                           uint16_t *dst, size_t dst_pitch,
+                           const struct palette *pal, int width, int height);
+void palette_expand_xrgb8888(const uint8_t *src, size_t src_pitch,
+                             uint32_t *dst, size_t dst_pitch,
+                             const struct palette *pal, int width, int height);
+
+#endif // PALETTE_H
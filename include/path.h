@@ -0,0 +1,52 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "surface.h"
+
+// Vector paths built from lines and Bezier curves. Curves are flattened
+// into line segments as they are added, with the segment count chosen from
+// each curve's curvature, so paths can be built at any scale. Coordinates
+// follow draw_aa.h: pixel (x, y) covers [x, x + 1) x [y, y + 1).
+
+// Largest distance a flattened curve may stray from the true curve, in pixels
+#define PATH_DEFAULT_TOLERANCE 0.2f
+
+enum path_fill_rule {
+    PATH_FILL_NONZERO = 0,
+    PATH_FILL_EVEN_ODD,
+};
+
+struct path_segment {
+    float x0, y0, x1, y1;
+};
+
+struct path {
+    struct path_segment *segments;
+    int count, capacity;
+    float start_x, start_y;   // First point of the current subpath
+    float x, y;               // Current point
+    float tolerance;
+};
+
+void path_init(struct path *path);
+void path_free(struct path *path);
+// Drop all segments but keep the storage for reuse
+void path_reset(struct path *path);
+
+// Building functions return false if segment storage could not grow.
+// Starting a new subpath closes the previous one; fills treat every
+// subpath as closed.
+bool path_move_to(struct path *path, float x, float y);
+bool path_line_to(struct path *path, float x, float y);
+bool path_quad_to(struct path *path, float cx, float cy, float x, float y);
+bool path_cubic_to(struct path *path, float c1x, float c1y, float c2x, float c2y, float x, float y);
+bool path_close(struct path *path);
+
+// Fill the path into an RGB565 surface with anti-aliased edges, clipped to
+// its scissor
+void path_fill(const struct surface *dst, const struct path *path, enum path_fill_rule rule,
+               uint16_t color);
+
+#endif // PATH_H
@@ -0,0 +1,26 @@
+#ifndef PIXCONV_H
+#define PIXCONV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libretro.h>
+
+// Conversions between the three libretro pixel formats (RGB565, XRGB8888,
+// 0RGB1555). Conversions that drop bits use 4x4 ordered dithering.
+// SIMD kernels are picked once at run time from cpu_features().
+
+// Select kernels and log the choice; called implicitly on first use
+void pixconv_init(void);
+
+// Bytes per pixel of a libretro pixel format
+size_t pixconv_bytes_per_pixel(enum retro_pixel_format format);
+
+// Human-readable format name for logs
+const char *pixconv_format_name(enum retro_pixel_format format);
+
+// Convert width x height pixels. Same-format calls copy rows.
+void pixconv_convert(const void *src, size_t src_pitch, enum retro_pixel_format src_format,
+                     void *dst, size_t dst_pitch, enum retro_pixel_format dst_format,
+                     int width, int height);
+
+#endif // PIXCONV_H
@@ -0,0 +1,40 @@
+#ifndef POSTFX_H
+#define POSTFX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// CPU output stages for frontends without shader support: integer
+// upscaling, scanline darkening and an RGB aperture mask. Rows are split
+// across the worker pool; the effects run in SIMD on RGB565 pixels.
+#define POSTFX_MAX_SCALE 4
+#define POSTFX_MAX_WIDTH 2048 // Output pixels per row
+
+// Pixel-art upscalers; they work in 2x steps, so they apply at scale 2
+// (one pass) and 4 (two passes) and scale 3 stays nearest-neighbour
+enum postfx_filter {
+    POSTFX_FILTER_NEAREST = 0,
+    POSTFX_FILTER_SCALE2X,   // Scale2x/EPX: copies neighbours along edges
+    POSTFX_FILTER_XBR_LITE,  // 3x3 xBR edge detection with 50% corner blends
+};
+
+struct postfx_config {
+    int scale;        // 1 to POSTFX_MAX_SCALE
+    enum postfx_filter filter;
+    bool scanlines;   // Darken the last output row of each source row
+    bool mask;        // Tint output columns in a repeating R, G, B triad
+};
+
+// True when cfg changes the picture at all
+bool postfx_active(const struct postfx_config *cfg);
+
+// Run the stages on a width x height RGB565 image into dst, which must
+// hold (width * scale) x (height * scale) pixels. Pitches are in bytes.
+void postfx_apply(const uint16_t *src, size_t src_pitch, int width, int height,
+                  uint16_t *dst, size_t dst_pitch, const struct postfx_config *cfg);
+
+// Release the scratch buffer used between two filter passes
+void postfx_free(void);
+
+#endif // POSTFX_H
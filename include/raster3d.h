@@ -0,0 +1,81 @@
+#ifndef RASTER3D_H
+#define RASTER3D_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Small software 3D pipeline for RGB565 buffers. Triangles drawn between
+// raster3d_begin and raster3d_end are transformed, clipped and set up
+// straight away, then binned into the screen tiles they touch. raster3d_end
+// rasterizes and shades the tiles in parallel on the worker pool; each tile
+// is owned by one thread, so no locking is needed.
+
+// Screen tile edge in pixels
+#define RASTER3D_TILE 8
+
+enum raster3d_shading {
+    RASTER3D_SHADE_FLAT = 0,   // First vertex colour over the whole triangle
+    RASTER3D_SHADE_GOURAUD,    // Vertex colours interpolated
+    RASTER3D_SHADE_TEXTURED,   // Affine (screen-space) texture mapping
+};
+
+// Texture of RGB565 texels; width and height must be powers of two and
+// coordinates wrap
+struct raster3d_texture {
+    const uint16_t *pixels;
+    int width, height;
+};
+
+struct raster3d_material {
+    enum raster3d_shading shading;
+    const struct raster3d_texture *texture;
+    bool double_sided;   // Otherwise clockwise triangles are culled
+};
+
+struct raster3d_vertex {
+    float x, y, z;
+    float u, v;          // Texel coordinates
+    uint16_t color;
+};
+
+// Start a frame drawing into fb. Depth is not cleared here: each tile
+// resets its own depth when it is shaded, and only tiles with triangles
+// binned to them are touched. Returns false if the depth or bin storage
+// could not be allocated.
+bool raster3d_begin(uint16_t *fb, int fb_width, int fb_height);
+
+// Queue indexed triangles (three indices each) transformed by the
+// column-major model-view-projection matrix mvp
+void raster3d_draw(const float mvp[16], const struct raster3d_vertex *vertices,
+                   const uint16_t *indices, int triangle_count,
+                   const struct raster3d_material *material);
+
+// Rasterize everything queued since raster3d_begin into the framebuffer
+void raster3d_end(void);
+
+// Counters for the last frame. Each tile keeps the nearest and farthest
+// depth it holds: a triangle entirely behind the farthest is rejected for
+// that tile before any pixel is visited, and one entirely in front of the
+// nearest is drawn without per-pixel depth tests.
+struct raster3d_stats {
+    unsigned triangles;        // Set up after clipping and culling
+    unsigned tile_tests;       // Triangle/tile pairs produced by binning
+    unsigned tiles_rejected;   // Pairs rejected by the depth hierarchy
+    unsigned tiles_accepted;   // Pairs drawn without depth tests
+    unsigned pixels_covered;   // Pixels inside a visited triangle
+    unsigned pixels_written;   // Pixels that passed the depth test
+};
+void raster3d_get_stats(struct raster3d_stats *stats);
+
+// Release the depth buffer and bins
+void raster3d_free(void);
+
+// Column-major 4x4 matrix helpers. translate and rotate post-multiply, so
+// the last transform applied is the first one that reaches the vertices.
+void raster3d_mat_identity(float m[16]);
+void raster3d_mat_perspective(float m[16], float fovy, float aspect, float znear, float zfar);
+void raster3d_mat_multiply(float out[16], const float a[16], const float b[16]);
+void raster3d_mat_translate(float m[16], float x, float y, float z);
+void raster3d_mat_rotate(float m[16], float angle, float x, float y, float z);
+
+#endif // RASTER3D_H
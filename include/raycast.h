@@ -0,0 +1,41 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Grid raycaster: one ray per framebuffer column through a map of square
+// cells, drawing textured wall slices with the floor and ceiling below and
+// above them. Columns are split across the worker pool.
+
+// Textures are square RGB565 images stored column by column, so a wall
+// slice reads texels in order
+#define RAYCAST_TEXTURE_LOG2 6
+#define RAYCAST_TEXTURE_SIZE (1 << RAYCAST_TEXTURE_LOG2)
+
+struct raycast_world {
+    const uint8_t *cells;     // width x height; 0 is empty, n uses wall texture n - 1
+    int width, height;
+    const uint16_t *walls;    // wall_count textures
+    int wall_count;
+    const uint16_t *floor;
+    const uint16_t *ceiling;
+};
+
+// Camera at (x, y) in cells looking along angle (radians, 0 is +x) with a
+// horizontal field of view of fov radians
+struct raycast_view {
+    float x, y;
+    float angle;
+    float fov;
+};
+
+void raycast_render(uint16_t *fb, int fb_width, int fb_height,
+                    const struct raycast_world *world, const struct raycast_view *view);
+
+// True if the cell containing (x, y) is a wall or outside the map
+bool raycast_solid(const struct raycast_world *world, float x, float y);
+
+void raycast_free(void);
+
+#endif // RAYCAST_H
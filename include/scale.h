@@ -0,0 +1,30 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libretro.h>
+
+// Resampling of RGB565 and XRGB8888 images to any size. Both filters are
+// separable: each output row is first filtered down the source columns
+// into 16-bit channels, then along the row. Output rows are split across
+// the worker pool and the filter taps run as SSE2 multiply-adds.
+#define SCALE_MAX_SIZE 4096
+
+enum scale_filter {
+    SCALE_FILTER_BILINEAR,   // Two taps per axis; for enlarging or mild shrinking
+    SCALE_FILTER_BOX,        // Area average of every covered source pixel
+};
+
+// Resample a src_width x src_height image into dst_width x dst_height.
+// format is RETRO_PIXEL_FORMAT_RGB565 or XRGB8888 for both images;
+// other formats and sizes above SCALE_MAX_SIZE are ignored. Pitches are
+// in bytes.
+void scale_image(const void *src, size_t src_pitch, int src_width, int src_height,
+                 void *dst, size_t dst_pitch, int dst_width, int dst_height,
+                 enum retro_pixel_format format, enum scale_filter filter);
+
+// Release the tap tables and intermediate rows
+void scale_free(void);
+
+#endif // SCALE_H
@@ -0,0 +1,24 @@
+#ifndef SDF_H
+#define SDF_H
+
+#include <stdint.h>
+
+// Signed distance field glyphs. Each source pixel becomes scale x scale
+// samples and the cell is padded by SDF_SPREAD samples on every side.
+// A sample stores 128 + distance * 127 / SDF_SPREAD (distance in samples,
+// positive inside the glyph), so the outline sits at 128.
+#define SDF_SPREAD        3   // Encoded distance range and padding, in samples
+#define SDF_TARGET_HEIGHT 24  // Samples aimed for across a glyph's height
+#define SDF_EDGE          128
+
+#define SDF_CELL_SIZE(pixels, scale) ((pixels) * (scale) + 2 * SDF_SPREAD)
+
+// Samples per source pixel for a font of the given glyph height
+int sdf_scale_for_height(int height);
+
+// Build the SDF of a 1bpp glyph (MSB leftmost) into out, which must hold
+// SDF_CELL_SIZE(width, scale) * SDF_CELL_SIZE(height, scale) bytes
+void sdf_generate_glyph(const uint8_t *bits, int stride, int width, int height,
+                        int scale, uint8_t *out);
+
+#endif // SDF_H
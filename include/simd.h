@@ -0,0 +1,12 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Compile-time SIMD availability. SSE2 is part of the x86-64 baseline and
+// of any 32-bit x86 build targeting it; everything else uses the scalar
+// code paths.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif // SIMD_H
@@ -0,0 +1,65 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// RGB565 drawing target: width x height pixels whose rows are pitch
+// pixels apart, so the 2D primitives draw the same way into the
+// framebuffer, a window of it or an offscreen buffer that is blitted
+// later. Each surface carries a scissor stack; primitives clip their
+// rows and spans against the current scissor once and then write
+// without per-pixel bounds tests.
+
+#define SURFACE_SCISSOR_DEPTH 16
+
+// Half-open rectangle [x0, x1) x [y0, y1)
+struct surface_rect {
+    int x0, y0, x1, y1;
+};
+
+struct surface {
+    uint16_t *pixels;
+    int pitch;                    // Pixels from one row to the next
+    int width, height;
+    struct surface_rect clip;     // Current scissor, always inside the surface
+    struct surface_rect saved[SURFACE_SCISSOR_DEPTH];
+    int depth;                    // Scissors pushed
+    bool owned;                   // pixels allocated by surface_alloc
+};
+
+// Wrap existing pixels; the scissor starts as the whole surface
+void surface_init(struct surface *s, uint16_t *pixels, int pitch, int width, int height);
+
+// Offscreen surface with its own zeroed pixels; returns false and leaves s
+// zeroed if they could not be allocated
+bool surface_alloc(struct surface *s, int width, int height);
+
+// Release pixels from surface_alloc; wrapped surfaces are only reset
+void surface_free(struct surface *s);
+
+// Narrow the scissor to its intersection with a rectangle, saving the
+// previous one; returns false, changing nothing, when the stack is full
+bool surface_push_scissor(struct surface *s, int x, int y, int width, int height);
+
+// Restore the scissor in place before the last push
+void surface_pop_scissor(struct surface *s);
+
+// Clip a width x height rectangle at (x, y) to the scissor; false when
+// nothing of it is left
+bool surface_clip(const struct surface *s, int x, int y, int width, int height,
+                  struct surface_rect *out);
+
+static inline uint16_t *surface_row(const struct surface *s, int y) {
+    return s->pixels + (ptrdiff_t)y * s->pitch;
+}
+
+// Fill the whole scissor rectangle
+void surface_clear(const struct surface *s, uint16_t color);
+
+// Copy all of src with its top-left corner at (x, y) of dst, clipped to
+// dst's scissor
+void surface_blit(const struct surface *dst, const struct surface *src, int x, int y);
+
+#endif // SURFACE_H
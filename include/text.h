@@ -0,0 +1,40 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "font.h"
+#include "surface.h"
+
+// Select the font used by the text functions; NULL restores the built-in
+// 8x8 font. The font must stay alive while selected.
+void text_set_font(const struct font *font);
+const struct font *text_font(void);
+
+// Bumped whenever the selected font changes, so glyph caches built on top
+// of the text module know when to drop their contents
+unsigned text_font_generation(void);
+
+// Resolve a codepoint through the selected font, the built-in fallback and
+// the missing-glyph replacement; returns false if nothing can be drawn
+bool text_find_glyph(uint32_t codepoint, const struct font **font, int *glyph);
+
+// Draw one glyph with its top-left corner at (x, y) into an RGB565
+// surface, clipped to its scissor. Glyphs missing from the selected font
+// fall back to the built-in font; glyphs missing from both are logged once
+// and drawn as U+FFFD (or '?').
+void text_draw_char(const struct surface *dst, int x, int y, uint32_t codepoint, uint16_t color);
+
+// Draw a UTF-8 string, advancing by the selected font's cell width
+void text_draw_string(const struct surface *dst, int x, int y, const char *str, uint16_t color);
+
+// Draw the first len bytes of a UTF-8 string
+void text_draw_span(const struct surface *dst, int x, int y, const char *str, size_t len,
+                    uint16_t color);
+
+// Draw the first len bytes of a UTF-8 string into an 8-bit indexed buffer,
+// setting covered pixels to palette index
+void text_draw_span8(uint8_t *fb, int fb_width, int fb_height,
+                     int x, int y, const char *str, size_t len, uint8_t index);
+
+#endif // TEXT_H
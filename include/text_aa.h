@@ -0,0 +1,19 @@
+#ifndef TEXT_AA_H
+#define TEXT_AA_H
+
+#include <stdint.h>
+#include "surface.h"
+
+// Largest anti-aliased text size in pixels
+#define TEXT_AA_MAX_SIZE 128
+
+// Draw a UTF-8 string scaled to size pixels tall with anti-aliased edges.
+// Glyphs of the selected font are area-resampled once per size into 8-bit
+// coverage bitmaps and blended onto the RGB565 surface.
+void text_aa_draw_string(const struct surface *dst, int x, int y, const char *str, int size,
+                         uint16_t color);
+
+// Width in pixels of str when drawn at size
+int text_aa_string_width(const char *str, int size);
+
+#endif // TEXT_AA_H
@@ -0,0 +1,16 @@
+#ifndef TEXT_SDF_H
+#define TEXT_SDF_H
+
+#include <stdint.h>
+#include "surface.h"
+
+// Largest signed-distance-field text size in pixels
+#define TEXT_SDF_MAX_SIZE 192
+
+// Draw a UTF-8 string at any size from one distance field per glyph. The
+// built-in font uses the atlas generated at build time; loaded fonts get
+// their fields generated on first use and cached.
+void text_sdf_draw_string(const struct surface *dst, int x, int y, const char *str, int size,
+                          uint16_t color);
+
+#endif // TEXT_SDF_H
@@ -0,0 +1,57 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "surface.h"
+
+// Scrolling background of 8x8 tiles. Tile patterns are 1bpp rows in the
+// font_8x8 layout (MSB leftmost), so the built-in font works as a tile
+// set as-is. Each cell picks a pattern and one of 16 fg/bg colour pairs.
+//
+// Visible tiles are kept expanded in a wrapping layer one tile larger
+// than the view, like a hardware tilemap. A render only redraws tiles
+// whose cell changed (per-cell dirty flags) or that scrolled into the
+// layer, and then copies the layer out at the fine scroll offset.
+// Expanded pattern/colour combinations are shared through a tile cache.
+
+#define TILEMAP_TILE 8
+#define TILEMAP_PALETTES 16
+
+// Cell value: pattern index in the low 12 bits, colour pair in the top 4
+#define TILEMAP_CELL(tile, palette) ((uint16_t)((tile) | (palette) << 12))
+#define TILEMAP_CELL_TILE(cell) ((cell) & 0x0FFF)
+#define TILEMAP_CELL_PALETTE(cell) ((cell) >> 12)
+
+struct tilemap {
+    int width, height;            // Map size in tiles; scrolling wraps
+    uint16_t *cells;
+    uint8_t *dirty;               // Per cell: changed since last drawn
+    const uint8_t (*patterns)[8];
+    int pattern_count;
+    uint16_t colors[TILEMAP_PALETTES][2];   // fg, bg
+    int view_width, view_height;  // Rendered area in pixels
+    int layer_columns, layer_rows;
+    uint16_t *layer;
+    int32_t *layer_cells;         // Map cell drawn in each layer tile, -1 if none
+    unsigned redrawn;             // Tiles redrawn by the last render
+};
+
+// Returns false if the map or layer could not be allocated. Every cell
+// starts as pattern 0 with colour pair 0.
+bool tilemap_init(struct tilemap *map, int width, int height,
+                  const uint8_t (*patterns)[8], int pattern_count,
+                  int view_width, int view_height);
+void tilemap_free(struct tilemap *map);
+
+// Change a cell (coordinates wrap); marks it dirty only if it differs
+void tilemap_set(struct tilemap *map, int x, int y, uint16_t cell);
+
+// Change a colour pair; marks every cell using it dirty
+void tilemap_set_colors(struct tilemap *map, int palette, uint16_t fg, uint16_t bg);
+
+// Draw the map scrolled to (scroll_x, scroll_y) pixels into the top-left
+// view_width x view_height of dst, clipped to its scissor
+void tilemap_render(struct tilemap *map, const struct surface *dst, int scroll_x, int scroll_y);
+
+#endif // TILEMAP_H
@@ -0,0 +1,53 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdint.h>
+
+#define UTF8_REPLACEMENT 0xFFFD
+#define UTF8_INVALID     0xFFFFFFFFu
+
+// Decode one UTF-8 sequence from [*p, end) and advance *p past it, returning
+// UTF8_INVALID for malformed input so it can be told from a literal U+FFFD.
+// A bad lead byte or a truncated sequence consumes a single byte so decoding
+// resynchronises on the next lead byte; a complete but overlong, surrogate
+// or out-of-range sequence consumes the whole sequence.
+static inline uint32_t utf8_decode_strict(const uint8_t **p, const uint8_t *end) {
+    const uint8_t *s = *p;
+    uint32_t c = *s++;
+    if (c < 0x80) {
+        *p = s;
+        return c;
+    }
+    int extra;
+    uint32_t min;
+    if ((c & 0xE0) == 0xC0)      { extra = 1; min = 0x80;    c &= 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { extra = 2; min = 0x800;   c &= 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { extra = 3; min = 0x10000; c &= 0x07; }
+    else {
+        *p = s;
+        return UTF8_INVALID;
+    }
+    if (end - s < extra) {
+        *p = *p + 1;
+        return UTF8_INVALID;
+    }
+    for (int i = 0; i < extra; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *p = *p + 1;
+            return UTF8_INVALID;
+        }
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+    *p = s + extra;
+    if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+        return UTF8_INVALID;
+    return c;
+}
+
+// As utf8_decode_strict, but malformed input decodes to U+FFFD
+static inline uint32_t utf8_decode(const uint8_t **p, const uint8_t *end) {
+    uint32_t c = utf8_decode_strict(p, end);
+    return c == UTF8_INVALID ? UTF8_REPLACEMENT : c;
+}
+
+#endif // UTF8_H
@@ -0,0 +1,59 @@
+#ifndef VOXEL_H
+#define VOXEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mapfile.h"
+
+// Heightmap voxel terrain. Each column of the screen marches a ray front
+// to back over the height and colour maps, drawing only what rises above
+// everything nearer (a per-column y-buffer), so no pixel is drawn twice.
+// Columns are split across the worker pool.
+//
+// Terrain files (.hwv) are memory-mapped and used in place:
+//   0   "HWVOXEL1"
+//   8   uint8 width_log2, uint8 height_log2, 6 reserved bytes
+//   16  heights, one byte per sample, row by row
+//   16 + width * height   RGB565 colours, little-endian, row by row
+// Both maps wrap at the edges.
+
+#define VOXEL_MAGIC "HWVOXEL1"
+#define VOXEL_HEADER_SIZE 16
+#define VOXEL_MAX_LOG2 12
+
+struct voxel_map {
+    const uint8_t *heights;
+    const uint16_t *colors;
+    int width_log2, height_log2;
+    struct mapped_file file;   // Backing mapping when loaded from a file
+    void *owned;               // Backing memory otherwise
+};
+
+// Map a terrain file; returns false and leaves map zeroed on error
+bool voxel_map_load(struct voxel_map *map, const char *path);
+
+// Build a wrapping fractal landscape of 2^size_log2 samples square
+bool voxel_map_generate(struct voxel_map *map, int size_log2, uint32_t seed);
+
+void voxel_map_free(struct voxel_map *map);
+
+// Camera at (x, y) in samples and altitude above height 0, looking along
+// angle (radians, 0 is +x). horizon is the screen row level with the
+// camera, scale stretches heights on screen and distance limits the ray.
+struct voxel_view {
+    float x, y;
+    float altitude;
+    float angle;
+    float fov;
+    float horizon;
+    float scale;
+    float distance;
+};
+
+// Height of the terrain at (x, y), for keeping cameras above ground
+int voxel_height_at(const struct voxel_map *map, float x, float y);
+
+void voxel_render(uint16_t *fb, int fb_width, int fb_height,
+                  const struct voxel_map *map, const struct voxel_view *view, uint16_t sky);
+
+#endif // VOXEL_H
@@ -0,0 +1,28 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdbool.h>
+
+// Small persistent thread pool for splitting per-frame work (rows, tiles)
+// across cores. The calling thread always takes a share, so a pool of one
+// thread runs everything inline with no synchronisation.
+#define WORKERS_MAX 8
+
+// Process items [begin, end) of a job
+typedef void (*workers_fn)(void *ctx, int begin, int end);
+
+// Start the pool with threads threads in total (the caller counts as one);
+// 0 picks one per CPU. Restarts the pool if it is already running.
+void workers_init(int threads);
+
+// Stop and join the worker threads
+void workers_shutdown(void);
+
+// Threads taking part in workers_run, including the caller
+int workers_count(void);
+
+// Split [0, total) into contiguous ranges, one per thread, run fn on each
+// and return once all ranges are done
+void workers_run(workers_fn fn, void *ctx, int total);
+
+#endif // WORKERS_H
@@ -0,0 +1,571 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+#include "blend.h"
+#include "core_log.h"
+#include "mapfile.h"
+#include "simd.h"
+
+// Transparent gutter kept right of and below every sprite
+#define ATLAS_PADDING 1
+
+// Top edge of the packed area: a run of columns [x, x + width) filled up to y
+struct skyline_node {
+   int x, y, width;
+};
+
+struct skyline {
+   struct skyline_node *nodes;
+   int count;
+   int width;
+};
+
+// Lowest y at which a width x height box fits with its left edge on node i,
+// or -1 if it would stick out of the atlas
+static int skyline_fit(const struct skyline *sky, int i, int width, int height) {
+   int x = sky->nodes[i].x;
+   if (x + width > sky->width)
+      return -1;
+   int y = 0;
+   for (int left = width; left > 0; i++) {
+      if (sky->nodes[i].y > y)
+         y = sky->nodes[i].y;
+      if (y + height > ATLAS_MAX_SIZE)
+         return -1;
+      left -= sky->nodes[i].width;
+   }
+   return y;
+}
+
+// Raise the skyline over a box placed at (x, y) and merge equal runs.
+// nodes has room for one more entry than count.
+static void skyline_add(struct skyline *sky, int index, int x, int y, int width, int height) {
+   struct skyline_node *nodes = sky->nodes;
+   memmove(&nodes[index + 1], &nodes[index], (sky->count - index) * sizeof(*nodes));
+   nodes[index].x = x;
+   nodes[index].y = y + height;
+   nodes[index].width = width;
+   sky->count++;
+
+   // Trim the nodes now hidden under the new one
+   for (int i = index + 1; i < sky->count; i++) {
+      int overlap = nodes[index].x + nodes[index].width - nodes[i].x;
+      if (overlap <= 0)
+         break;
+      nodes[i].x += overlap;
+      nodes[i].width -= overlap;
+      if (nodes[i].width > 0)
+         break;
+      memmove(&nodes[i], &nodes[i + 1], (sky->count - i - 1) * sizeof(*nodes));
+      sky->count--;
+      i--;
+   }
+   for (int i = 0; i < sky->count - 1; i++) {
+      if (nodes[i].y == nodes[i + 1].y) {
+         nodes[i].width += nodes[i + 1].width;
+         memmove(&nodes[i + 1], &nodes[i + 2], (sky->count - i - 2) * sizeof(*nodes));
+         sky->count--;
+         i--;
+      }
+   }
+}
+
+// Place a box at the lowest point it fits, leftmost on ties
+static bool skyline_place(struct skyline *sky, int width, int height, int *x, int *y) {
+   int best = -1, best_y = 0;
+   for (int i = 0; i < sky->count; i++) {
+      int fit = skyline_fit(sky, i, width, height);
+      if (fit >= 0 && (best < 0 || fit < best_y)) {
+         best = i;
+         best_y = fit;
+      }
+   }
+   if (best < 0)
+      return false;
+   *x = sky->nodes[best].x;
+   *y = best_y;
+   skyline_add(sky, best, *x, best_y, width, height);
+   return true;
+}
+
+static const struct atlas_image *sort_images;
+
+// Tallest first, then widest, then in list order
+static int compare_images(const void *a, const void *b) {
+   const struct atlas_image *ia = &sort_images[*(const int *)a];
+   const struct atlas_image *ib = &sort_images[*(const int *)b];
+   if (ia->height != ib->height)
+      return ib->height - ia->height;
+   if (ia->width != ib->width)
+      return ib->width - ia->width;
+   return *(const int *)a - *(const int *)b;
+}
+
+bool atlas_pack(struct atlas *atlas, const struct atlas_image *images, int count) {
+   memset(atlas, 0, sizeof(*atlas));
+   if (count <= 0 || count > ATLAS_MAX_SPRITES)
+      return false;
+
+   // Start from the smallest power of two width whose square holds the
+   // total area; the height is whatever the packing needs
+   size_t area = 0;
+   int widest = 0;
+   for (int i = 0; i < count; i++) {
+      if (images[i].width <= 0 || images[i].height <= 0 ||
+          images[i].width + ATLAS_PADDING > ATLAS_MAX_SIZE ||
+          images[i].height + ATLAS_PADDING > ATLAS_MAX_SIZE)
+         return false;
+      area += (size_t)(images[i].width + ATLAS_PADDING) * (images[i].height + ATLAS_PADDING);
+      if (widest < images[i].width + ATLAS_PADDING)
+         widest = images[i].width + ATLAS_PADDING;
+   }
+   int width = 64;
+   while (width < widest || (size_t)width * width < area)
+      width *= 2;
+
+   int *order = malloc(count * sizeof(*order));
+   struct skyline sky = { malloc((count + 1) * sizeof(*sky.nodes)), 1, width };
+   atlas->sprites = calloc(count, sizeof(*atlas->sprites));
+   if (!order || !sky.nodes || !atlas->sprites || width > ATLAS_MAX_SIZE) {
+      free(order);
+      free(sky.nodes);
+      atlas_free(atlas);
+      return false;
+   }
+   for (int i = 0; i < count; i++)
+      order[i] = i;
+   sort_images = images;
+   qsort(order, count, sizeof(*order), compare_images);
+
+   sky.nodes[0].x = 0;
+   sky.nodes[0].y = 0;
+   sky.nodes[0].width = width;
+   int height = 0;
+   bool ok = true;
+   for (int i = 0; i < count && ok; i++) {
+      const struct atlas_image *image = &images[order[i]];
+      struct atlas_sprite *sprite = &atlas->sprites[order[i]];
+      ok = skyline_place(&sky, image->width + ATLAS_PADDING, image->height + ATLAS_PADDING,
+                         &sprite->x, &sprite->y);
+      sprite->width = image->width;
+      sprite->height = image->height;
+      if (height < sprite->y + image->height + ATLAS_PADDING)
+         height = sprite->y + image->height + ATLAS_PADDING;
+   }
+   free(order);
+   free(sky.nodes);
+
+   atlas->width = width;
+   atlas->height = height;
+   atlas->sprite_count = count;
+   if (ok) {
+      atlas->pixels = calloc((size_t)width * height, sizeof(*atlas->pixels));
+      atlas->alpha = calloc((size_t)width * height, 1);
+   }
+   if (!ok || !atlas->pixels || !atlas->alpha) {
+      atlas_free(atlas);
+      return false;
+   }
+
+   for (int i = 0; i < count; i++) {
+      const struct atlas_image *image = &images[i];
+      struct atlas_sprite *sprite = &atlas->sprites[i];
+      snprintf(sprite->name, sizeof(sprite->name), "%s", image->name ? image->name : "");
+      for (int y = 0; y < image->height; y++) {
+         size_t dst = (size_t)(sprite->y + y) * width + sprite->x;
+         size_t src = (size_t)y * image->width;
+         memcpy(&atlas->pixels[dst], &image->pixels[src], image->width * sizeof(*atlas->pixels));
+         if (image->alpha)
+            memcpy(&atlas->alpha[dst], &image->alpha[src], image->width);
+         else
+            memset(&atlas->alpha[dst], 255, image->width);
+      }
+   }
+   return true;
+}
+
+void atlas_free(struct atlas *atlas) {
+   free(atlas->pixels);
+   free(atlas->alpha);
+   free(atlas->sprites);
+   memset(atlas, 0, sizeof(*atlas));
+}
+
+int atlas_find(const struct atlas *atlas, const char *name) {
+   for (int i = 0; i < atlas->sprite_count; i++)
+      if (strcmp(atlas->sprites[i].name, name) == 0)
+         return i;
+   return -1;
+}
+
+static inline uint16_t pack565(int r, int g, int b) {
+   return (uint16_t)((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+}
+
+// Decoded source image; pixels and alpha share one allocation
+struct loaded_image {
+   int width, height;
+   uint16_t *pixels;
+   uint8_t *alpha;
+};
+
+static bool image_alloc(struct loaded_image *image, int width, int height) {
+   if (width <= 0 || height <= 0 || width > ATLAS_MAX_SIZE || height > ATLAS_MAX_SIZE)
+      return false;
+   size_t count = (size_t)width * height;
+   image->pixels = malloc(count * 3);
+   if (!image->pixels)
+      return false;
+   image->alpha = (uint8_t *)(image->pixels + count);
+   image->width = width;
+   image->height = height;
+   return true;
+}
+
+// Skip whitespace and '#' comments between PPM header fields
+static const uint8_t *ppm_skip(const uint8_t *p, const uint8_t *end) {
+   while (p < end) {
+      if (*p == '#') {
+         while (p < end && *p != '\n')
+            p++;
+      } else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+         p++;
+      } else {
+         break;
+      }
+   }
+   return p;
+}
+
+static const uint8_t *ppm_number(const uint8_t *p, const uint8_t *end, int *value) {
+   p = ppm_skip(p, end);
+   *value = 0;
+   if (p >= end || *p < '0' || *p > '9')
+      return NULL;
+   while (p < end && *p >= '0' && *p <= '9' && *value < 100000)
+      *value = *value * 10 + (*p++ - '0');
+   return p;
+}
+
+static bool load_ppm(struct loaded_image *image, const uint8_t *data, size_t size) {
+   const uint8_t *end = data + size;
+   int width, height, maxval;
+   const uint8_t *p = data + 2;
+   if (!(p = ppm_number(p, end, &width)) || !(p = ppm_number(p, end, &height)) ||
+       !(p = ppm_number(p, end, &maxval)) || p >= end || maxval < 1 || maxval > 255)
+      return false;
+   p++;   // Single whitespace byte before the raster
+   if (!image_alloc(image, width, height))
+      return false;
+   size_t count = (size_t)width * height;
+   if ((size_t)(end - p) < count * 3)
+      return false;
+   for (size_t i = 0; i < count; i++, p += 3) {
+      int r = p[0] * 255 / maxval, g = p[1] * 255 / maxval, b = p[2] * 255 / maxval;
+      image->pixels[i] = pack565(r, g, b);
+      image->alpha[i] = (r == 255 && g == 0 && b == 255) ? 0 : 255;
+   }
+   return true;
+}
+
+static bool load_tga(struct loaded_image *image, const uint8_t *data, size_t size) {
+   if (size < 18 || data[0] > size - 18)
+      return false;
+   int type = data[2];
+   int width = data[12] | data[13] << 8;
+   int height = data[14] | data[15] << 8;
+   int bytes = data[16] / 8;
+   bool top_down = data[17] & 0x20;
+   if (data[1] != 0 || (type != 2 && type != 10) || (bytes != 3 && bytes != 4))
+      return false;
+   if (!image_alloc(image, width, height))
+      return false;
+
+   const uint8_t *p = data + 18 + data[0];
+   const uint8_t *end = data + size;
+   size_t count = (size_t)width * height;
+   size_t i = 0;
+   while (i < count) {
+      // Raw images are one long literal packet
+      size_t run = count - i;
+      bool repeat = false;
+      if (type == 10) {
+         if (p >= end)
+            return false;
+         repeat = *p & 0x80;
+         run = (size_t)(*p++ & 0x7F) + 1;
+         if (run > count - i)
+            run = count - i;
+      }
+      for (size_t n = 0; n < run; n++, i++) {
+         if ((size_t)(end - p) < (size_t)bytes)
+            return false;
+         size_t row = i / width, column = i % width;
+         size_t at = (top_down ? row : height - 1 - row) * width + column;
+         image->pixels[at] = pack565(p[2], p[1], p[0]);
+         image->alpha[at] = bytes == 4 ? p[3] : 255;
+         if (!repeat || n == run - 1)
+            p += bytes;
+      }
+   }
+   return true;
+}
+
+static bool load_image(struct loaded_image *image, const char *path) {
+   struct mapped_file file;
+   if (!mapfile_open(&file, path)) {
+      core_log(RETRO_LOG_ERROR, "Failed to map sprite image: %s\n", path);
+      return false;
+   }
+   bool ok;
+   if (file.size >= 2 && file.data[0] == 'P' && file.data[1] == '6')
+      ok = load_ppm(image, file.data, file.size);
+   else
+      ok = load_tga(image, file.data, file.size);
+   mapfile_close(&file);
+   if (!ok) {
+      free(image->pixels);
+      memset(image, 0, sizeof(*image));
+      core_log(RETRO_LOG_ERROR, "Unsupported or damaged sprite image: %s\n", path);
+   }
+   return ok;
+}
+
+bool atlas_load(struct atlas *atlas, const char *path) {
+   memset(atlas, 0, sizeof(*atlas));
+   struct mapped_file list;
+   if (!mapfile_open(&list, path)) {
+      core_log(RETRO_LOG_ERROR, "Failed to map sprite list: %s\n", path);
+      return false;
+   }
+
+   // Image paths are relative to the directory holding the list
+   const char *slash = strrchr(path, '/');
+   const char *backslash = strrchr(path, '\\');
+   if (backslash > slash)
+      slash = backslash;
+   size_t dir_len = slash ? (size_t)(slash - path) + 1 : 0;
+
+   struct loaded_image *loaded = calloc(ATLAS_MAX_SPRITES, sizeof(*loaded));
+   struct atlas_image *images = calloc(ATLAS_MAX_SPRITES, sizeof(*images));
+   char (*names)[ATLAS_NAME_MAX] = calloc(ATLAS_MAX_SPRITES, sizeof(*names));
+   bool ok = loaded && images && names;
+   int count = 0;
+   const char *cur = (const char *)list.data;
+   const char *end = cur + list.size;
+   char line[512], file[1024];
+   while (ok && mapfile_next_line(&cur, end, line, sizeof(line))) {
+      char *p = line + strspn(line, " \t");
+      if (*p == '\0' || *p == '#')
+         continue;
+      size_t name_len = strcspn(p, " \t");
+      char *image_path = p + name_len;
+      image_path += strspn(image_path, " \t");
+      if (!*image_path || name_len >= ATLAS_NAME_MAX || count == ATLAS_MAX_SPRITES) {
+         core_log(RETRO_LOG_ERROR, "Bad sprite list entry in %s: %s\n", path, p);
+         ok = false;
+         break;
+      }
+      snprintf(file, sizeof(file), "%.*s%s", (int)dir_len, path, image_path);
+      memcpy(names[count], p, name_len);
+      ok = load_image(&loaded[count], file);
+      images[count].name = names[count];
+      images[count].width = loaded[count].width;
+      images[count].height = loaded[count].height;
+      images[count].pixels = loaded[count].pixels;
+      images[count].alpha = loaded[count].alpha;
+      count++;
+   }
+   mapfile_close(&list);
+
+   if (ok && count == 0)
+      core_log(RETRO_LOG_ERROR, "Sprite list is empty: %s\n", path);
+   if (ok && count > 0) {
+      ok = atlas_pack(atlas, images, count);
+      if (!ok)
+         core_log(RETRO_LOG_ERROR, "Sprites do not fit in a %dx%d atlas: %s\n",
+                  ATLAS_MAX_SIZE, ATLAS_MAX_SIZE, path);
+   }
+   ok = ok && count > 0;
+   for (int i = 0; loaded && i < count; i++)
+      free(loaded[i].pixels);
+   free(loaded);
+   free(images);
+   free(names);
+   if (ok)
+      core_log(RETRO_LOG_INFO, "Loaded %d sprites from %s into a %dx%d atlas\n",
+               count, path, atlas->width, atlas->height);
+   return ok;
+}
+
+void atlas_blit(const struct surface *target, const struct atlas *atlas, int sprite, int x, int y) {
+   struct surface_rect r;
+   if (sprite < 0 || sprite >= atlas->sprite_count)
+      return;
+   const struct atlas_sprite *s = &atlas->sprites[sprite];
+   if (!surface_clip(target, x, y, s->width, s->height, &r))
+      return;
+
+   for (int row = r.y0; row < r.y1; row++) {
+      size_t src = (size_t)(s->y + row - y) * atlas->width + s->x + r.x0 - x;
+      const uint16_t *pixels = &atlas->pixels[src];
+      const uint8_t *alpha = &atlas->alpha[src];
+      uint16_t *dst = surface_row(target, row) + r.x0;
+      int count = r.x1 - r.x0, i = 0;
+#ifdef HAVE_SSE2
+      // Alpha >= 128 has the top bit set; widen it to a 16-bit select mask
+      for (; i + 8 <= count; i += 8) {
+         __m128i a = _mm_loadl_epi64((const __m128i *)&alpha[i]);
+         __m128i mask = _mm_srai_epi16(_mm_unpacklo_epi8(a, a), 15);
+         __m128i px = _mm_loadu_si128((const __m128i *)&pixels[i]);
+         __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+         d = _mm_or_si128(_mm_and_si128(mask, px), _mm_andnot_si128(mask, d));
+         _mm_storeu_si128((__m128i *)&dst[i], d);
+      }
+#endif
+      for (; i < count; i++)
+         if (alpha[i] >= 128)
+            dst[i] = pixels[i];
+   }
+}
+
+void atlas_blit_blend(const struct surface *target, const struct atlas *atlas, int sprite,
+                      int x, int y, uint8_t opacity) {
+   struct surface_rect r;
+   if (sprite < 0 || sprite >= atlas->sprite_count)
+      return;
+   const struct atlas_sprite *s = &atlas->sprites[sprite];
+   if (!surface_clip(target, x, y, s->width, s->height, &r))
+      return;
+   for (int row = r.y0; row < r.y1; row++) {
+      size_t src = (size_t)(s->y + row - y) * atlas->width + s->x + r.x0 - x;
+      blend565_span(surface_row(target, row) + r.x0, &atlas->pixels[src], &atlas->alpha[src],
+                    opacity, r.x1 - r.x0);
+   }
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+   int64_t q = a / b;
+   return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static int64_t ceil_div(int64_t a, int64_t b) {
+   return -floor_div(-a, b);
+}
+
+// Narrow [*first, *last] to the steps i where start + i * step stays in
+// [0, limit), so the pixel loop needs no per-pixel bounds tests
+static void clip_span(int64_t start, int64_t step, int64_t limit, int64_t *first, int64_t *last) {
+   int64_t lo, hi;
+   if (step == 0) {
+      if (start >= 0 && start < limit)
+         return;
+      lo = 1;
+      hi = 0;
+   } else if (step > 0) {
+      lo = ceil_div(-start, step);
+      hi = floor_div(limit - 1 - start, step);
+   } else {
+      lo = ceil_div(limit - 1 - start, step);
+      hi = floor_div(-start, step);
+   }
+   if (*first < lo)
+      *first = lo;
+   if (*last > hi)
+      *last = hi;
+}
+
+static inline int32_t to_fixed(float v) {
+   return (int32_t)lrintf(v * 65536.0f);
+}
+
+void atlas_blit_affine(const struct surface *target, const struct atlas *atlas, int sprite,
+                       float cx, float cy, float angle, float scale) {
+   if (sprite < 0 || sprite >= atlas->sprite_count || !(scale > 0.0f))
+      return;
+   const struct atlas_sprite *s = &atlas->sprites[sprite];
+   float c = cosf(angle), sn = sinf(angle);
+
+   // Screen-space bounding box of the rotated sprite, clipped once
+   float half_w = s->width * 0.5f * scale, half_h = s->height * 0.5f * scale;
+   float extent_x = fabsf(c) * half_w + fabsf(sn) * half_h;
+   float extent_y = fabsf(sn) * half_w + fabsf(c) * half_h;
+   if (!(extent_x < 65536.0f && extent_y < 65536.0f && fabsf(cx) < 65536.0f && fabsf(cy) < 65536.0f))
+      return;
+   int x0 = (int)floorf(cx - extent_x), x1 = (int)ceilf(cx + extent_x);
+   int y0 = (int)floorf(cy - extent_y), y1 = (int)ceilf(cy + extent_y);
+   const struct surface_rect *clip = &target->clip;
+   x0 = x0 < clip->x0 ? clip->x0 : x0;
+   y0 = y0 < clip->y0 ? clip->y0 : y0;
+   x1 = x1 > clip->x1 ? clip->x1 : x1;
+   y1 = y1 > clip->y1 ? clip->y1 : y1;
+   if (x0 >= x1 || y0 >= y1)
+      return;
+
+   // Inverse mapping: sprite texels per destination pixel along x and y
+   float inv = 1.0f / scale;
+   int32_t du = to_fixed(c * inv), dv = to_fixed(-sn * inv);
+   int64_t u_limit = (int64_t)s->width << 16, v_limit = (int64_t)s->height << 16;
+   const uint16_t *pixels = &atlas->pixels[(size_t)s->y * atlas->width + s->x];
+   const uint8_t *alpha = &atlas->alpha[(size_t)s->y * atlas->width + s->x];
+   int pitch = atlas->width;
+
+   for (int y = y0; y < y1; y++) {
+      // Texel under the centre of the row's first pixel
+      float dx = x0 + 0.5f - cx, dy = y + 0.5f - cy;
+      int32_t u0 = to_fixed((dx * c + dy * sn) * inv + s->width * 0.5f);
+      int32_t v0 = to_fixed((dy * c - dx * sn) * inv + s->height * 0.5f);
+      int64_t first = 0, last = x1 - x0 - 1;
+      clip_span(u0, du, u_limit, &first, &last);
+      clip_span(v0, dv, v_limit, &first, &last);
+      if (first > last)
+         continue;
+
+      uint16_t *dst = surface_row(target, y) + x0;
+      int i = (int)first, end = (int)last + 1;
+      int32_t u = u0 + i * du, v = v0 + i * dv;
+#ifdef HAVE_SSE2
+      // Eight pixels at a time: texel indices come from one multiply-add of
+      // (u, v) pairs with (1, pitch), the texels are fetched one by one and
+      // the alpha test is a masked select, skipped for fully clear groups
+      const __m128i row_step = _mm_set1_epi32(pitch << 16 | 1);
+      const __m128i lane_du = _mm_setr_epi32(0, du, 2 * du, 3 * du);
+      const __m128i lane_dv = _mm_setr_epi32(0, dv, 2 * dv, 3 * dv);
+      for (; i + 8 <= end; i += 8) {
+         int32_t index[8];
+         for (int k = 0; k < 2; k++) {
+            __m128i uu = _mm_srli_epi32(_mm_add_epi32(_mm_set1_epi32(u), lane_du), 16);
+            __m128i vv = _mm_add_epi32(_mm_set1_epi32(v), lane_dv);
+            vv = _mm_andnot_si128(_mm_set1_epi32(0xFFFF), vv);
+            _mm_storeu_si128((__m128i *)&index[k * 4], _mm_madd_epi16(_mm_or_si128(uu, vv), row_step));
+            u += 4 * du;
+            v += 4 * dv;
+         }
+         uint8_t a[8];
+         uint16_t px[8];
+         for (int k = 0; k < 8; k++) {
+            a[k] = alpha[index[k]];
+            px[k] = pixels[index[k]];
+         }
+         __m128i va = _mm_loadl_epi64((const __m128i *)a);
+         __m128i mask = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 15);
+         int bits = _mm_movemask_epi8(mask);
+         if (bits == 0)
+            continue;
+         __m128i src = _mm_loadu_si128((const __m128i *)px);
+         if (bits != 0xFFFF) {
+            __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+            src = _mm_or_si128(_mm_and_si128(mask, src), _mm_andnot_si128(mask, d));
+         }
+         _mm_storeu_si128((__m128i *)&dst[i], src);
+      }
+#endif
+      for (; i < end; i++, u += du, v += dv) {
+         int32_t at = (v >> 16) * pitch + (u >> 16);
+         if (alpha[at] >= 128)
+            dst[i] = pixels[at];
+      }
+   }
+}
@@ -0,0 +1,170 @@
+#include <math.h>
+#include "blend.h"
+#include "simd.h"
+
+// Channels are blended as c + ((color_c - c) * a >> 8) with a in 0..256,
+// which keeps every intermediate inside a signed 16-bit lane. In gamma
+// mode they are squared, mixed and square-rooted in float instead.
+static bool gamma_mode = false;
+
+void blend565_set_gamma(bool enabled) {
+   gamma_mode = enabled;
+}
+
+static inline int mix_gamma(int d, int s, float w) {
+   float d2 = (float)(d * d);
+   return (int)lrintf(sqrtf(d2 + ((float)(s * s) - d2) * w));
+}
+
+static inline uint16_t blend565_pixel(uint16_t d, uint16_t color, int a) {
+   int r = d >> 11, g = (d >> 5) & 63, b = d & 31;
+   int cr = color >> 11, cg = (color >> 5) & 63, cb = color & 31;
+   if (gamma_mode) {
+      float w = (float)a * (1.0f / 256.0f);
+      r = mix_gamma(r, cr, w);
+      g = mix_gamma(g, cg, w);
+      b = mix_gamma(b, cb, w);
+   } else {
+      r += (cr - r) * a >> 8;
+      g += (cg - g) * a >> 8;
+      b += (cb - b) * a >> 8;
+   }
+   return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+#ifdef HAVE_SSE2
+// One channel of eight pixels in linear light: sqrt(d^2 + (s^2 - d^2) * w)
+static inline __m128i mix_gamma_sse2(__m128i d, __m128i s, __m128i a) {
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 scale = _mm_set1_ps(1.0f / 256.0f);
+   __m128i halves[2];
+   for (int h = 0; h < 2; h++) {
+      __m128 df = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(d, zero) : _mm_unpacklo_epi16(d, zero));
+      __m128 sf = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(s, zero) : _mm_unpacklo_epi16(s, zero));
+      __m128 w = _mm_mul_ps(_mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(a, zero) : _mm_unpacklo_epi16(a, zero)), scale);
+      __m128 d2 = _mm_mul_ps(df, df);
+      __m128 mixed = _mm_add_ps(d2, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sf, sf), d2), w));
+      halves[h] = _mm_cvtps_epi32(_mm_sqrt_ps(mixed));
+   }
+   return _mm_packs_epi32(halves[0], halves[1]);
+}
+
+// Blend eight pixels towards src by weights a (0..256 per lane)
+static inline __m128i blend8(__m128i d, __m128i s, __m128i a) {
+   const __m128i mask5 = _mm_set1_epi16(31);
+   const __m128i mask6 = _mm_set1_epi16(63);
+
+   // Unpack 565 into three 16-bit lanes
+   __m128i r = _mm_srli_epi16(d, 11);
+   __m128i g = _mm_and_si128(_mm_srli_epi16(d, 5), mask6);
+   __m128i b = _mm_and_si128(d, mask5);
+   __m128i sr = _mm_srli_epi16(s, 11);
+   __m128i sg = _mm_and_si128(_mm_srli_epi16(s, 5), mask6);
+   __m128i sb = _mm_and_si128(s, mask5);
+
+   if (gamma_mode) {
+      r = mix_gamma_sse2(r, sr, a);
+      g = mix_gamma_sse2(g, sg, a);
+      b = mix_gamma_sse2(b, sb, a);
+   } else {
+      // Multiply-add towards the source
+      r = _mm_add_epi16(r, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sr, r), a), 8));
+      g = _mm_add_epi16(g, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sg, g), a), 8));
+      b = _mm_add_epi16(b, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sb, b), a), 8));
+   }
+
+   // Repack
+   return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+}
+#endif
+
+void blend565_coverage_span(uint16_t *dst, const uint8_t *coverage, uint16_t color, int count) {
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i c = _mm_set1_epi16((short)color);
+   for (; i + 8 <= count; i += 8) {
+      __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(coverage + i)), zero);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(a, zero)) == 0xFFFF)
+         continue; // Fully transparent run, common around glyphs
+      a = _mm_add_epi16(a, _mm_srli_epi16(a, 7)); // 255 -> 256
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      _mm_storeu_si128((__m128i *)(dst + i), blend8(d, c, a));
+   }
+#endif
+   for (; i < count; i++) {
+      int a = coverage[i];
+      if (a)
+         dst[i] = blend565_pixel(dst[i], color, a + (a >> 7));
+   }
+}
+
+void blend565_fill_span(uint16_t *dst, uint16_t color, uint8_t alpha, int count) {
+   if (alpha == 0)
+      return;
+   bool half = alpha == 128 && !gamma_mode;
+   int a = alpha + (alpha >> 7);
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i c = _mm_set1_epi16((short)color);
+   const __m128i va = _mm_set1_epi16((short)a);
+   for (; i + 8 <= count; i += 8) {
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      d = alpha == 255 ? c : half ? blend565_half_sse2(d, c) : blend8(d, c, va);
+      _mm_storeu_si128((__m128i *)(dst + i), d);
+   }
+#endif
+   for (; i < count; i++)
+      dst[i] = alpha == 255 ? color : half ? blend565_half(dst[i], color) : blend565_pixel(dst[i], color, a);
+}
+
+void blend565_span(uint16_t *dst, const uint16_t *src, const uint8_t *alpha,
+                   uint8_t opacity, int count) {
+   if (opacity == 0)
+      return;
+   int op = opacity + (opacity >> 7);   // 0..256
+   // Opaque pixels at half opacity take the bit-trick path
+   bool half = opacity == 128 && !gamma_mode;
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i full = _mm_set1_epi16(255);
+   const __m128i vop = _mm_set1_epi16((short)op);
+   for (; i + 8 <= count; i += 8) {
+      __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(alpha + i)), zero);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(a, zero)) == 0xFFFF)
+         continue;
+      bool opaque = _mm_movemask_epi8(_mm_cmpeq_epi16(a, full)) == 0xFFFF;
+      __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+      if (opaque && op == 256) {
+         _mm_storeu_si128((__m128i *)(dst + i), s);
+         continue;
+      }
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      if (opaque && half) {
+         _mm_storeu_si128((__m128i *)(dst + i), blend565_half_sse2(d, s));
+         continue;
+      }
+      __m128i opaque_lanes = _mm_cmpeq_epi16(a, full);
+      if (op != 256)
+         a = _mm_srli_epi16(_mm_mullo_epi16(a, vop), 8);
+      a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+      __m128i out = blend8(d, s, a);
+      if (half)
+         out = _mm_or_si128(_mm_and_si128(opaque_lanes, blend565_half_sse2(d, s)),
+                            _mm_andnot_si128(opaque_lanes, out));
+      _mm_storeu_si128((__m128i *)(dst + i), out);
+   }
+#endif
+   for (; i < count; i++) {
+      int a = alpha[i];
+      if (a == 255 && half) {
+         dst[i] = blend565_half(dst[i], src[i]);
+         continue;
+      }
+      if (op != 256)
+         a = a * op >> 8;
+      if (a)
+         dst[i] = blend565_pixel(dst[i], src[i], a + (a >> 7));
+   }
+}
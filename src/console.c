@@ -0,0 +1,192 @@
+#include <string.h>
+#include "console.h"
+#include "text.h"
+#include "utf8.h"
+
+// Colors (RGB565)
+#define CONSOLE_COLOR_DEBUG 0x8410 // Grey
+#define CONSOLE_COLOR_INFO  0xFFFF // White
+#define CONSOLE_COLOR_WARN  0xFFE0 // Yellow
+#define CONSOLE_COLOR_ERROR 0xF800 // Red
+
+struct console_line {
+   char text[CONSOLE_LINE_BYTES];
+   uint16_t length;
+   uint16_t color;
+};
+
+static struct console_line lines[CONSOLE_HISTORY];
+static unsigned head;          // Next slot to write
+static unsigned count;         // Lines stored
+static int scroll;             // Lines scrolled back from the newest
+
+static uint16_t pixels[CONSOLE_WIDTH * CONSOLE_HEIGHT];
+static const struct surface canvas = {
+   .pixels = pixels, .pitch = CONSOLE_WIDTH,
+   .width = CONSOLE_WIDTH, .height = CONSOLE_HEIGHT,
+   .clip = { 0, 0, CONSOLE_WIDTH, CONSOLE_HEIGHT },
+};
+static bool pixels_valid;      // False forces a full redraw
+static unsigned pixels_font;   // text_font_generation() the pixels were drawn with
+static bool busy;              // Re-entrancy guard (drawing can log)
+
+static uint16_t level_color(enum retro_log_level level) {
+   switch (level) {
+      case RETRO_LOG_DEBUG: return CONSOLE_COLOR_DEBUG;
+      case RETRO_LOG_WARN:  return CONSOLE_COLOR_WARN;
+      case RETRO_LOG_ERROR: return CONSOLE_COLOR_ERROR;
+      default:              return CONSOLE_COLOR_INFO;
+   }
+}
+
+static int line_height(void) {
+   return text_font()->height;
+}
+
+// Whole lines that fit; the console only ever shows complete lines
+static int visible_lines(void) {
+   int n = CONSOLE_HEIGHT / line_height();
+   return n > 0 ? n : 1;
+}
+
+static int used_rows(void) {
+   int rows = visible_lines() * line_height();
+   return rows < CONSOLE_HEIGHT ? rows : CONSOLE_HEIGHT;
+}
+
+// Line by age, 0 being the newest; NULL past the stored history
+static const struct console_line *line_by_age(int age) {
+   if (age < 0 || (unsigned)age >= count)
+      return NULL;
+   return &lines[(head + CONSOLE_HISTORY - 1 - (unsigned)age) % CONSOLE_HISTORY];
+}
+
+static void clear_rows(int y, int rows) {
+   if (rows > 0)
+      memset(&pixels[y * CONSOLE_WIDTH], 0, (size_t)rows * CONSOLE_WIDTH * sizeof(uint16_t));
+}
+
+static void draw_line(int age, int y) {
+   const struct console_line *line = line_by_age(age);
+   if (line)
+      text_draw_span(&canvas, 0, y, line->text, line->length, line->color);
+}
+
+static void redraw_all(void) {
+   int lh = line_height(), n = visible_lines(), rows = used_rows();
+   // Marked valid up front: a line logged while drawing shifts every age
+   // by one, and store_line clears the flag again so the next blit redraws
+   pixels_valid = true;
+   pixels_font = text_font_generation();
+   clear_rows(0, CONSOLE_HEIGHT);
+   for (int i = 0; i < n; i++)
+      draw_line(scroll + i, rows - (i + 1) * lh);
+}
+
+// Move the visible rows by one line and rasterize only the line entering
+static void shift_newer(void) {
+   int lh = line_height(), rows = used_rows();
+   memmove(pixels, &pixels[lh * CONSOLE_WIDTH], (size_t)(rows - lh) * CONSOLE_WIDTH * sizeof(uint16_t));
+   clear_rows(rows - lh, lh);
+   draw_line(scroll, rows - lh);
+}
+
+static void shift_older(void) {
+   int lh = line_height(), rows = used_rows();
+   memmove(&pixels[lh * CONSOLE_WIDTH], pixels, (size_t)(rows - lh) * CONSOLE_WIDTH * sizeof(uint16_t));
+   clear_rows(0, lh);
+   draw_line(scroll + visible_lines() - 1, 0);
+}
+
+static void store_line(const char *text, size_t length, uint16_t color) {
+   struct console_line *line = &lines[head];
+   if (length >= CONSOLE_LINE_BYTES)
+      length = CONSOLE_LINE_BYTES - 1;
+   memcpy(line->text, text, length);
+   line->text[length] = '\0';
+   line->length = (uint16_t)length;
+   line->color = color;
+   head = (head + 1) % CONSOLE_HISTORY;
+   if (count < CONSOLE_HISTORY)
+      count++;
+
+   if (scroll > 0) {
+      // Keep a scrolled-back view still while new lines arrive
+      if (scroll < (int)count - visible_lines())
+         scroll++;
+      else
+         pixels_valid = false;
+   } else if (pixels_valid && !busy && pixels_font == text_font_generation()) {
+      busy = true;
+      shift_newer();
+      busy = false;
+   } else {
+      pixels_valid = false;
+   }
+}
+
+void console_push(enum retro_log_level level, const char *msg) {
+   uint16_t color = level_color(level);
+   int columns = CONSOLE_WIDTH / text_font()->width;
+   if (columns < 1)
+      columns = 1;
+
+   // Split on newlines, then wrap at the console width by codepoints
+   const uint8_t *p = (const uint8_t *)msg;
+   const uint8_t *end = p + strlen(msg);
+   while (p < end) {
+      const uint8_t *start = p;
+      int chars = 0;
+      while (p < end && *p != '\n' && chars < columns) {
+         utf8_decode(&p, end);
+         chars++;
+      }
+      store_line((const char *)start, (size_t)(p - start), color);
+      if (p < end && *p == '\n')
+         p++;
+   }
+}
+
+void console_scroll(int delta) {
+   int max_scroll = (int)count - visible_lines();
+   if (max_scroll < 0)
+      max_scroll = 0;
+   busy = true;
+   while (delta > 0 && scroll < max_scroll) {
+      scroll++;
+      delta--;
+      if (pixels_valid)
+         shift_older();
+   }
+   while (delta < 0 && scroll > 0) {
+      scroll--;
+      delta++;
+      if (pixels_valid)
+         shift_newer();
+   }
+   busy = false;
+}
+
+void console_blit(const struct surface *dst, int bottom) {
+   if (!pixels_valid || pixels_font != text_font_generation()) {
+      busy = true;
+      redraw_all();
+      busy = false;
+   }
+   int rows = used_rows();
+   int top = bottom - rows;
+   struct surface_rect r;
+   if (!surface_clip(dst, 0, top, CONSOLE_WIDTH, rows, &r))
+      return;
+   for (int y = r.y0; y < r.y1; y++)
+      memcpy(surface_row(dst, y) + r.x0, &pixels[(y - top) * CONSOLE_WIDTH + r.x0],
+             (size_t)(r.x1 - r.x0) * sizeof(uint16_t));
+}
+
+void console_clear(void) {
+   memset(lines, 0, sizeof(lines));
+   head = 0;
+   count = 0;
+   scroll = 0;
+   pixels_valid = false;
+}
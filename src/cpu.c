@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include "cpu.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_X86 1
+static void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+   int r[4];
+   __cpuidex(r, leaf, subleaf);
+   for (int i = 0; i < 4; i++)
+      regs[i] = (unsigned)r[i];
+}
+static unsigned long long xgetbv0(void) {
+   return _xgetbv(0);
+}
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_X86 1
+static void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+   __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+}
+static unsigned long long xgetbv0(void) {
+   unsigned lo, hi;
+   __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+   return ((unsigned long long)hi << 32) | lo;
+}
+#endif
+
+static unsigned detect(void) {
+   unsigned features = 0;
+#ifdef CPU_X86
+   unsigned regs[4];
+   cpuid(0, 0, regs);
+   unsigned max_leaf = regs[0];
+   if (max_leaf < 1)
+      return 0;
+   cpuid(1, 0, regs);
+   if (regs[3] & (1u << 26)) features |= CPU_FEATURE_SSE2;
+   if (regs[2] & (1u << 9))  features |= CPU_FEATURE_SSSE3;
+   if (regs[2] & (1u << 19)) features |= CPU_FEATURE_SSE41;
+   // AVX2 also needs the OS to save YMM state (OSXSAVE + XCR0 bits 1-2)
+   bool os_avx = (regs[2] & (1u << 27)) && (regs[2] & (1u << 28)) && (xgetbv0() & 0x6) == 0x6;
+   if (os_avx && max_leaf >= 7) {
+      cpuid(7, 0, regs);
+      if (regs[1] & (1u << 5))
+         features |= CPU_FEATURE_AVX2;
+   }
+#endif
+   return features;
+}
+
+unsigned cpu_features(void) {
+   static unsigned features;
+   static bool detected;
+   if (!detected) {
+      features = detect();
+      detected = true;
+   }
+   return features;
+}
+
+int cpu_count(void) {
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   int count = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+   int count = 1;
+#endif
+   return count > 0 ? count : 1;
+}
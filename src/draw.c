@@ -0,0 +1,409 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "draw.h"
+#include "blend.h"
+#include "simd.h"
+
+// Half-widths of a circle or ellipse per row distance from its centre,
+// filled by the midpoint algorithms and turned into spans afterwards
+static int extents[DRAW_MAX_RADIUS + 2];
+
+// Unclipped span fill
+static void fill_span(uint16_t *dst, uint16_t color, int count) {
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i c = _mm_set1_epi16((short)color);
+   for (; i + 8 <= count; i += 8)
+      _mm_storeu_si128((__m128i *)(dst + i), c);
+#endif
+   for (; i < count; i++)
+      dst[i] = color;
+}
+
+void draw_span(const struct surface *dst, int x0, int x1, int y, uint16_t color) {
+   const struct surface_rect *c = &dst->clip;
+   if (y < c->y0 || y >= c->y1)
+      return;
+   if (x0 > x1) {
+      int t = x0; x0 = x1; x1 = t;
+   }
+   if (x0 < c->x0) x0 = c->x0;
+   if (x1 >= c->x1) x1 = c->x1 - 1;
+   if (x0 <= x1)
+      fill_span(surface_row(dst, y) + x0, color, x1 - x0 + 1);
+}
+
+void draw_rect(const struct surface *dst, int x, int y, int width, int height, uint16_t color) {
+   struct surface_rect r;
+   if (!surface_clip(dst, x, y, width, height, &r))
+      return;
+   for (int row = r.y0; row < r.y1; row++)
+      fill_span(surface_row(dst, row) + r.x0, color, r.x1 - r.x0);
+}
+
+void draw_rect_blend(const struct surface *dst, int x, int y, int width, int height,
+                     uint16_t color, uint8_t alpha) {
+   struct surface_rect r;
+   if (!surface_clip(dst, x, y, width, height, &r))
+      return;
+   for (int row = r.y0; row < r.y1; row++)
+      blend565_fill_span(surface_row(dst, row) + r.x0, color, alpha, r.x1 - r.x0);
+}
+
+// Floor of a / b for b > 0
+static long long floor_div(long long a, long long b) {
+   long long q = a / b;
+   return (a % b) && a < 0 ? q - 1 : q;
+}
+
+// Bresenham lines are clipped exactly: rather than moving the endpoints,
+// the visible part of the major axis is found and the error term is set
+// up as if the line had been stepped there from its real start. Along a
+// line with major delta dmaj and minor delta dmin, step k has moved the
+// minor axis by n(k) = ceil((2 * dmin * k - dmaj) / (2 * dmaj)).
+static long long minor_steps(long long dmaj, long long dmin, long long k) {
+   if (dmaj == 0)
+      return 0; // Single point
+   return -floor_div(dmaj - 2 * dmin * k, 2 * dmaj);
+}
+
+// Narrow [*k0, *k1] to the steps whose minor offset lies in [lo, hi]
+static void clip_minor(long long dmaj, long long dmin, long long lo, long long hi,
+                       long long *k0, long long *k1) {
+   if (dmin == 0) {
+      if (lo > 0 || hi < 0)
+         *k1 = *k0 - 1;
+      return;
+   }
+   if (lo > 0) {
+      long long k = floor_div(2 * dmaj * (lo - 1) + dmaj, 2 * dmin) + 1;
+      if (*k0 < k) *k0 = k;
+   }
+   long long k = hi < 0 ? -1 : floor_div(2 * dmaj * hi + dmaj, 2 * dmin);
+   if (*k1 > k) *k1 = k;
+}
+
+void draw_line(const struct surface *dst, int x0, int y0, int x1, int y1, uint16_t color) {
+   const struct surface_rect *c = &dst->clip;
+   long long dx = llabs((long long)x1 - x0), dy = llabs((long long)y1 - y0);
+
+   if (dx >= dy) {
+      // X-major: pixels sharing a row form one span
+      if (x0 > x1) {
+         int t = x0; x0 = x1; x1 = t;
+         t = y0; y0 = y1; y1 = t;
+      }
+      int sy = y1 > y0 ? 1 : -1;
+      long long k0 = (long long)c->x0 - x0 > 0 ? (long long)c->x0 - x0 : 0;
+      long long k1 = (long long)c->x1 - 1 - x0 < dx ? (long long)c->x1 - 1 - x0 : dx;
+      if (sy > 0)
+         clip_minor(dx, dy, (long long)c->y0 - y0, (long long)c->y1 - 1 - y0, &k0, &k1);
+      else
+         clip_minor(dx, dy, (long long)y0 - (c->y1 - 1), (long long)y0 - c->y0, &k0, &k1);
+      if (k0 > k1)
+         return;
+
+      long long n = minor_steps(dx, dy, k0);
+      long long err = 2 * dy * (k0 + 1) - dx - 2 * dx * n;
+      int x = (int)(x0 + k0), x_end = (int)(x0 + k1);
+      int y = (int)(y0 + sy * n);
+      int run = x;
+      for (; x < x_end; x++) {
+         if (err > 0) {
+            fill_span(surface_row(dst, y) + run, color, x - run + 1);
+            run = x + 1;
+            y += sy;
+            err -= 2 * dx;
+         }
+         err += 2 * dy;
+      }
+      fill_span(surface_row(dst, y) + run, color, x_end - run + 1);
+   } else {
+      // Y-major: one pixel per row
+      if (y0 > y1) {
+         int t = x0; x0 = x1; x1 = t;
+         t = y0; y0 = y1; y1 = t;
+      }
+      int sx = x1 > x0 ? 1 : -1;
+      long long k0 = (long long)c->y0 - y0 > 0 ? (long long)c->y0 - y0 : 0;
+      long long k1 = (long long)c->y1 - 1 - y0 < dy ? (long long)c->y1 - 1 - y0 : dy;
+      if (sx > 0)
+         clip_minor(dy, dx, (long long)c->x0 - x0, (long long)c->x1 - 1 - x0, &k0, &k1);
+      else
+         clip_minor(dy, dx, (long long)x0 - (c->x1 - 1), (long long)x0 - c->x0, &k0, &k1);
+      if (k0 > k1)
+         return;
+
+      long long n = minor_steps(dy, dx, k0);
+      long long err = 2 * dx * (k0 + 1) - dy - 2 * dy * n;
+      uint16_t *p = surface_row(dst, (int)(y0 + k0)) + x0 + sx * n;
+      for (long long k = k0; k <= k1; k++) {
+         *p = color;
+         p += dst->pitch;
+         if (err > 0) {
+            p += sx;
+            err -= 2 * dy;
+         }
+         err += 2 * dx;
+      }
+   }
+}
+
+static inline void extend(int dy, int x) {
+   if (extents[dy] < x)
+      extents[dy] = x;
+}
+
+// Midpoint circle: each step covers one row near the horizontal axis and
+// one near the vertical axis
+static void circle_extents(int r) {
+   for (int i = 0; i <= r; i++)
+      extents[i] = -1;
+   int x = r, y = 0, err = 1 - r;
+   while (x >= y) {
+      extend(y, x);
+      extend(x, y);
+      y++;
+      if (err < 0) {
+         err += 2 * y + 1;
+      } else {
+         x--;
+         err += 2 * (y - x) + 1;
+      }
+   }
+}
+
+// Midpoint ellipse (Kennedy's integer formulation): the steep part steps
+// rows out from the horizontal axis, the flat part steps columns in from
+// the top
+static void ellipse_extents(int rx, int ry) {
+   for (int i = 0; i <= ry; i++)
+      extents[i] = -1;
+   long long two_a2 = 2LL * rx * rx, two_b2 = 2LL * ry * ry;
+
+   long long x = rx, y = 0;
+   long long x_change = (long long)ry * ry * (1 - 2LL * rx), y_change = (long long)rx * rx;
+   long long error = 0, stop_x = two_b2 * rx, stop_y = 0;
+   while (stop_x >= stop_y) {
+      extend((int)y, (int)x);
+      y++;
+      stop_y += two_a2;
+      error += y_change;
+      y_change += two_a2;
+      if (2 * error + x_change > 0) {
+         x--;
+         stop_x -= two_b2;
+         error += x_change;
+         x_change += two_b2;
+      }
+   }
+
+   x = 0;
+   y = ry;
+   x_change = (long long)ry * ry;
+   y_change = (long long)rx * rx * (1 - 2LL * ry);
+   error = 0;
+   stop_x = 0;
+   stop_y = two_a2 * ry;
+   while (stop_x <= stop_y) {
+      extend((int)y, (int)x);
+      x++;
+      stop_x += two_b2;
+      error += x_change;
+      x_change += two_b2;
+      if (2 * error + y_change > 0) {
+         y--;
+         stop_y -= two_a2;
+         error += y_change;
+         y_change += two_a2;
+      }
+   }
+
+   // Rows the two halves did not reach continue the row below
+   for (int i = 1; i <= ry; i++)
+      if (extents[i] < 0)
+         extents[i] = extents[i - 1];
+}
+
+// Emit the rows of a shape whose half-widths are in extents[0..ry]. An
+// outline row covers the columns between its half-width and the one of
+// the row outside it, so steep parts stay connected.
+static void emit_rows(const struct surface *dst, int cx, int cy, int ry, bool fill, uint16_t color) {
+   // Rows inside the scissor on at least one side, as distances from the centre
+   const struct surface_rect *c = &dst->clip;
+   int near_top = cy - (c->y1 - 1), near_bottom = c->y0 - cy;
+   int dy0 = near_top < near_bottom ? near_top : near_bottom;
+   int dy1 = cy - c->y0 > c->y1 - 1 - cy ? cy - c->y0 : c->y1 - 1 - cy;
+   if (dy0 < 0) dy0 = 0;
+   if (dy1 > ry) dy1 = ry;
+   for (int dy = dy0; dy <= dy1; dy++) {
+      int xw = extents[dy];
+      int lo = 0;
+      if (!fill) {
+         int inner = dy < ry ? extents[dy + 1] : -1;
+         lo = inner + 1 < xw ? inner + 1 : xw;
+      }
+      for (int side = 0; side < (dy ? 2 : 1); side++) {
+         int y = side ? cy - dy : cy + dy;
+         if (lo <= 0) {
+            draw_span(dst, cx - xw, cx + xw, y, color);
+         } else {
+            draw_span(dst, cx - xw, cx - lo, y, color);
+            draw_span(dst, cx + lo, cx + xw, y, color);
+         }
+      }
+   }
+}
+
+static bool offscreen(const struct surface *dst, int cx, int cy, int rx, int ry) {
+   const struct surface_rect *c = &dst->clip;
+   return cx + rx < c->x0 || cx - rx >= c->x1 || cy + ry < c->y0 || cy - ry >= c->y1;
+}
+
+static void circle(const struct surface *dst, int cx, int cy, int r, bool fill, uint16_t color) {
+   if (r < 0)
+      return;
+   if (r > DRAW_MAX_RADIUS)
+      r = DRAW_MAX_RADIUS;
+   if (offscreen(dst, cx, cy, r, r))
+      return;
+   circle_extents(r);
+   emit_rows(dst, cx, cy, r, fill, color);
+}
+
+static void ellipse(const struct surface *dst, int cx, int cy, int rx, int ry,
+                    bool fill, uint16_t color) {
+   if (rx < 0 || ry < 0)
+      return;
+   if (rx > DRAW_MAX_RADIUS) rx = DRAW_MAX_RADIUS;
+   if (ry > DRAW_MAX_RADIUS) ry = DRAW_MAX_RADIUS;
+   if (offscreen(dst, cx, cy, rx, ry))
+      return;
+   if (rx == 0 || ry == 0) {
+      // Degenerate: a single row or column
+      for (int i = 0; i <= ry; i++)
+         extents[i] = rx;
+      fill = true;
+   } else {
+      ellipse_extents(rx, ry);
+   }
+   emit_rows(dst, cx, cy, ry, fill, color);
+}
+
+void draw_circle(const struct surface *dst, int cx, int cy, int r, uint16_t color) {
+   circle(dst, cx, cy, r, false, color);
+}
+
+void draw_circle_fill(const struct surface *dst, int cx, int cy, int r, uint16_t color) {
+   circle(dst, cx, cy, r, true, color);
+}
+
+void draw_ellipse(const struct surface *dst, int cx, int cy, int rx, int ry, uint16_t color) {
+   ellipse(dst, cx, cy, rx, ry, false, color);
+}
+
+void draw_ellipse_fill(const struct surface *dst, int cx, int cy, int rx, int ry, uint16_t color) {
+   ellipse(dst, cx, cy, rx, ry, true, color);
+}
+
+void draw_polygon(const struct surface *dst, const struct draw_point *points, int count,
+                  uint16_t color) {
+   for (int i = 0; i < count; i++) {
+      const struct draw_point *a = &points[i], *b = &points[(i + 1) % count];
+      draw_line(dst, a->x, a->y, b->x, b->y, color);
+   }
+}
+
+// Polygon edge in the edge table; x is 16.16 fixed point at the centre of
+// the current row
+struct poly_edge {
+   int y_start, y_end;  // Rows [y_start, y_end)
+   int64_t x, dxdy;
+};
+
+static int compare_edges(const void *a, const void *b) {
+   return ((const struct poly_edge *)a)->y_start - ((const struct poly_edge *)b)->y_start;
+}
+
+#define POLY_STACK_EDGES 64
+
+void draw_polygon_fill(const struct surface *dst, const struct draw_point *points, int count,
+                       uint16_t color) {
+   if (count < 3)
+      return;
+   struct poly_edge stack_edges[POLY_STACK_EDGES];
+   struct poly_edge *stack_active[POLY_STACK_EDGES];
+   struct poly_edge *edges = stack_edges;
+   struct poly_edge **active = stack_active;
+   if (count > POLY_STACK_EDGES) {
+      edges = malloc(count * sizeof(*edges));
+      active = malloc(count * sizeof(*active));
+      if (!edges || !active) {
+         free(edges);
+         free(active);
+         return;
+      }
+   }
+
+   // Edge table: non-horizontal edges covering at least one row in the scissor
+   int edge_count = 0;
+   for (int i = 0; i < count; i++) {
+      const struct draw_point *a = &points[i], *b = &points[(i + 1) % count];
+      if (a->y == b->y)
+         continue;
+      if (a->y > b->y) {
+         const struct draw_point *t = a; a = b; b = t;
+      }
+      // Rows whose centres fall inside [a.y, b.y)
+      int y_start = a->y < dst->clip.y0 ? dst->clip.y0 : a->y;
+      int y_end = b->y > dst->clip.y1 ? dst->clip.y1 : b->y;
+      if (y_start >= y_end)
+         continue;
+      struct poly_edge *e = &edges[edge_count++];
+      e->dxdy = (int64_t)(b->x - a->x) * 65536 / (b->y - a->y);
+      e->x = (int64_t)a->x * 65536 + e->dxdy * (y_start - a->y) + e->dxdy / 2;
+      e->y_start = y_start;
+      e->y_end = y_end;
+   }
+   qsort(edges, edge_count, sizeof(*edges), compare_edges);
+
+   int next = 0, active_count = 0;
+   int y = edge_count ? edges[0].y_start : dst->clip.y1;
+   for (; y < dst->clip.y1 && (next < edge_count || active_count); y++) {
+      if (!active_count)
+         y = edges[next].y_start; // Skip rows between disjoint parts
+      // Retire finished edges, then add the ones starting on this row
+      int kept = 0;
+      for (int i = 0; i < active_count; i++)
+         if (active[i]->y_end > y)
+            active[kept++] = active[i];
+      active_count = kept;
+      while (next < edge_count && edges[next].y_start == y)
+         active[active_count++] = &edges[next++];
+
+      // Keep the active edges sorted by x; they rarely swap, so insertion
+      // sort is close to linear
+      for (int i = 1; i < active_count; i++) {
+         struct poly_edge *e = active[i];
+         int j = i;
+         for (; j > 0 && active[j - 1]->x > e->x; j--)
+            active[j] = active[j - 1];
+         active[j] = e;
+      }
+
+      // Even-odd: fill between pairs, covering pixels whose centre is inside
+      for (int i = 0; i + 1 < active_count; i += 2) {
+         int x0 = (int)((active[i]->x + 0x7FFF) >> 16);
+         int x1 = (int)((active[i + 1]->x + 0x7FFF) >> 16) - 1;
+         if (x0 <= x1)
+            draw_span(dst, x0, x1, y, color);
+      }
+      for (int i = 0; i < active_count; i++)
+         active[i]->x += active[i]->dxdy;
+   }
+
+   if (edges != stack_edges) {
+      free(edges);
+      free(active);
+   }
+}
@@ -0,0 +1,269 @@
+#include <math.h>
+#include <stdbool.h>
+#include "draw_aa.h"
+#include "blend.h"
+#include "simd.h"
+
+// Coverage is computed in chunks of at most this many pixels per span
+#define AA_SPAN_MAX 256
+
+struct aa_shape {
+   float cx, cy;
+   float rx, ry;       // Radii; equal for circles and rings
+   float half_width;   // Half the ring stroke
+   // Wu lines, in pixel-centre coordinates along the major axis
+   float x0, y0, gradient;
+   int first, last;    // Major-axis pixels covered
+   float first_weight, last_weight;
+};
+
+// Fill out[0..count) with coverage of pixels x..x+count-1 on row y
+typedef void (*coverage_fn)(const struct aa_shape *shape, int x, int y, int count, uint8_t *out);
+
+static inline uint8_t to_coverage(float c) {
+   return c <= 0.0f ? 0 : c >= 1.0f ? 255 : (uint8_t)(c * 255.0f + 0.5f);
+}
+
+// Clip [x0, x1] of row y to the scissor and blend it chunk by chunk
+static void blend_span(const struct surface *dst, int x0, int x1, int y,
+                       coverage_fn fn, const struct aa_shape *shape, uint16_t color) {
+   uint8_t coverage[AA_SPAN_MAX];
+   const struct surface_rect *c = &dst->clip;
+   if (y < c->y0 || y >= c->y1)
+      return;
+   if (x0 < c->x0) x0 = c->x0;
+   if (x1 >= c->x1) x1 = c->x1 - 1;
+   for (int x = x0; x <= x1; x += AA_SPAN_MAX) {
+      int count = x1 - x + 1 < AA_SPAN_MAX ? x1 - x + 1 : AA_SPAN_MAX;
+      fn(shape, x, y, count, coverage);
+      blend565_coverage_span(surface_row(dst, y) + x, coverage, color, count);
+   }
+}
+
+// Wu lines, x-major: coverage falls off linearly with the vertical
+// distance from the line to the pixel centre
+static void line_x_coverage(const struct aa_shape *s, int x, int y, int count, uint8_t *out) {
+   for (int i = 0; i < count; i++) {
+      int px = x + i;
+      float c = 1.0f - fabsf(s->y0 + s->gradient * (px - s->x0) - y);
+      if (px == s->first) c *= s->first_weight;
+      if (px == s->last) c *= s->last_weight;
+      out[i] = to_coverage(c);
+   }
+}
+
+// Y-major: the same with the axes swapped; s->x0/y0 hold the start row
+// and column
+static void line_y_coverage(const struct aa_shape *s, int x, int y, int count, uint8_t *out) {
+   float weight = y == s->first ? s->first_weight : y == s->last ? s->last_weight : 1.0f;
+   float xl = s->y0 + s->gradient * (y - s->x0);
+   for (int i = 0; i < count; i++)
+      out[i] = to_coverage((1.0f - fabsf(xl - (x + i))) * weight);
+}
+
+void draw_aa_line(const struct surface *dst, float x0, float y0, float x1, float y1, uint16_t color) {
+   // Work in pixel-centre coordinates, where pixel (x, y) sits at (x, y)
+   x0 -= 0.5f; y0 -= 0.5f;
+   x1 -= 0.5f; y1 -= 0.5f;
+   struct aa_shape s;
+   bool steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+   if (steep) {
+      float t = x0; x0 = y0; y0 = t;
+      t = x1; x1 = y1; y1 = t;
+   }
+   if (x0 > x1) {
+      float t = x0; x0 = x1; x1 = t;
+      t = y0; y0 = y1; y1 = t;
+   }
+   // Major axis limits of the scissor, to skip the parts far outside it
+   const struct surface_rect *c = &dst->clip;
+   float major_min = (float)(steep ? c->y0 : c->x0) - 1.0f;
+   float major_max = (float)(steep ? c->y1 : c->x1);
+   if (x1 < major_min || x0 > major_max)
+      return;
+
+   s.x0 = x0;
+   s.y0 = y0;
+   s.gradient = x1 > x0 ? (y1 - y0) / (x1 - x0) : 0.0f;
+   s.first = (int)floorf(x0 + 0.5f);
+   s.last = (int)floorf(x1 + 0.5f);
+   // End pixels are weighted by how much of them the segment spans
+   s.first_weight = 1.0f - (x0 + 0.5f - s.first);
+   s.last_weight = x1 + 0.5f - s.last;
+   if (s.first == s.last)
+      s.first_weight = s.last_weight = x1 - x0;
+   int first = s.first < (int)major_min ? (int)major_min : s.first;
+   int last = s.last > (int)major_max ? (int)major_max : s.last;
+
+   if (steep) {
+      // One span of two pixels per row
+      for (int y = first; y <= last; y++) {
+         int x = (int)floorf(s.y0 + s.gradient * (y - s.x0));
+         blend_span(dst, x, x + 1, y, line_y_coverage, &s, color);
+      }
+      return;
+   }
+
+   // One span per row: the columns where the line is within a pixel
+   float ya = s.y0 + s.gradient * (first - s.x0);
+   float yb = s.y0 + s.gradient * (last - s.x0);
+   int row0 = (int)floorf(ya < yb ? ya : yb);
+   int row1 = (int)ceilf(ya < yb ? yb : ya);
+   if (row0 < c->y0) row0 = c->y0;
+   if (row1 >= c->y1) row1 = c->y1 - 1;
+   for (int y = row0; y <= row1; y++) {
+      int xa = first, xb = last;
+      if (s.gradient != 0.0f) {
+         float a = s.x0 + (y - 1 - s.y0) / s.gradient;
+         float b = s.x0 + (y + 1 - s.y0) / s.gradient;
+         if (a > b) {
+            float t = a; a = b; b = t;
+         }
+         if (xa < (int)floorf(a)) xa = (int)floorf(a);
+         if (xb > (int)ceilf(b)) xb = (int)ceilf(b);
+      } else if (fabsf(s.y0 - y) >= 1.0f) {
+         continue;
+      }
+      if (xa <= xb)
+         blend_span(dst, xa, xb, y, line_x_coverage, &s, color);
+   }
+}
+
+// Circles and rings use the exact distance to the centre; coverage is the
+// part of a one-pixel-wide box filter inside the edge
+static void circle_coverage(const struct aa_shape *s, int x, int y, int count, uint8_t *out) {
+   float dy = y + 0.5f - s->cy;
+   float dy2 = dy * dy;
+   float edge = s->rx + 0.5f;
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 step = _mm_set1_ps(4.0f);
+   const __m128 vdy2 = _mm_set1_ps(dy2);
+   const __m128 vedge = _mm_set1_ps(edge);
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(255.0f);
+   __m128 dx = _mm_add_ps(_mm_set1_ps(x + 0.5f - s->cx), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+   for (; i + 4 <= count; i += 4) {
+      __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), vdy2));
+      __m128 c = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vedge, d), _mm_setzero_ps()), one);
+      __m128i ci = _mm_cvtps_epi32(_mm_mul_ps(c, scale));
+      ci = _mm_packus_epi16(_mm_packs_epi32(ci, zero), zero);
+      *(int *)(out + i) = _mm_cvtsi128_si32(ci);
+      dx = _mm_add_ps(dx, step);
+   }
+#endif
+   for (; i < count; i++) {
+      float dx = x + i + 0.5f - s->cx;
+      out[i] = to_coverage(edge - sqrtf(dx * dx + dy2));
+   }
+}
+
+static void ring_coverage(const struct aa_shape *s, int x, int y, int count, uint8_t *out) {
+   float dy = y + 0.5f - s->cy;
+   float dy2 = dy * dy;
+   float edge = s->half_width + 0.5f;
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 step = _mm_set1_ps(4.0f);
+   const __m128 vdy2 = _mm_set1_ps(dy2);
+   const __m128 vr = _mm_set1_ps(s->rx);
+   const __m128 vedge = _mm_set1_ps(edge);
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(255.0f);
+   const __m128 sign = _mm_set1_ps(-0.0f);
+   __m128 dx = _mm_add_ps(_mm_set1_ps(x + 0.5f - s->cx), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+   for (; i + 4 <= count; i += 4) {
+      __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), vdy2));
+      __m128 off = _mm_andnot_ps(sign, _mm_sub_ps(d, vr)); // |d - r|
+      __m128 c = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vedge, off), _mm_setzero_ps()), one);
+      __m128i ci = _mm_cvtps_epi32(_mm_mul_ps(c, scale));
+      ci = _mm_packus_epi16(_mm_packs_epi32(ci, zero), zero);
+      *(int *)(out + i) = _mm_cvtsi128_si32(ci);
+      dx = _mm_add_ps(dx, step);
+   }
+#endif
+   for (; i < count; i++) {
+      float dx = x + i + 0.5f - s->cx;
+      out[i] = to_coverage(edge - fabsf(sqrtf(dx * dx + dy2) - s->rx));
+   }
+}
+
+// Ellipses estimate the distance to the edge from the implicit function
+// and its gradient, which is exact on the axes and close elsewhere
+static void ellipse_coverage(const struct aa_shape *s, int x, int y, int count, uint8_t *out) {
+   float dy = y + 0.5f - s->cy;
+   float ky = dy / (s->ry * s->ry);
+   float fy = dy * ky;
+   for (int i = 0; i < count; i++) {
+      float dx = x + i + 0.5f - s->cx;
+      float kx = dx / (s->rx * s->rx);
+      float f = dx * kx + fy - 1.0f;
+      float g = 2.0f * sqrtf(kx * kx + ky * ky);
+      out[i] = g > 0.0f ? to_coverage(0.5f - f / g) : 255;
+   }
+}
+
+void draw_aa_circle_fill(const struct surface *dst, float cx, float cy, float r, uint16_t color) {
+   if (r <= 0.0f)
+      return;
+   struct aa_shape s = { .cx = cx, .cy = cy, .rx = r, .ry = r };
+   float edge = r + 0.5f;
+   int y0 = (int)floorf(cy - edge), y1 = (int)floorf(cy + edge);
+   if (y0 < dst->clip.y0) y0 = dst->clip.y0;
+   if (y1 >= dst->clip.y1) y1 = dst->clip.y1 - 1;
+   for (int y = y0; y <= y1; y++) {
+      float dy = y + 0.5f - cy;
+      if (fabsf(dy) >= edge)
+         continue;
+      float half = sqrtf(edge * edge - dy * dy);
+      blend_span(dst, (int)floorf(cx - half), (int)floorf(cx + half), y,
+                 circle_coverage, &s, color);
+   }
+}
+
+void draw_aa_ring(const struct surface *dst, float cx, float cy, float r, float width, uint16_t color) {
+   if (r <= 0.0f || width <= 0.0f)
+      return;
+   struct aa_shape s = { .cx = cx, .cy = cy, .rx = r, .ry = r, .half_width = width * 0.5f };
+   float outer = r + s.half_width + 0.5f;
+   float inner = r - s.half_width - 0.5f;
+   int y0 = (int)floorf(cy - outer), y1 = (int)floorf(cy + outer);
+   if (y0 < dst->clip.y0) y0 = dst->clip.y0;
+   if (y1 >= dst->clip.y1) y1 = dst->clip.y1 - 1;
+   for (int y = y0; y <= y1; y++) {
+      float dy = y + 0.5f - cy;
+      if (fabsf(dy) >= outer)
+         continue;
+      float half = sqrtf(outer * outer - dy * dy);
+      int xa = (int)floorf(cx - half), xb = (int)floorf(cx + half);
+      if (inner > 0.0f && fabsf(dy) < inner) {
+         // Two spans around the empty middle
+         float hole = sqrtf(inner * inner - dy * dy);
+         blend_span(dst, xa, (int)floorf(cx - hole), y, ring_coverage, &s, color);
+         blend_span(dst, (int)floorf(cx + hole), xb, y, ring_coverage, &s, color);
+      } else {
+         blend_span(dst, xa, xb, y, ring_coverage, &s, color);
+      }
+   }
+}
+
+void draw_aa_ellipse_fill(const struct surface *dst, float cx, float cy, float rx, float ry,
+                          uint16_t color) {
+   if (rx <= 0.0f || ry <= 0.0f)
+      return;
+   struct aa_shape s = { .cx = cx, .cy = cy, .rx = rx, .ry = ry };
+   float ex = rx + 0.5f, ey = ry + 0.5f;
+   int y0 = (int)floorf(cy - ey), y1 = (int)floorf(cy + ey);
+   if (y0 < dst->clip.y0) y0 = dst->clip.y0;
+   if (y1 >= dst->clip.y1) y1 = dst->clip.y1 - 1;
+   for (int y = y0; y <= y1; y++) {
+      float t = (y + 0.5f - cy) / ey;
+      if (fabsf(t) >= 1.0f)
+         continue;
+      float half = ex * sqrtf(1.0f - t * t);
+      blend_span(dst, (int)floorf(cx - half), (int)floorf(cx + half), y,
+                 ellipse_coverage, &s, color);
+   }
+}
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "font.h"
+#include "core_log.h"
+#include "utf8.h"
+
+#define PSF2_HEADER_SIZE  32
+#define PSF2_HAS_UNICODE  0x01
+#define PSF2_SEPARATOR    0xFF
+#define PSF2_STARTSEQ     0xFE
+
+static const struct font builtin_font = {
+   .width = 8,
+   .height = 8,
+   .stride = 1,
+   .glyph_bytes = 8,
+   .glyph_count = FONT_GLYPH_COUNT,
+   .glyphs = &font_8x8[0][0],
+   .boxes = font_8x8_box,
+   .direct_first = FONT_FIRST_CHAR,
+   .direct_count = FONT_GLYPH_COUNT,
+};
+
+const struct font *font_builtin(void) {
+   return &builtin_font;
+}
+
+// Fibonacci hashing spreads consecutive codepoints across the table
+static uint32_t hash_slot(uint32_t codepoint, uint32_t mask) {
+   return (codepoint * 2654435761u >> 7) & mask;
+}
+
+int font_find_glyph(const struct font *font, uint32_t codepoint) {
+   if (codepoint - font->direct_first < font->direct_count)
+      return (int)(codepoint - font->direct_first);
+   if (!font->hash_mask)
+      return -1;
+   for (uint32_t slot = hash_slot(codepoint, font->hash_mask);; slot = (slot + 1) & font->hash_mask) {
+      uint32_t key = font->hash_keys[slot];
+      if (key == codepoint)
+         return (int)font->hash_glyphs[slot];
+      if (key == FONT_HASH_EMPTY)
+         return -1;
+   }
+}
+
+static bool hash_resize(struct font *font, uint32_t capacity) {
+   uint32_t *keys = malloc(capacity * sizeof(*keys));
+   uint32_t *glyphs = malloc(capacity * sizeof(*glyphs));
+   if (!keys || !glyphs) {
+      free(keys);
+      free(glyphs);
+      return false;
+   }
+   memset(keys, 0xFF, capacity * sizeof(*keys));
+   uint32_t mask = capacity - 1;
+   if (font->hash_mask) {
+      for (uint32_t i = 0; i <= font->hash_mask; i++) {
+         uint32_t key = font->hash_keys[i];
+         if (key == FONT_HASH_EMPTY)
+            continue;
+         uint32_t slot = hash_slot(key, mask);
+         while (keys[slot] != FONT_HASH_EMPTY)
+            slot = (slot + 1) & mask;
+         keys[slot] = key;
+         glyphs[slot] = font->hash_glyphs[i];
+      }
+   }
+   free(font->hash_keys);
+   free(font->hash_glyphs);
+   font->hash_keys = keys;
+   font->hash_glyphs = glyphs;
+   font->hash_mask = mask;
+   return true;
+}
+
+// First mapping wins, matching how PSF2 unicode tables list duplicates
+static bool hash_insert(struct font *font, uint32_t codepoint, uint32_t glyph) {
+   if (codepoint == FONT_HASH_EMPTY)
+      return true;
+   // Keep the load factor at or below one half
+   if (!font->hash_mask || (font->hash_used + 1) * 2 > font->hash_mask + 1) {
+      uint32_t capacity = font->hash_mask ? (font->hash_mask + 1) * 2 : 256;
+      if (!hash_resize(font, capacity))
+         return false;
+   }
+   uint32_t slot = hash_slot(codepoint, font->hash_mask);
+   while (font->hash_keys[slot] != FONT_HASH_EMPTY) {
+      if (font->hash_keys[slot] == codepoint)
+         return true;
+      slot = (slot + 1) & font->hash_mask;
+   }
+   font->hash_keys[slot] = codepoint;
+   font->hash_glyphs[slot] = glyph;
+   font->hash_used++;
+   return true;
+}
+
+// Trim empty rows and columns of every glyph once at load time
+static bool compute_boxes(struct font *font) {
+   font->owned_boxes = malloc(font->glyph_count * sizeof(*font->owned_boxes));
+   if (!font->owned_boxes)
+      return false;
+   for (uint32_t g = 0; g < font->glyph_count; g++) {
+      const uint8_t *bits = font_glyph_bits(font, (int)g);
+      int x0 = font->width, y0 = font->height, x1 = -1, y1 = -1;
+      for (int y = 0; y < font->height; y++) {
+         const uint8_t *row = bits + y * font->stride;
+         for (int x = 0; x < font->width; x++) {
+            if (row[x >> 3] & (0x80 >> (x & 7))) {
+               if (x0 > x) x0 = x;
+               if (x1 < x) x1 = x;
+               if (y0 > y) y0 = y;
+               y1 = y;
+            }
+         }
+      }
+      struct font_glyph_box *box = &font->owned_boxes[g];
+      if (y1 < 0) {
+         box->x0 = 1; box->y0 = 1;
+         box->x1 = 0; box->y1 = 0;
+      } else {
+         box->x0 = (uint8_t)x0; box->y0 = (uint8_t)y0;
+         box->x1 = (uint8_t)x1; box->y1 = (uint8_t)y1;
+      }
+   }
+   font->boxes = font->owned_boxes;
+   return true;
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool load_psf2(struct font *font, const char *path) {
+   const uint8_t *data = font->map.data;
+   size_t size = font->map.size;
+   if (size < PSF2_HEADER_SIZE)
+      return false;
+   uint32_t header_size = read_le32(data + 8);
+   uint32_t flags = read_le32(data + 12);
+   uint32_t count = read_le32(data + 16);
+   uint32_t char_size = read_le32(data + 20);
+   uint32_t height = read_le32(data + 24);
+   uint32_t width = read_le32(data + 28);
+
+   if (!width || !height || width > FONT_MAX_SIZE || height > FONT_MAX_SIZE ||
+       !count || count > FONT_MAX_GLYPHS || char_size != height * ((width + 7) / 8) ||
+       header_size < PSF2_HEADER_SIZE || header_size > size ||
+       (size - header_size) / char_size < count) {
+      core_log(RETRO_LOG_ERROR, "Malformed PSF2 header: %s\n", path);
+      return false;
+   }
+
+   font->width = (int)width;
+   font->height = (int)height;
+   font->stride = (int)((width + 7) / 8);
+   font->glyph_bytes = (int)char_size;
+   font->glyph_count = count;
+   font->glyphs = data + header_size; // Zero-copy: glyphs stay in the mapping
+
+   if (!(flags & PSF2_HAS_UNICODE)) {
+      font->direct_first = 0;
+      font->direct_count = count;
+   } else {
+      const uint8_t *p = data + header_size + (size_t)count * char_size;
+      const uint8_t *end = data + size;
+      for (uint32_t g = 0; g < count && p < end; g++) {
+         bool in_sequence = false;
+         while (p < end && *p != PSF2_SEPARATOR) {
+            if (*p == PSF2_STARTSEQ) {
+               // Multi-codepoint sequences are not rendered; skip them
+               in_sequence = true;
+               p++;
+               continue;
+            }
+            // Malformed bytes map nothing; a literal U+FFFD still counts
+            uint32_t codepoint = utf8_decode_strict(&p, end);
+            if (!in_sequence && codepoint != UTF8_INVALID && !hash_insert(font, codepoint, g))
+               return false;
+         }
+         p++; // Skip separator
+      }
+   }
+   return compute_boxes(font);
+}
+
+static bool bdf_keyword(const char *line, const char *keyword) {
+   size_t len = strlen(keyword);
+   return strncmp(line, keyword, len) == 0 && (line[len] == ' ' || line[len] == '\0');
+}
+
+static int hex_digit(char c) {
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+static bool load_bdf(struct font *font, const char *path) {
+   const char *cur = (const char *)font->map.data;
+   const char *end = cur + font->map.size;
+   char line[512];
+   int fbb_w = 0, fbb_h = 0, fbb_x = 0, fbb_y = 0;
+   uint32_t capacity = 0;
+
+   // Header: everything up to the first glyph
+   while (mapfile_next_line(&cur, end, line, sizeof(line))) {
+      if (bdf_keyword(line, "FONTBOUNDINGBOX"))
+         sscanf(line + 15, "%d %d %d %d", &fbb_w, &fbb_h, &fbb_x, &fbb_y);
+      else if (bdf_keyword(line, "CHARS")) {
+         unsigned long chars = strtoul(line + 5, NULL, 10);
+         capacity = chars > FONT_MAX_GLYPHS ? FONT_MAX_GLYPHS : (uint32_t)chars;
+         break;
+      }
+   }
+   if (fbb_w <= 0 || fbb_h <= 0 || fbb_w > FONT_MAX_SIZE || fbb_h > FONT_MAX_SIZE || !capacity) {
+      core_log(RETRO_LOG_ERROR, "Malformed BDF header: %s\n", path);
+      return false;
+   }
+
+   font->width = fbb_w;
+   font->height = fbb_h;
+   font->stride = (fbb_w + 7) / 8;
+   font->glyph_bytes = font->stride * fbb_h;
+   font->atlas = calloc(capacity, (size_t)font->glyph_bytes);
+   if (!font->atlas)
+      return false;
+   font->glyphs = font->atlas;
+
+   long encoding = -1;
+   int bbx_w = 0, bbx_h = 0, bbx_x = 0, bbx_y = 0;
+   while (font->glyph_count < capacity && mapfile_next_line(&cur, end, line, sizeof(line))) {
+      if (bdf_keyword(line, "ENCODING"))
+         encoding = strtol(line + 8, NULL, 10);
+      else if (bdf_keyword(line, "BBX"))
+         sscanf(line + 3, "%d %d %d %d", &bbx_w, &bbx_h, &bbx_x, &bbx_y);
+      else if (bdf_keyword(line, "BITMAP")) {
+         uint8_t *glyph = font->atlas + (size_t)font->glyph_count * font->glyph_bytes;
+         // Place the glyph's box inside the font cell relative to the baseline
+         int left = bbx_x - fbb_x;
+         int top = (fbb_h + fbb_y) - (bbx_y + bbx_h);
+         for (int by = 0; by < bbx_h && mapfile_next_line(&cur, end, line, sizeof(line)); by++) {
+            int cy = top + by;
+            for (int bx = 0; bx < bbx_w; bx++) {
+               int nibble = hex_digit(line[bx >> 2]);
+               if (nibble < 0)
+                  break;
+               int cx = left + bx;
+               if (!(nibble & (8 >> (bx & 3))) || cx < 0 || cx >= fbb_w || cy < 0 || cy >= fbb_h)
+                  continue;
+               glyph[cy * font->stride + (cx >> 3)] |= (uint8_t)(0x80 >> (cx & 7));
+            }
+         }
+      } else if (bdf_keyword(line, "ENDCHAR")) {
+         // Glyphs without a standard encoding are parsed but not indexed
+         if (encoding >= 0 && !hash_insert(font, (uint32_t)encoding, font->glyph_count))
+            return false;
+         font->glyph_count++;
+         encoding = -1;
+         bbx_w = bbx_h = bbx_x = bbx_y = 0;
+      }
+   }
+   if (!font->glyph_count) {
+      core_log(RETRO_LOG_ERROR, "BDF font has no glyphs: %s\n", path);
+      return false;
+   }
+   if (!compute_boxes(font))
+      return false;
+   // The atlas is self-contained; drop the mapping
+   mapfile_close(&font->map);
+   return true;
+}
+
+bool font_load(struct font *font, const char *path) {
+   static const uint8_t psf2_magic[4] = {0x72, 0xB5, 0x4A, 0x86};
+   memset(font, 0, sizeof(*font));
+   if (!mapfile_open(&font->map, path)) {
+      core_log(RETRO_LOG_ERROR, "Failed to map font file: %s\n", path);
+      return false;
+   }
+
+   bool ok;
+   const char *kind;
+   if (font->map.size >= 4 && memcmp(font->map.data, psf2_magic, 4) == 0) {
+      kind = "PSF2";
+      ok = load_psf2(font, path);
+   } else if (font->map.size >= 9 && memcmp(font->map.data, "STARTFONT", 9) == 0) {
+      kind = "BDF";
+      ok = load_bdf(font, path);
+   } else {
+      core_log(RETRO_LOG_ERROR, "Unsupported font format: %s\n", path);
+      font_free(font);
+      return false;
+   }
+
+   if (!ok) {
+      font_free(font);
+      return false;
+   }
+   core_log(RETRO_LOG_INFO, "Loaded %s font %s: %u glyphs of %dx%d, %u mapped codepoints\n",
+            kind, path, font->glyph_count, font->width, font->height,
+            font->direct_count + font->hash_used);
+   return true;
+}
+
+void font_free(struct font *font) {
+   free(font->hash_keys);
+   free(font->hash_glyphs);
+   free(font->atlas);
+   free(font->owned_boxes);
+   mapfile_close(&font->map);
+   memset(font, 0, sizeof(*font));
+}
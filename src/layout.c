@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+#include "text.h"
+#include "utf8.h"
+
+// Small LRU cache of laid-out paragraphs. Entries keep a copy of their text
+// so a hash match is confirmed byte for byte before it is reused.
+#define LAYOUT_CACHE_SLOTS 32
+
+struct layout_entry {
+   bool used;
+   uint64_t hash;
+   size_t text_len;
+   int max_width;
+   unsigned font_generation;
+   char *text;
+   struct layout_line *lines;
+   struct layout layout;
+   unsigned last_used;
+};
+
+static struct layout_entry cache[LAYOUT_CACHE_SLOTS];
+static unsigned use_clock;
+
+// FNV-1a over the text, mixed with the rest of the key
+static uint64_t layout_hash(const char *text, size_t len, int max_width, unsigned generation) {
+   uint64_t h = 14695981039346656037ull;
+   for (size_t i = 0; i < len; i++) {
+      h ^= (uint8_t)text[i];
+      h *= 1099511628211ull;
+   }
+   h ^= (uint64_t)(uint32_t)max_width << 32 | generation;
+   h *= 1099511628211ull;
+   return h;
+}
+
+static void entry_free(struct layout_entry *entry) {
+   free(entry->text);
+   free(entry->lines);
+   memset(entry, 0, sizeof(*entry));
+}
+
+void layout_cache_clear(void) {
+   for (int i = 0; i < LAYOUT_CACHE_SLOTS; i++)
+      entry_free(&cache[i]);
+}
+
+static bool push_line(struct layout_entry *entry, int *capacity,
+                      size_t start, size_t end, int chars, int advance) {
+   if (entry->layout.line_count == *capacity) {
+      int grown = *capacity ? *capacity * 2 : 8;
+      struct layout_line *lines = realloc(entry->lines, grown * sizeof(*lines));
+      if (!lines)
+         return false;
+      entry->lines = lines;
+      *capacity = grown;
+   }
+   struct layout_line *line = &entry->lines[entry->layout.line_count++];
+   line->start = (uint32_t)start;
+   line->length = (uint32_t)(end - start);
+   line->width = chars * advance;
+   if (entry->layout.width < line->width)
+      entry->layout.width = line->width;
+   return true;
+}
+
+// Greedy line breaking. Bitmap fonts are monospaced, so a line's width is
+// its character count times the cell advance.
+static bool break_lines(struct layout_entry *entry, const char *text, size_t len, int max_width) {
+   const struct font *font = text_font();
+   int advance = font->width;
+   int capacity = 0;
+   const uint8_t *base = (const uint8_t *)text;
+   const uint8_t *p = base;
+   const uint8_t *end = base + len;
+
+   size_t line_start = 0;
+   int line_chars = 0;
+   size_t break_at = 0;     // Offset of the last space on this line
+   int break_chars = -1;    // Characters before that space, -1 if none
+
+   while (p < end) {
+      size_t at = (size_t)(p - base);
+      uint32_t c = utf8_decode(&p, end);
+      size_t next = (size_t)(p - base);
+
+      if (c == '\n') {
+         if (!push_line(entry, &capacity, line_start, at, line_chars, advance))
+            return false;
+         line_start = next;
+         line_chars = 0;
+         break_chars = -1;
+         continue;
+      }
+
+      if (max_width > 0 && line_chars > 0 && (line_chars + 1) * advance > max_width) {
+         if (c == ' ') {
+            // Overflowing space: break here and drop it
+            if (!push_line(entry, &capacity, line_start, at, line_chars, advance))
+               return false;
+            line_start = next;
+            line_chars = 0;
+            break_chars = -1;
+            continue;
+         }
+         if (break_chars >= 0) {
+            // Wrap at the last space; the word after it moves down
+            if (!push_line(entry, &capacity, line_start, break_at, break_chars, advance))
+               return false;
+            line_start = break_at + 1;
+            line_chars -= break_chars + 1;
+         }
+         if (line_chars > 0 && (line_chars + 1) * advance > max_width) {
+            // A single word wider than the box: split it
+            if (!push_line(entry, &capacity, line_start, at, line_chars, advance))
+               return false;
+            line_start = at;
+            line_chars = 0;
+         }
+         break_chars = -1;
+      }
+
+      if (c == ' ') {
+         break_at = at;
+         break_chars = line_chars;
+      }
+      line_chars++;
+   }
+   if (!push_line(entry, &capacity, line_start, len, line_chars, advance))
+      return false;
+
+   entry->layout.lines = entry->lines;
+   entry->layout.line_height = font->height;
+   entry->layout.height = entry->layout.line_count * font->height;
+   return true;
+}
+
+const struct layout *layout_text(const char *text, int max_width) {
+   size_t len = strlen(text);
+   unsigned generation = text_font_generation();
+   uint64_t hash = layout_hash(text, len, max_width, generation);
+   use_clock++;
+
+   struct layout_entry *victim = &cache[0];
+   for (int i = 0; i < LAYOUT_CACHE_SLOTS; i++) {
+      struct layout_entry *entry = &cache[i];
+      if (entry->used && entry->hash == hash && entry->text_len == len &&
+          entry->max_width == max_width && entry->font_generation == generation &&
+          memcmp(entry->text, text, len) == 0) {
+         entry->last_used = use_clock;
+         return &entry->layout;
+      }
+      if (!entry->used || (victim->used && entry->last_used < victim->last_used))
+         victim = entry;
+   }
+
+   // Miss: lay the text out once into the least recently used slot
+   entry_free(victim);
+   victim->text = malloc(len + 1);
+   if (!victim->text)
+      return NULL;
+   memcpy(victim->text, text, len + 1);
+   if (!break_lines(victim, text, len, max_width)) {
+      entry_free(victim);
+      return NULL;
+   }
+   victim->used = true;
+   victim->hash = hash;
+   victim->text_len = len;
+   victim->max_width = max_width;
+   victim->font_generation = generation;
+   victim->last_used = use_clock;
+   return &victim->layout;
+}
+
+void layout_measure(const char *text, int max_width, int *width, int *height) {
+   const struct layout *layout = layout_text(text, max_width);
+   *width = layout ? layout->width : 0;
+   *height = layout ? layout->height : 0;
+}
+
+// Left edge of a line aligned inside a box starting at x
+static int line_x(const struct layout_line *line, int x, int box_width, enum layout_align align) {
+   if (align == LAYOUT_ALIGN_CENTER)
+      return x + (box_width - line->width) / 2;
+   if (align == LAYOUT_ALIGN_RIGHT)
+      return x + box_width - line->width;
+   return x;
+}
+
+void layout_draw(const struct surface *dst, int x, int y,
+                 const char *text, int box_width, enum layout_align align, uint16_t color) {
+   const struct layout *layout = layout_text(text, box_width);
+   if (!layout)
+      return;
+   for (int i = 0; i < layout->line_count; i++) {
+      const struct layout_line *line = &layout->lines[i];
+      text_draw_span(dst, line_x(line, x, box_width, align),
+                     y + i * layout->line_height, text + line->start, line->length, color);
+   }
+}
+
+void layout_draw8(uint8_t *fb, int fb_width, int fb_height, int x, int y,
+                  const char *text, int box_width, enum layout_align align, uint8_t index) {
+   const struct layout *layout = layout_text(text, box_width);
+   if (!layout)
+      return;
+   for (int i = 0; i < layout->line_count; i++) {
+      const struct layout_line *line = &layout->lines[i];
+      text_draw_span8(fb, fb_width, fb_height, line_x(line, x, box_width, align),
+                      y + i * layout->line_height, text + line->start, line->length, index);
+   }
+}
@@ -1,9 +1,33 @@
 #include <libretro.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <math.h>
 #include "font.h"
+#include "text.h"
+#include "text_aa.h"
+#include "text_sdf.h"
+#include "layout.h"
+#include "console.h"
+#include "core_log.h"
+#include "pixconv.h"
+#include "palette.h"
+#include "postfx.h"
+#include "workers.h"
+#include "draw.h"
+#include "draw_aa.h"
+#include "path.h"
+#include "raster3d.h"
+#include "mode7.h"
+#include "raycast.h"
+#include "voxel.h"
+#include "tilemap.h"
+#include "atlas.h"
+#include "blend.h"
+#include "scale.h"
+#include "surface.h"
 
 // Framebuffer dimensions
 #define WIDTH 320
@@ -12,21 +36,104 @@
 // Global variables
 static retro_environment_t environ_cb;
 static retro_log_printf_t log_cb;
+static retro_log_printf_t frontend_log_cb; // log_cb wraps it to feed the console
 static retro_video_refresh_t video_cb;
 static retro_input_poll_t input_poll_cb;
 static retro_input_state_t input_state_cb;
 static uint16_t framebuffer[WIDTH * HEIGHT]; // RGB565
+static struct surface screen; // framebuffer as a drawing target
+static enum retro_pixel_format video_format = RETRO_PIXEL_FORMAT_RGB565; // Format accepted by the frontend
+static uint32_t video_buffer[WIDTH * HEIGHT * POSTFX_MAX_SCALE * POSTFX_MAX_SCALE]; // Output converted to video_format
+static uint16_t postfx_buffer[WIDTH * HEIGHT * POSTFX_MAX_SCALE * POSTFX_MAX_SCALE]; // Output of the post-processing stages
+static uint8_t framebuffer8[WIDTH * HEIGHT]; // Palette indices, used instead of framebuffer in indexed mode
+static struct palette palette;
+static bool indexed_mode = false;
+static struct postfx_config postfx = { 1, POSTFX_FILTER_NEAREST, false, false };
+static int worker_threads = -1; // As configured, 0 for one per CPU
+static unsigned frame_count = 0;
+
+// Demo scenes selectable through the hello_world_scene option
+enum scene {
+   SCENE_HELLO,
+   SCENE_SHAPES,
+   SCENE_GAUGES,
+   SCENE_CUBES,
+   SCENE_RAYCAST,
+   SCENE_TERRAIN,
+   SCENE_TILES,
+   SCENE_SPRITES,
+};
+static enum scene scene = SCENE_HELLO;
+// Layer drawn under the hello scene, selected by hello_world_background
+enum background {
+   BACKGROUND_NONE,
+   BACKGROUND_PLANE,     // Mode 7 perspective ground plane
+   BACKGROUND_ROTOZOOM,  // Mode 7 flat rotation and zoom
+   BACKGROUND_PICTURE,   // Part of the Mode 7 texture stretched to the screen
+};
+static enum background background = BACKGROUND_NONE;
+static struct path icon_path; // Rebuilt every frame, storage kept
+// Gauge dials, drawn once offscreen and blitted under the needles
+static struct surface gauge_faces;
+// Raycaster camera, moved with the D-pad in the raycaster scene
+static const struct raycast_view raycast_start = { 1.5f, 1.5f, 0.6f, 1.15f };
+static struct raycast_view raycast_view = { 1.5f, 1.5f, 0.6f, 1.15f };
+// Voxel terrain, mapped from .hwv content or generated on first use
+static struct voxel_map terrain;
+static float terrain_altitude = 0.0f;
+// Scrolling text tilemap, built on first use
+static struct tilemap tiles;
+// Sprites packed from .hws content, or generated on first use
+static struct atlas sprites;
 static bool initialized = false;
 static bool contentless_set = false;
 static int env_call_count = 0;
 static FILE *log_file = NULL;
 static int square_x = 0;
 static int square_y = 0;
+static bool console_enabled = false;
+static int16_t prev_l = 0;
+static int16_t prev_r = 0;
+
+// Font file looked up in the system directory when no font content is loaded
+#define FONT_SYSTEM_NAME "hello_world_font"
+#ifdef _WIN32
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+static struct font content_font;
+static bool content_font_loaded = false;
 
 // Colors (RGB565)
 #define COLOR_WHITE 0xFFFF // White
 #define COLOR_RED   0xF800 // Red
 
+// Palette indices used by the indexed scene
+#define INDEX_BLACK       0
+#define INDEX_WHITE       1
+#define INDEX_RED         2
+#define INDEX_CYCLE_FIRST 16 // Colour-cycled rainbow strip
+#define INDEX_CYCLE_COUNT 32
+
+static enum retro_log_level log_level_from_name(const char *level) {
+   if (strcmp(level, "ERROR") == 0) return RETRO_LOG_ERROR;
+   if (strcmp(level, "WARN") == 0)  return RETRO_LOG_WARN;
+   if (strcmp(level, "DEBUG") == 0) return RETRO_LOG_DEBUG;
+   return RETRO_LOG_INFO;
+}
+
+// Frontend logging, teed into the on-screen console
+static void console_log(enum retro_log_level level, const char *fmt, ...) {
+   char msg[1024];
+   va_list args;
+   va_start(args, fmt);
+   vsnprintf(msg, sizeof(msg), fmt, args);
+   va_end(args);
+   console_push(level, msg);
+   frontend_log_cb(level, "%s", msg);
+}
+
 // File-based logging (simple)
 static void fallback_log(const char *level, const char *msg) {
    if (!log_file) {
@@ -39,6 +146,7 @@ static void fallback_log(const char *level, const char *msg) {
    fprintf(log_file, "[%s] %s\n", level, msg);
    fflush(log_file);
    fprintf(stderr, "[%s] %s\n", level, msg);
+   console_push(log_level_from_name(level), msg);
 }
 
 // File-based logging (formatted)
@@ -62,6 +170,34 @@ static void fallback_log_format(const char *level, const char *fmt, ...) {
    vfprintf(stderr, fmt, args);
    fprintf(stderr, "\n");
    va_end(args);
+   char msg[1024];
+   va_start(args, fmt);
+   vsnprintf(msg, sizeof(msg), fmt, args);
+   va_end(args);
+   console_push(log_level_from_name(level), msg);
+}
+
+static const char *log_level_name(enum retro_log_level level) {
+   switch (level) {
+      case RETRO_LOG_DEBUG: return "DEBUG";
+      case RETRO_LOG_INFO:  return "INFO";
+      case RETRO_LOG_WARN:  return "WARN";
+      case RETRO_LOG_ERROR: return "ERROR";
+      default:              return "LOG";
+   }
+}
+
+// Shared logger for the other translation units (see core_log.h)
+void core_log(enum retro_log_level level, const char *fmt, ...) {
+   char msg[1024];
+   va_list args;
+   va_start(args, fmt);
+   vsnprintf(msg, sizeof(msg), fmt, args);
+   va_end(args);
+   if (log_cb)
+      log_cb(level, "[%s] %s", log_level_name(level), msg);
+   else
+      fallback_log(log_level_name(level), msg);
 }
 
 // Clear framebuffer to black
@@ -73,39 +209,234 @@ static void clear_framebuffer() {
   memset(framebuffer, 0, WIDTH * HEIGHT * sizeof(uint16_t));
 }
 
-// Draw a single 8x8 character at (x, y) in RGB565 color
-static void draw_char(int x, int y, char c, uint16_t color) {
-   if (c < 32 || c > 126) {
-      if (log_cb)
-         log_cb(RETRO_LOG_WARN, "[DEBUG] Invalid character: %c\n", c);
-      else
-         fallback_log_format("WARN", "Invalid character: %c\n", c);
-      return;
-   }
-   const uint8_t *glyph = font_8x8[c - 32];
-   for (int gy = 0; gy < 8; gy++) {
-      for (int gx = 0; gx < 8; gx++) {
-         if (glyph[gy] & (1 << (7 - gx))) {
-            int px = x + gx;
-            int py = y + gy;
-            if (px >= 0 && px < WIDTH && py >= 0 && py < HEIGHT) {
-               framebuffer[py * WIDTH + px] = color;
-            }
-         }
-      }
-   }
-}
-
-// Draw a string at (x, y) in RGB565 color
+// Draw a string at (x, y) in RGB565 color using the selected font
 static void draw_string(int x, int y, const char *str, uint16_t color) {
   //  if (log_cb)
   //     log_cb(RETRO_LOG_INFO, "[DEBUG] Drawing string: %s at (%d, %d)", str, x, y);
   //  else
   //     fallback_log_format("DEBUG", "Drawing string: %s at (%d, %d)", str, x, y);
-   int cx = x;
-   for (size_t i = 0; str[i]; i++) {
-      draw_char(cx, y, str[i], color);
-      cx += 8;
+   text_draw_string(&screen, x, y, str, color);
+}
+
+// Draw an anti-aliased string scaled to size pixels tall
+static void draw_string_aa(int x, int y, const char *str, int size, uint16_t color) {
+   text_aa_draw_string(&screen, x, y, str, size, color);
+}
+
+// Draw a distance-field string scaled to size pixels tall
+static void draw_string_sdf(int x, int y, const char *str, int size, uint16_t color) {
+   text_sdf_draw_string(&screen, x, y, str, size, color);
+}
+
+// Draw wrapped text inside a box of width pixels (layout is cached)
+static void draw_paragraph(int x, int y, int width, const char *str,
+                           enum layout_align align, uint16_t color) {
+   layout_draw(&screen, x, y, str, width, align, color);
+}
+
+// Fill the palette for the indexed scene
+static void init_palette(void) {
+   memset(&palette, 0, sizeof(palette));
+   palette_set(&palette, INDEX_WHITE, 255, 255, 255);
+   palette_set(&palette, INDEX_RED, 255, 0, 0);
+   // Hue ramp; rotating it each frame animates the strip without redrawing
+   for (int i = 0; i < INDEX_CYCLE_COUNT; i++) {
+      int h = i * 6 * 256 / INDEX_CYCLE_COUNT;
+      int f = h & 255, q = 255 - f;
+      uint8_t rgb[6][3] = {
+         { 255, f, 0 }, { q, 255, 0 }, { 0, 255, f }, { 0, q, 255 }, { f, 0, 255 }, { 255, 0, q },
+      };
+      const uint8_t *c = rgb[h >> 8];
+      palette_set(&palette, INDEX_CYCLE_FIRST + i, c[0], c[1], c[2]);
+   }
+}
+
+// The indexed framebuffer only backs the hello scene
+static bool indexed_frame(void) {
+   return indexed_mode && scene == SCENE_HELLO;
+}
+
+// Hand the frame to the frontend in the pixel format it accepted, running
+// the post-processing stages on the way
+static void present_frame(void) {
+   if (indexed_frame()) {
+      if (video_format == RETRO_PIXEL_FORMAT_XRGB8888 && !console_enabled && !postfx_active(&postfx)) {
+         // Straight from indices to the output format, no RGB565 pass
+         palette_expand_xrgb8888(framebuffer8, WIDTH, video_buffer, WIDTH * sizeof(uint32_t),
+                                 &palette, WIDTH, HEIGHT);
+         video_cb(video_buffer, WIDTH, HEIGHT, WIDTH * sizeof(uint32_t));
+         return;
+      }
+      palette_expand_rgb565(framebuffer8, WIDTH, framebuffer, WIDTH * sizeof(uint16_t),
+                            &palette, WIDTH, HEIGHT);
+      // The console keeps RGB565 pixels, so it goes on after expansion
+      if (console_enabled)
+         console_blit(&screen, HEIGHT);
+   }
+
+   const uint16_t *frame = framebuffer;
+   int width = WIDTH, height = HEIGHT;
+   if (postfx_active(&postfx)) {
+      width *= postfx.scale;
+      height *= postfx.scale;
+      postfx_apply(framebuffer, WIDTH * sizeof(uint16_t), WIDTH, HEIGHT,
+                   postfx_buffer, width * sizeof(uint16_t), &postfx);
+      frame = postfx_buffer;
+   }
+
+   if (video_format == RETRO_PIXEL_FORMAT_RGB565) {
+      video_cb(frame, width, height, width * sizeof(uint16_t));
+      return;
+   }
+   size_t pitch = width * pixconv_bytes_per_pixel(video_format);
+   pixconv_convert(frame, width * sizeof(uint16_t), RETRO_PIXEL_FORMAT_RGB565,
+                   video_buffer, pitch, video_format, width, height);
+   video_cb(video_buffer, width, height, pitch);
+}
+
+// Load a font file and make it the active text font
+static bool load_font(const char *path) {
+   if (!font_load(&content_font, path))
+      return false;
+   content_font_loaded = true;
+   text_set_font(&content_font);
+   return true;
+}
+
+// Look for a font in the frontend's system directory
+static bool load_system_font(void) {
+   static const char *names[] = { FONT_SYSTEM_NAME ".psf", FONT_SYSTEM_NAME ".psfu", FONT_SYSTEM_NAME ".bdf" };
+   const char *dir = NULL;
+   if (!environ_cb || !environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &dir) || !dir)
+      return false;
+   for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s%c%s", dir, PATH_SEPARATOR, names[i]);
+      FILE *probe = fopen(path, "rb");
+      if (!probe)
+         continue;
+      fclose(probe);
+      if (load_font(path))
+         return true;
+   }
+   return false;
+}
+
+static void unload_font(void) {
+   text_set_font(NULL);
+   if (content_font_loaded) {
+      font_free(&content_font);
+      content_font_loaded = false;
+   }
+}
+
+// Core options
+static const struct retro_variable variables[] = {
+   { "hello_world_scene", "Scene; hello|shapes|gauges|cubes|raycaster|terrain|tiles|sprites" },
+   { "hello_world_background", "Background; none|plane|rotozoom|picture" },
+   { "hello_world_gamma", "Gamma-correct blending; disabled|enabled" },
+   { "hello_world_console", "Log console; disabled|enabled" },
+   { "hello_world_framebuffer", "Framebuffer; rgb565|indexed" },
+   { "hello_world_scale", "Integer scale; 1x|2x|3x|4x" },
+   { "hello_world_filter", "Upscale filter; nearest|scale2x|xbr-lite" },
+   { "hello_world_scanlines", "Scanlines; disabled|enabled" },
+   { "hello_world_mask", "Aperture mask; disabled|enabled" },
+   { "hello_world_threads", "Worker threads; auto|1|2|4|8" },
+   { NULL, NULL },
+};
+
+// Tell the frontend the output size changed with the scale option
+static void update_geometry(void) {
+   struct retro_game_geometry geometry = {
+      WIDTH * postfx.scale, HEIGHT * postfx.scale,
+      WIDTH * POSTFX_MAX_SCALE, HEIGHT * POSTFX_MAX_SCALE,
+      (float)WIDTH / HEIGHT,
+   };
+   if (environ_cb)
+      environ_cb(RETRO_ENVIRONMENT_SET_GEOMETRY, &geometry);
+}
+
+// Read core options from the frontend
+static void check_variables(void) {
+   struct retro_variable var = { "hello_world_console", NULL };
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      console_enabled = strcmp(var.value, "enabled") == 0;
+
+   var.key = "hello_world_scene";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      scene = strcmp(var.value, "shapes") == 0 ? SCENE_SHAPES :
+              strcmp(var.value, "gauges") == 0 ? SCENE_GAUGES :
+              strcmp(var.value, "cubes") == 0 ? SCENE_CUBES :
+              strcmp(var.value, "raycaster") == 0 ? SCENE_RAYCAST :
+              strcmp(var.value, "terrain") == 0 ? SCENE_TERRAIN :
+              strcmp(var.value, "tiles") == 0 ? SCENE_TILES :
+              strcmp(var.value, "sprites") == 0 ? SCENE_SPRITES : SCENE_HELLO;
+
+   var.key = "hello_world_background";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      background = strcmp(var.value, "plane") == 0 ? BACKGROUND_PLANE :
+                   strcmp(var.value, "rotozoom") == 0 ? BACKGROUND_ROTOZOOM :
+                   strcmp(var.value, "picture") == 0 ? BACKGROUND_PICTURE : BACKGROUND_NONE;
+
+   var.key = "hello_world_gamma";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+      blend565_set_gamma(strcmp(var.value, "enabled") == 0);
+      surface_free(&gauge_faces); // Blended edges change; redraw on next use
+   }
+
+   var.key = "hello_world_framebuffer";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+      bool indexed = strcmp(var.value, "indexed") == 0;
+      if (indexed && !indexed_mode)
+         init_palette();
+      indexed_mode = indexed;
+   }
+
+   var.key = "hello_world_scale";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+      int scale = atoi(var.value);
+      if (scale < 1 || scale > POSTFX_MAX_SCALE)
+         scale = 1;
+      if (scale != postfx.scale) {
+         postfx.scale = scale;
+         update_geometry();
+      }
+   }
+
+   var.key = "hello_world_filter";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+      if (strcmp(var.value, "scale2x") == 0)
+         postfx.filter = POSTFX_FILTER_SCALE2X;
+      else if (strcmp(var.value, "xbr-lite") == 0)
+         postfx.filter = POSTFX_FILTER_XBR_LITE;
+      else
+         postfx.filter = POSTFX_FILTER_NEAREST;
+   }
+
+   var.key = "hello_world_scanlines";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      postfx.scanlines = strcmp(var.value, "enabled") == 0;
+
+   var.key = "hello_world_mask";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      postfx.mask = strcmp(var.value, "enabled") == 0;
+
+   var.key = "hello_world_threads";
+   var.value = NULL;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+      int threads = atoi(var.value); // "auto" reads as 0
+      if (threads != worker_threads) {
+         worker_threads = threads;
+         workers_init(threads);
+      }
    }
 }
 
@@ -139,6 +470,8 @@ void retro_set_environment(retro_environment_t cb) {
             fallback_log("ERROR", "Failed to set content-less support\n");
       }
    }
+
+   environ_cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void *)variables);
 }
 
 // Called by the frontend to set video refresh callback
@@ -179,19 +512,33 @@ void retro_init(void) {
    else
       fallback_log("DEBUG", "Hello World core initialized\n");
    clear_framebuffer();
+   surface_init(&screen, framebuffer, WIDTH, WIDTH, HEIGHT);
 
-   // Set pixel format to RGB565
-   enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
-   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt)) {
+   // Set pixel format, preferring RGB565 (the framebuffer's native format).
+   // Frontends that refuse it get the frame converted at present time.
+   static const enum retro_pixel_format formats[] = {
+      RETRO_PIXEL_FORMAT_RGB565, RETRO_PIXEL_FORMAT_XRGB8888, RETRO_PIXEL_FORMAT_0RGB1555,
+   };
+   bool format_set = false;
+   for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]) && !format_set; i++) {
+      enum retro_pixel_format fmt = formats[i];
+      if (environ_cb && environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt)) {
+         video_format = fmt;
+         format_set = true;
+      }
+   }
+   if (format_set) {
       if (log_cb)
-         log_cb(RETRO_LOG_INFO, "[DEBUG] Pixel format set: RGB565\n");
+         log_cb(RETRO_LOG_INFO, "[DEBUG] Pixel format set: %s\n", pixconv_format_name(video_format));
       else
-         fallback_log("DEBUG", "Pixel format set: RGB565\n");
+         fallback_log_format("DEBUG", "Pixel format set: %s\n", pixconv_format_name(video_format));
+      if (video_format != RETRO_PIXEL_FORMAT_RGB565)
+         pixconv_init();
    } else {
       if (log_cb)
-         log_cb(RETRO_LOG_ERROR, "[ERROR] Failed to set pixel format: RGB565\n");
+         log_cb(RETRO_LOG_ERROR, "[ERROR] Failed to set pixel format: RGB565, XRGB8888 and 0RGB1555 rejected\n");
       else
-         fallback_log("ERROR", "Failed to set pixel format: RGB565\n");
+         fallback_log("ERROR", "Failed to set pixel format: RGB565, XRGB8888 and 0RGB1555 rejected\n");
       if (environ_cb)
          environ_cb(RETRO_ENVIRONMENT_SHUTDOWN, NULL);
    }
@@ -199,7 +546,8 @@ void retro_init(void) {
    // Set up logging
    struct retro_log_callback logging;
    if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_LOG_INTERFACE, &logging)) {
-      log_cb = logging.log;
+      frontend_log_cb = logging.log;
+      log_cb = frontend_log_cb ? console_log : NULL;
       if (log_cb)
          log_cb(RETRO_LOG_INFO, "[DEBUG] Logging callback initialized\n");
    } else {
@@ -208,6 +556,10 @@ void retro_init(void) {
       else
          fallback_log("WARN", "Failed to get log interface\n");
    }
+
+   // One worker per CPU until the core option says otherwise
+   workers_init(0);
+   worker_threads = 0;
 }
 
 // Called when the core is deinitialized
@@ -216,11 +568,40 @@ void retro_deinit(void) {
       fclose(log_file);
       log_file = NULL;
    }
+   layout_cache_clear();
+   console_clear();
+   workers_shutdown();
+   worker_threads = -1;
+   postfx_free();
+   path_free(&icon_path);
+   raster3d_free();
+   mode7_free();
+   raycast_free();
+   raycast_view = raycast_start;
+   voxel_map_free(&terrain);
+   terrain_altitude = 0.0f;
+   tilemap_free(&tiles);
+   atlas_free(&sprites);
+   surface_free(&gauge_faces);
+   scale_free();
+   blend565_set_gamma(false);
    initialized = false;
    contentless_set = false;
    env_call_count = 0;
    square_x = 0;
    square_y = 0;
+   console_enabled = false;
+   indexed_mode = false;
+   scene = SCENE_HELLO;
+   background = BACKGROUND_NONE;
+   frame_count = 0;
+   postfx.scale = 1;
+   postfx.filter = POSTFX_FILTER_NEAREST;
+   postfx.scanlines = false;
+   postfx.mask = false;
+   video_format = RETRO_PIXEL_FORMAT_RGB565;
+   prev_l = 0;
+   prev_r = 0;
    if (log_cb)
       log_cb(RETRO_LOG_INFO, "[DEBUG] Core deinitialized\n");
    else
@@ -232,9 +613,10 @@ void retro_get_system_info(struct retro_system_info *info) {
    memset(info, 0, sizeof(*info));
    info->library_name = "Libretro Core Hello World";
    info->library_version = "1.0";
-   info->need_fullpath = false;
+   // Font content is mapped straight from disk, so ask for a path
+   info->need_fullpath = true;
    info->block_extract = false;
-   info->valid_extensions = "";
+   info->valid_extensions = "psf|psfu|bdf|hwv|hws";
    if (log_cb)
       log_cb(RETRO_LOG_INFO, "[DEBUG] System info: %s v%s, need_fullpath=%d\n",
              info->library_name, info->library_version, info->need_fullpath);
@@ -246,17 +628,19 @@ void retro_get_system_info(struct retro_system_info *info) {
 // Called to get system AV information
 void retro_get_system_av_info(struct retro_system_av_info *info) {
    memset(info, 0, sizeof(*info));
-   info->geometry.base_width = WIDTH;
-   info->geometry.base_height = HEIGHT;
-   info->geometry.max_width = WIDTH;
-   info->geometry.max_height = HEIGHT;
+   info->geometry.base_width = WIDTH * postfx.scale;
+   info->geometry.base_height = HEIGHT * postfx.scale;
+   info->geometry.max_width = WIDTH * POSTFX_MAX_SCALE;
+   info->geometry.max_height = HEIGHT * POSTFX_MAX_SCALE;
    info->geometry.aspect_ratio = (float)WIDTH / HEIGHT;
    info->timing.fps = 60.0;
    info->timing.sample_rate = 48000.0;
    if (log_cb)
-      log_cb(RETRO_LOG_INFO, "[DEBUG] AV info: %dx%d, %.2f fps\n", WIDTH, HEIGHT, info->timing.fps);
+      log_cb(RETRO_LOG_INFO, "[DEBUG] AV info: %ux%u, %.2f fps\n",
+             info->geometry.base_width, info->geometry.base_height, info->timing.fps);
    else
-      fallback_log_format("DEBUG", "AV info: %dx%d, %.2f fps\n", WIDTH, HEIGHT, info->timing.fps);
+      fallback_log_format("DEBUG", "AV info: %ux%u, %.2f fps\n",
+                          info->geometry.base_width, info->geometry.base_height, info->timing.fps);
 }
 
 // Called when the core is loaded
@@ -280,6 +664,698 @@ void retro_reset(void) {
       fallback_log("DEBUG", "Core reset\n");
 }
 
+// Ground texture for the Mode 7 backgrounds: grass squares crossed by a
+// grid of roads, repeating every 256 texels
+#define MODE7_MAP_LOG2 8
+#define MODE7_MAP_SIZE (1 << MODE7_MAP_LOG2)
+#define MODE7_HORIZON 80
+static uint16_t mode7_map[MODE7_MAP_SIZE * MODE7_MAP_SIZE];
+static const struct mode7_texture mode7_texture = { mode7_map, MODE7_MAP_LOG2, MODE7_MAP_LOG2 };
+static bool mode7_map_built = false;
+
+static void build_mode7_map(void) {
+   for (int y = 0; y < MODE7_MAP_SIZE; y++) {
+      for (int x = 0; x < MODE7_MAP_SIZE; x++) {
+         int rx = x % 64, ry = y % 64;
+         uint16_t c = ((x / 16 + y / 16) & 1) ? 0x2C45 : 0x3506;
+         if (rx < 8 || ry < 8) {
+            c = 0x52AA;
+            // Dashed centre lines
+            if ((rx == 3 || rx == 4) && ry >= 8 && (y / 6) % 2)
+               c = 0xFFFF;
+            if ((ry == 3 || ry == 4) && rx >= 8 && (x / 6) % 2)
+               c = 0xFFFF;
+         }
+         mode7_map[y * MODE7_MAP_SIZE + x] = c;
+      }
+   }
+   mode7_map_built = true;
+}
+
+// Replaces the clear: sky above the horizon and the plane below it, a
+// full-screen rotozoom, or a slowly panning and zooming picture
+static void draw_background(void) {
+   if (!mode7_map_built)
+      build_mode7_map();
+   float t = (float)frame_count / 60.0f;
+   if (background == BACKGROUND_PICTURE) {
+      int size = 160 + (int)(90.0f * sinf(t * 0.25f));
+      int left = (MODE7_MAP_SIZE - size) / 2 + (int)((MODE7_MAP_SIZE - size) / 2 * cosf(t * 0.4f));
+      int top = (MODE7_MAP_SIZE - size) / 2 + (int)((MODE7_MAP_SIZE - size) / 2 * sinf(t * 0.3f));
+      scale_image(&mode7_map[top * MODE7_MAP_SIZE + left], MODE7_MAP_SIZE * sizeof(uint16_t),
+                  size, size * 3 / 4, framebuffer, WIDTH * sizeof(uint16_t), WIDTH, HEIGHT,
+                  RETRO_PIXEL_FORMAT_RGB565, SCALE_FILTER_BILINEAR);
+      return;
+   }
+   if (background == BACKGROUND_ROTOZOOM) {
+      mode7_draw_affine(framebuffer, WIDTH, HEIGHT, &mode7_texture, t * 20.0f, t * 8.0f,
+                        t * 0.4f, 1.5f + sinf(t * 0.7f));
+      return;
+   }
+   for (int y = 0; y < MODE7_HORIZON; y++) {
+      int k = y * 24 / MODE7_HORIZON;   // Darker blue at the top
+      draw_span(&screen, 0, WIDTH - 1, y, (uint16_t)((k / 3) << 11 | (k + 24) << 5 | 31));
+   }
+   struct mode7_view view = {
+      128.0f + 96.0f * cosf(t * 0.3f), 128.0f + 96.0f * sinf(t * 0.3f),
+      t * 0.3f + 1.9f, 24.0f, 160.0f, MODE7_HORIZON,
+   };
+   mode7_draw_perspective(framebuffer, WIDTH, HEIGHT, &mode7_texture, &view);
+}
+
+// Draw the demo scene into the RGB565 framebuffer
+static void draw_scene(void) {
+   if (background != BACKGROUND_NONE)
+      draw_background();
+   else
+      clear_framebuffer();
+
+   // Draw a 20x20 red square at (square_x, square_y)
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+  //  if (log_cb)
+  //     log_cb(RETRO_LOG_INFO, "[DEBUG] Drawing red square at (%d, %d)\n", square_x, square_y);
+  //  else
+  //     fallback_log_format("DEBUG", "Drawing red square at (%d, %d)\n", square_x, square_y);
+
+   // Draw "Hello World" at (50, 50)
+   draw_string(50, 50, "Hello World", COLOR_WHITE);
+
+   // Same text scaled up with anti-aliased edges
+   draw_string_aa(50, 66, "Hello World", 20, COLOR_WHITE);
+
+   // And rendered from the distance field atlas
+   draw_string_sdf(50, 96, "Hello World", 24, COLOR_WHITE);
+
+   // Help text, wrapped and centered near the bottom of the screen
+   draw_paragraph(10, HEIGHT - 40, WIDTH - 20,
+                  "Use the D-pad to move the red square around the screen.",
+                  LAYOUT_ALIGN_CENTER, COLOR_WHITE);
+
+   // Recent log messages along the bottom edge
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Flat-colour version of the scene drawn as palette indices. The
+// anti-aliased and distance-field lines need true colour blending and are
+// left out; the strip below them animates through the palette alone.
+static void draw_scene_indexed(void) {
+   memset(framebuffer8, INDEX_BLACK, sizeof(framebuffer8));
+   palette_rotate(&palette, INDEX_CYCLE_FIRST, INDEX_CYCLE_COUNT);
+
+   for (int y = 140; y < 156; y++)
+      for (int x = 0; x < WIDTH; x++)
+         framebuffer8[y * WIDTH + x] = (uint8_t)(INDEX_CYCLE_FIRST + (x / 10) % INDEX_CYCLE_COUNT);
+
+   for (int y = 0; y < 20 && square_y + y < HEIGHT; y++) {
+      int width = square_x + 20 <= WIDTH ? 20 : WIDTH - square_x;
+      memset(&framebuffer8[(square_y + y) * WIDTH + square_x], INDEX_RED, width);
+   }
+
+   text_draw_span8(framebuffer8, WIDTH, HEIGHT, 50, 50, "Hello World", strlen("Hello World"), INDEX_WHITE);
+   layout_draw8(framebuffer8, WIDTH, HEIGHT, 10, HEIGHT - 40,
+                "Use the D-pad to move the red square around the screen.",
+                WIDTH - 20, LAYOUT_ALIGN_CENTER, INDEX_WHITE);
+}
+
+// Small deterministic generator for scene layouts
+static uint32_t scene_rand(uint32_t *state) {
+   *state = *state * 1664525u + 1013904223u;
+   return *state >> 8;
+}
+
+// Vector stress test: over a thousand animated primitives per frame
+static void draw_scene_shapes(void) {
+   clear_framebuffer();
+   uint32_t seed = 1;
+   int t = (int)(frame_count % 360);
+
+   for (int i = 0; i < 600; i++) {
+      int x = (int)(scene_rand(&seed) % (WIDTH + 80)) - 40;
+      int y = (int)(scene_rand(&seed) % (HEIGHT + 80)) - 40;
+      int dx = (int)(scene_rand(&seed) % 81) - 40, dy = (int)(scene_rand(&seed) % 81) - 40;
+      draw_line(&screen, x + t % 40 - 20, y, x + dx, y + dy, (uint16_t)scene_rand(&seed));
+   }
+   for (int i = 0; i < 300; i++) {
+      int x = (int)(scene_rand(&seed) % WIDTH), y = (int)(scene_rand(&seed) % HEIGHT);
+      int r = (int)(scene_rand(&seed) % 12) + 1 + (t / 8 + i) % 6;
+      uint16_t color = (uint16_t)scene_rand(&seed);
+      if (i & 1)
+         draw_circle_fill(&screen, x, y, r, color);
+      else
+         draw_circle(&screen, x, y, r, color);
+   }
+   for (int i = 0; i < 200; i++) {
+      int x = (int)(scene_rand(&seed) % WIDTH), y = (int)(scene_rand(&seed) % HEIGHT);
+      int rx = (int)(scene_rand(&seed) % 24) + 2, ry = (int)(scene_rand(&seed) % 12) + 2;
+      uint16_t color = (uint16_t)scene_rand(&seed);
+      if (i & 1)
+         draw_ellipse_fill(&screen, x, y, rx, ry, color);
+      else
+         draw_ellipse(&screen, x, y, rx, ry, color);
+   }
+   for (int i = 0; i < 150; i++) {
+      struct draw_point tri[3];
+      int x = (int)(scene_rand(&seed) % WIDTH), y = (int)(scene_rand(&seed) % HEIGHT);
+      for (int k = 0; k < 3; k++) {
+         tri[k].x = x + (int)(scene_rand(&seed) % 41) - 20;
+         tri[k].y = y + (int)(scene_rand(&seed) % 41) - 20;
+      }
+      draw_polygon_fill(&screen, tri, 3, (uint16_t)scene_rand(&seed));
+   }
+
+   // A self-intersecting star shows the even-odd rule
+   static const int star_x[5] = { 0, 59, -95, 95, -59 };
+   static const int star_y[5] = { -100, 81, -31, -31, 81 };
+   struct draw_point star[5];
+   for (int k = 0; k < 5; k++) {
+      star[k].x = WIDTH / 2 + star_x[k] * 7 / 10;
+      star[k].y = HEIGHT / 2 + star_y[k] * 7 / 10;
+   }
+   draw_polygon_fill(&screen, star, 5, COLOR_WHITE);
+   draw_polygon(&screen, star, 5, COLOR_RED);
+
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Five-pointed star of outer radius r, drawn in one self-intersecting stroke
+static void build_star(struct path *path, float cx, float cy, float r, float angle) {
+   path_reset(path);
+   for (int k = 0; k < 5; k++) {
+      float a = angle + k * 4.0f * 3.14159265f / 5.0f;
+      if (k == 0)
+         path_move_to(path, cx + r * sinf(a), cy - r * cosf(a));
+      else
+         path_line_to(path, cx + r * sinf(a), cy - r * cosf(a));
+   }
+   path_close(path);
+}
+
+// Heart of the given size from two cubic curves
+static void build_heart(struct path *path, float cx, float cy, float size) {
+   path_reset(path);
+   path_move_to(path, cx, cy + size * 0.9f);
+   path_cubic_to(path, cx - size * 1.6f, cy - size * 0.1f, cx - size * 0.6f, cy - size * 1.3f,
+                 cx, cy - size * 0.45f);
+   path_cubic_to(path, cx + size * 0.6f, cy - size * 1.3f, cx + size * 1.6f, cy - size * 0.1f,
+                 cx, cy + size * 0.9f);
+}
+
+// The gauges are centred on row GAUGE_CY of a strip GAUGE_PANEL_HEIGHT tall
+#define GAUGE_CY           75
+#define GAUGE_PANEL_HEIGHT 80
+
+// Rings and tick marks of the three gauges, drawn over black once into an
+// offscreen panel; returns false if it could not be allocated
+static bool build_gauge_faces(void) {
+   if (!surface_alloc(&gauge_faces, WIDTH, GAUGE_PANEL_HEIGHT))
+      return false;
+   float cy = GAUGE_PANEL_HEIGHT / 2;
+   for (int g = 0; g < 3; g++) {
+      float cx = WIDTH * (g + 1) / 4.0f;
+      draw_aa_ring(&gauge_faces, cx, cy, 34.0f, 4.0f, 0x528A);
+      draw_aa_ring(&gauge_faces, cx, cy, 28.0f, 1.0f, 0x2945);
+      // Tick marks every tenth of the scale
+      for (int k = 0; k <= 10; k++) {
+         float a = 3.14159265f * (0.75f + 0.15f * k);
+         draw_aa_line(&gauge_faces, cx + 22.0f * cosf(a), cy + 22.0f * sinf(a),
+                      cx + 27.0f * cosf(a), cy + 27.0f * sinf(a), COLOR_WHITE);
+      }
+   }
+   return true;
+}
+
+// Anti-aliased dashboard: ring gauges with sweeping needles over a graph
+static void draw_scene_gauges(void) {
+   clear_framebuffer();
+   float t = (float)frame_count / 60.0f;
+
+   // Sine graph scrolling through a strip, with a marker on every sample;
+   // the scissor trims the samples entering and leaving at either end
+   float step = (WIDTH - 20) / 32.0f, scroll = t * 30.0f;
+   int first = (int)floorf(scroll / step);
+   float prev_x = 0.0f, prev_y = 0.0f;
+   surface_push_scissor(&screen, 10, HEIGHT - 66, WIDTH - 20, 52);
+   for (int i = first - 1; i <= first + 33; i++) {
+      float x = 10.0f + i * step - scroll;
+      float y = HEIGHT - 40.0f + 22.0f * sinf(i * 0.4f);
+      if (i > first - 1)
+         draw_aa_line(&screen, prev_x, prev_y, x, y, 0x07E0);
+      draw_aa_circle_fill(&screen, x, y, 2.5f, COLOR_WHITE);
+      prev_x = x;
+      prev_y = y;
+   }
+   surface_pop_scissor(&screen);
+
+   if (gauge_faces.pixels || build_gauge_faces())
+      surface_blit(&screen, &gauge_faces, 0, GAUGE_CY - GAUGE_PANEL_HEIGHT / 2);
+   for (int g = 0; g < 3; g++) {
+      float cx = WIDTH * (g + 1) / 4.0f, cy = GAUGE_CY;
+      float value = 0.5f + 0.5f * sinf(t * (1.0f + g * 0.7f));
+      float angle = 3.14159265f * (0.75f + 1.5f * value);
+      draw_aa_line(&screen, cx, cy,
+                   cx + 30.0f * cosf(angle), cy + 30.0f * sinf(angle), COLOR_RED);
+      draw_aa_circle_fill(&screen, cx, cy, 3.5f, COLOR_WHITE);
+   }
+
+   draw_aa_ellipse_fill(&screen, WIDTH / 2.0f + 60.0f * sinf(t), 145.0f,
+                        40.0f, 12.0f + 6.0f * sinf(t * 1.3f), 0x041F);
+
+   // Path icons: the same star under both fill rules, and a beating heart
+   build_star(&icon_path, 28.0f, 145.0f, 22.0f, t);
+   path_fill(&screen, &icon_path, PATH_FILL_EVEN_ODD, 0xFFE0);
+   build_star(&icon_path, 292.0f, 145.0f, 22.0f, -t);
+   path_fill(&screen, &icon_path, PATH_FILL_NONZERO, 0xFFE0);
+   build_heart(&icon_path, 295.0f, 20.0f, 10.0f + 2.0f * fabsf(sinf(t * 3.0f)));
+   path_fill(&screen, &icon_path, PATH_FILL_NONZERO, 0xF810);
+
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Cube meshes for the 3D scene: 4 vertices per face so each face gets its
+// own texture coordinates and colour
+#define CUBE_TEXTURE_SIZE 32
+static struct raster3d_vertex cube_faces[24];   // One colour per face
+static struct raster3d_vertex cube_corners[24]; // Colour from position
+static uint16_t cube_indices[36];
+static uint16_t cube_texels[CUBE_TEXTURE_SIZE * CUBE_TEXTURE_SIZE];
+static const struct raster3d_texture cube_texture = { cube_texels, CUBE_TEXTURE_SIZE, CUBE_TEXTURE_SIZE };
+static bool cubes_built = false;
+
+static void build_cubes(void) {
+   // Corners of each face, counter-clockwise seen from outside
+   static const int8_t faces[6][4][3] = {
+      { { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 } },
+      { {  1, -1, -1 }, { -1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 } },
+      { {  1, -1,  1 }, {  1, -1, -1 }, {  1,  1, -1 }, {  1,  1,  1 } },
+      { { -1, -1, -1 }, { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 } },
+      { { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+      { { -1, -1, -1 }, {  1, -1, -1 }, {  1, -1,  1 }, { -1, -1,  1 } },
+   };
+   static const uint16_t face_colors[6] = { 0xF800, 0x07E0, 0x001F, 0xFFE0, 0x07FF, 0xF81F };
+   static const float uv[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+   for (int f = 0; f < 6; f++) {
+      for (int k = 0; k < 4; k++) {
+         struct raster3d_vertex *v = &cube_faces[f * 4 + k];
+         v->x = faces[f][k][0];
+         v->y = faces[f][k][1];
+         v->z = faces[f][k][2];
+         v->u = uv[k][0] * CUBE_TEXTURE_SIZE;
+         v->v = uv[k][1] * CUBE_TEXTURE_SIZE;
+         v->color = face_colors[f];
+         cube_corners[f * 4 + k] = *v;
+         cube_corners[f * 4 + k].color = (uint16_t)((v->x > 0 ? 0xF800 : 0) |
+                                                    (v->y > 0 ? 0x07E0 : 0) |
+                                                    (v->z > 0 ? 0x001F : 0));
+      }
+      static const uint16_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+      for (int k = 0; k < 6; k++)
+         cube_indices[f * 6 + k] = (uint16_t)(f * 4 + quad[k]);
+   }
+   // Checkerboard with a gradient so texture mapping is easy to follow
+   for (int y = 0; y < CUBE_TEXTURE_SIZE; y++)
+      for (int x = 0; x < CUBE_TEXTURE_SIZE; x++)
+         cube_texels[y * CUBE_TEXTURE_SIZE + x] = ((x / 8 + y / 8) & 1) ?
+            (uint16_t)((x << 11) | (y << 6) | 0x1F) : 0x2104;
+   cubes_built = true;
+}
+
+// Draw a cube of half-size scale at (x, y, z) in view space, spun by angle
+static void draw_cube(const float projection[16], const struct raster3d_vertex *vertices,
+                      const struct raster3d_material *material,
+                      float x, float y, float z, float scale, float angle) {
+   float m[16];
+   memcpy(m, projection, sizeof(m));
+   raster3d_mat_translate(m, x, y, z);
+   raster3d_mat_rotate(m, angle, 0.3f, 1.0f, 0.2f);
+   raster3d_mat_rotate(m, angle * 0.7f, 1.0f, 0.0f, 0.0f);
+   float s[16];
+   raster3d_mat_identity(s);
+   s[0] = s[5] = s[10] = scale;
+   raster3d_mat_multiply(m, m, s);
+   raster3d_draw(m, vertices, cube_indices, 12, material);
+}
+
+// Software 3D: three large cubes, one per shading mode, with a ring of
+// small cubes orbiting through them
+static void draw_scene_cubes(void) {
+   static const struct raster3d_material flat = { RASTER3D_SHADE_FLAT, NULL, false };
+   static const struct raster3d_material gouraud = { RASTER3D_SHADE_GOURAUD, NULL, false };
+   static const struct raster3d_material textured = { RASTER3D_SHADE_TEXTURED, &cube_texture, false };
+   if (!cubes_built)
+      build_cubes();
+   clear_framebuffer();
+   float t = (float)frame_count / 60.0f;
+   float projection[16];
+   raster3d_mat_perspective(projection, 1.0f, (float)WIDTH / HEIGHT, 0.5f, 50.0f);
+
+   if (raster3d_begin(framebuffer, WIDTH, HEIGHT)) {
+      draw_cube(projection, cube_faces, &flat, -2.8f, 0.0f, -8.0f, 1.0f, t);
+      draw_cube(projection, cube_faces, &textured, 0.0f, 0.0f, -7.0f, 1.2f, t * 0.8f);
+      draw_cube(projection, cube_corners, &gouraud, 2.8f, 0.0f, -8.0f, 1.0f, -t);
+      for (int i = 0; i < 24; i++) {
+         float a = t * 0.5f + i * 2.0f * 3.14159265f / 24.0f;
+         const struct raster3d_material *m = i % 3 == 0 ? &flat : i % 3 == 1 ? &gouraud : &textured;
+         draw_cube(projection, i % 3 == 1 ? cube_corners : cube_faces, m,
+                   4.0f * cosf(a), 0.6f * sinf(a * 3.0f), -9.0f + 3.0f * sinf(a), 0.3f, t * 2.0f + i);
+      }
+      raster3d_end();
+
+      // Report how much work the depth hierarchy saved every 5 seconds
+      if (frame_count % 300 == 0) {
+         struct raster3d_stats stats;
+         raster3d_get_stats(&stats);
+         core_log(RETRO_LOG_INFO, "3D: %u triangles, %u tile tests, %u rejected and %u "
+                  "accepted by depth, %u of %u covered pixels written\n",
+                  stats.triangles, stats.tile_tests, stats.tiles_rejected, stats.tiles_accepted,
+                  stats.pixels_written, stats.pixels_covered);
+      }
+   }
+
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Raycaster world: a 16x16 maze whose wall digits pick one of four textures
+#define RAYCAST_MAP_SIZE 16
+#define RAYCAST_WALL_TEXTURES 4
+static const char *const raycast_rows[RAYCAST_MAP_SIZE] = {
+   "1111111111111111",
+   "1..............1",
+   "1..22....3333..1",
+   "1..2.....3..3..1",
+   "1..2..........41",
+   "1.....1111....41",
+   "1.....1..1.....1",
+   "1..3..1..1..2..1",
+   "1..3.......22..1",
+   "1..3..4........1",
+   "1.....4...3333.1",
+   "1..2222........1",
+   "1..........4...1",
+   "1...33.....4...1",
+   "1..............1",
+   "1111111111111111",
+};
+#define TEXELS (RAYCAST_TEXTURE_SIZE * RAYCAST_TEXTURE_SIZE)
+static uint8_t raycast_cells[RAYCAST_MAP_SIZE * RAYCAST_MAP_SIZE];
+static uint16_t raycast_walls[RAYCAST_WALL_TEXTURES * TEXELS];
+static uint16_t raycast_floor[TEXELS];
+static uint16_t raycast_ceiling[TEXELS];
+static const struct raycast_world raycast_world = {
+   raycast_cells, RAYCAST_MAP_SIZE, RAYCAST_MAP_SIZE,
+   raycast_walls, RAYCAST_WALL_TEXTURES, raycast_floor, raycast_ceiling,
+};
+static bool raycast_built = false;
+
+// Textures are drawn row by row like any framebuffer, then stored
+// transposed as the raycaster expects
+static void store_texture(uint16_t *dst, const uint16_t *rows) {
+   for (int y = 0; y < RAYCAST_TEXTURE_SIZE; y++)
+      for (int x = 0; x < RAYCAST_TEXTURE_SIZE; x++)
+         dst[x * RAYCAST_TEXTURE_SIZE + y] = rows[y * RAYCAST_TEXTURE_SIZE + x];
+}
+
+static void build_raycast_world(void) {
+   static uint16_t tex[TEXELS];
+   const int n = RAYCAST_TEXTURE_SIZE;
+   for (int y = 0; y < RAYCAST_MAP_SIZE; y++)
+      for (int x = 0; x < RAYCAST_MAP_SIZE; x++) {
+         char c = raycast_rows[y][x];
+         raycast_cells[y * RAYCAST_MAP_SIZE + x] = c == '.' ? 0 : (uint8_t)(c - '0');
+      }
+
+   // Bricks with offset courses
+   for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+         int bx = (x + (y / 16 % 2) * 16) % 32;
+         tex[y * n + x] = (y % 16 == 0 || bx == 0) ? 0x8C51 : (uint16_t)(0xA800 + ((x * 7 + y * 3) % 4) * 0x0841);
+      }
+   store_texture(&raycast_walls[0], tex);
+   // Stone blocks
+   for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++)
+         tex[y * n + x] = (x % 32 < 2 || y % 32 < 2) ? 0x4208 : (uint16_t)(0x8410 + ((x ^ y) & 3) * 0x0841);
+   store_texture(&raycast_walls[TEXELS], tex);
+   // Wooden planks
+   for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++)
+         tex[y * n + x] = x % 16 == 0 ? 0x4100 : (uint16_t)(0x9240 + ((y + x / 16 * 11) % 8 < 2) * 0x1060);
+   store_texture(&raycast_walls[2 * TEXELS], tex);
+   // Blue tiles signed with the font
+   for (int i = 0; i < TEXELS; i++)
+      tex[i] = ((i % n) % 16 == 0 || (i / n) % 16 == 0) ? 0x632C : 0x1A7B;
+   struct surface sign;
+   surface_init(&sign, tex, n, n, n);
+   text_draw_string(&sign, 12, 20, "HELLO", COLOR_WHITE);
+   text_draw_string(&sign, 12, 36, "WORLD", COLOR_WHITE);
+   store_texture(&raycast_walls[3 * TEXELS], tex);
+
+   for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+         tex[y * n + x] = ((x / 32 + y / 32) & 1) ? 0x3186 : 0x528A;
+      }
+   store_texture(raycast_floor, tex);
+   for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+         int dx = x - n / 2, dy = y - n / 2;
+         tex[y * n + x] = dx * dx + dy * dy < 36 ? 0xFFF0 : 0x2104;
+      }
+   store_texture(raycast_ceiling, tex);
+   raycast_built = true;
+}
+
+// Walk forward/back and turn, sliding along walls
+static void move_raycast_view(bool forward, bool back, bool left, bool right) {
+   const float speed = 0.05f, margin = 0.2f;
+   if (left)
+      raycast_view.angle -= 0.04f;
+   if (right)
+      raycast_view.angle += 0.04f;
+   float step = forward ? speed : back ? -speed : 0.0f;
+   if (step == 0.0f || !raycast_built)
+      return;
+   float dx = cosf(raycast_view.angle) * step, dy = sinf(raycast_view.angle) * step;
+   float px = dx < 0.0f ? -margin : margin, py = dy < 0.0f ? -margin : margin;
+   if (!raycast_solid(&raycast_world, raycast_view.x + dx + px, raycast_view.y))
+      raycast_view.x += dx;
+   if (!raycast_solid(&raycast_world, raycast_view.x, raycast_view.y + dy + py))
+      raycast_view.y += dy;
+}
+
+// First-person maze, one ray per column; the D-pad moves the camera
+static void draw_scene_raycast(void) {
+   if (!raycast_built)
+      build_raycast_world();
+   raycast_render(framebuffer, WIDTH, HEIGHT, &raycast_world, &raycast_view);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Voxel terrain fly-over; uses loaded .hwv content or a generated landscape
+static void draw_scene_terrain(void) {
+   if (!terrain.heights && !voxel_map_generate(&terrain, 10, 12345)) {
+      clear_framebuffer();
+      return;
+   }
+   float t = (float)frame_count / 60.0f;
+   struct voxel_view view = {
+      0.0f, 0.0f, 0.0f, 0.3f * t + 0.4f * sinf(t * 0.2f), 1.3f, 70.0f, 140.0f, 1200.0f,
+   };
+   // Fly forward, keeping well above the ground just ahead
+   view.x = 60.0f * t * cosf(view.angle * 0.5f) + 300.0f;
+   view.y = 60.0f * t * sinf(view.angle * 0.5f) + 300.0f;
+   float ground = (float)voxel_height_at(&terrain, view.x + 20.0f * cosf(view.angle),
+                                         view.y + 20.0f * sinf(view.angle));
+   if (terrain_altitude < ground + 60.0f)
+      terrain_altitude = ground + 60.0f;
+   else
+      terrain_altitude += (ground + 60.0f - terrain_altitude) * 0.02f;
+   view.altitude = terrain_altitude;
+   voxel_render(framebuffer, WIDTH, HEIGHT, &terrain, &view, 0x867D);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Writes text into tilemap cells using the font glyphs as tiles
+static void put_tile_text(int x, int y, const char *text, int palette) {
+   for (; *text; text++, x++) {
+      int c = (unsigned char)*text;
+      int tile = c >= FONT_FIRST_CHAR && c <= FONT_LAST_CHAR ? c - FONT_FIRST_CHAR : 0;
+      tilemap_set(&tiles, x, y, TILEMAP_CELL(tile, palette));
+   }
+}
+
+static const char *const tile_words[] = {
+   "HELLO", "WORLD", "libretro", "tiles", "8x8", "scroll", "cache", "dirty",
+};
+
+// Text-mode tilemap scrolled diagonally; only the counter line changes
+// cells, so most frames redraw just the tiles entering the view
+static void draw_scene_tiles(void) {
+   if (!tiles.cells) {
+      if (!tilemap_init(&tiles, 64, 40, font_8x8, FONT_GLYPH_COUNT, WIDTH, HEIGHT)) {
+         clear_framebuffer();
+         return;
+      }
+      static const uint16_t colors[][2] = {
+         { 0xFFFF, 0x0010 }, { 0xFFE0, 0x0010 }, { 0x07FF, 0x0008 }, { 0xF81F, 0x2000 },
+         { 0x07E0, 0x0000 }, { 0xFD20, 0x1082 }, { 0x0000, 0xC618 }, { 0xF800, 0x0000 },
+      };
+      for (int i = 0; i < 8; i++)
+         tilemap_set_colors(&tiles, i, colors[i][0], colors[i][1]);
+      uint32_t seed = 7;
+      for (int y = 0; y < tiles.height; y++)
+         for (int x = 0; x < tiles.width; ) {
+            const char *word = tile_words[scene_rand(&seed) % 8];
+            int palette = (int)(scene_rand(&seed) % 8);
+            put_tile_text(x, y, word, palette);
+            x += (int)strlen(word);
+            tilemap_set(&tiles, x++, y, TILEMAP_CELL(0, palette));
+         }
+   }
+
+   char counter[32];
+   snprintf(counter, sizeof(counter), " FRAME %08u ", frame_count);
+   put_tile_text(2, 2, counter, 7);
+
+   tilemap_render(&tiles, &screen, (int)frame_count, (int)(frame_count / 2));
+
+   // Report redraw counts every 5 seconds
+   if (frame_count % 300 == 0)
+      core_log(RETRO_LOG_INFO, "Tiles: %u of %d redrawn\n", tiles.redrawn,
+               tiles.layer_columns * tiles.layer_rows);
+
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
+// Stand-in sprites when no sprite list was loaded: shaded balls, rings
+// and diamonds of assorted sizes, with soft alpha edges
+static bool build_sprite_atlas(void) {
+   enum { COUNT = 18 };
+   static const uint16_t colors[] = { 0xF800, 0x07E0, 0x001F, 0xFFE0, 0xF81F, 0x07FF };
+   struct atlas_image images[COUNT];
+   char names[COUNT][16];
+   size_t total = 0;
+   for (int i = 0; i < COUNT; i++)
+      total += (size_t)(8 + i * 3) * (8 + i * 3);
+   uint16_t *pixels = malloc(total * 3);
+   if (!pixels)
+      return false;
+   uint8_t *alpha = (uint8_t *)(pixels + total);
+
+   size_t at = 0;
+   for (int i = 0; i < COUNT; i++) {
+      int size = 8 + i * 3, kind = i % 3;
+      uint16_t color = colors[i % 6];
+      float r = size * 0.5f;
+      for (int y = 0; y < size; y++)
+         for (int x = 0; x < size; x++) {
+            float dx = x + 0.5f - r, dy = y + 0.5f - r;
+            float d = kind == 2 ? fabsf(dx) + fabsf(dy) : sqrtf(dx * dx + dy * dy);
+            float a = r - d;
+            if (kind == 1)
+               a = fminf(a, d - r * 0.55f);
+            a = a < 0.0f ? 0.0f : a > 1.0f ? 1.0f : a;
+            // Darken away from a highlight at the upper left
+            float light = 1.0f - 0.9f * sqrtf((dx + r * 0.35f) * (dx + r * 0.35f) +
+                                              (dy + r * 0.35f) * (dy + r * 0.35f)) / size;
+            light = light < 0.3f ? 0.3f : light;
+            int cr = (int)(((color >> 11) & 31) * light), cg = (int)(((color >> 5) & 63) * light);
+            int cb = (int)((color & 31) * light);
+            pixels[at + y * size + x] = (uint16_t)(cr << 11 | cg << 5 | cb);
+            alpha[at + y * size + x] = (uint8_t)(a * 255.0f + 0.5f);
+         }
+      snprintf(names[i], sizeof(names[i]), "%s%d", kind == 0 ? "ball" : kind == 1 ? "ring" : "gem", i / 3);
+      images[i].name = names[i];
+      images[i].width = images[i].height = size;
+      images[i].pixels = &pixels[at];
+      images[i].alpha = &alpha[at];
+      at += (size_t)size * size;
+   }
+   bool ok = atlas_pack(&sprites, images, COUNT);
+   free(pixels);
+   if (ok)
+      core_log(RETRO_LOG_INFO, "Packed %d sprites into a %dx%d atlas\n",
+               COUNT, sprites.width, sprites.height);
+   return ok;
+}
+
+// Triangle wave bouncing between 0 and range
+static int bounce(int t, int range) {
+   if (range <= 0)
+      return 0;
+   t %= 2 * range;
+   return t < range ? t : 2 * range - t;
+}
+
+// Hundreds of sprites bouncing around, half of them spinning and
+// zooming and the rest alpha blended, every one drawn from the atlas
+static void draw_scene_sprites(void) {
+   if (!sprites.pixels && !build_sprite_atlas()) {
+      clear_framebuffer();
+      return;
+   }
+   for (int y = 0; y < HEIGHT; y++)
+      for (int x = 0; x < WIDTH; x++)
+         framebuffer[y * WIDTH + x] = ((x / 16 + y / 16) & 1) ? 0x2124 : 0x18C3;
+
+   uint32_t seed = 3;
+   for (int i = 0; i < 250; i++) {
+      int sprite = (int)(scene_rand(&seed) % (uint32_t)sprites.sprite_count);
+      const struct atlas_sprite *s = &sprites.sprites[sprite];
+      int speed_x = 1 + (int)(scene_rand(&seed) % 3), speed_y = 1 + (int)(scene_rand(&seed) % 3);
+      int x = bounce((int)(scene_rand(&seed) % 1000 + frame_count * speed_x), WIDTH - s->width);
+      int y = bounce((int)(scene_rand(&seed) % 1000 + frame_count * speed_y), HEIGHT - s->height);
+      if (i % 2 == 0) {
+         // Soft-edged, with every other one at half opacity
+         atlas_blit_blend(&screen, &sprites, sprite, x, y, i % 4 ? 128 : 255);
+         continue;
+      }
+      // Every other sprite spins and pulses about its centre
+      float phase = (float)(scene_rand(&seed) % 628) / 100.0f;
+      float spin = ((float)(scene_rand(&seed) % 200) - 100.0f) / 1000.0f;
+      atlas_blit_affine(&screen, &sprites, sprite,
+                        x + s->width * 0.5f, y + s->height * 0.5f, phase + spin * frame_count,
+                        1.0f + 0.5f * sinf(phase + frame_count * 0.03f));
+   }
+
+   // Area-averaged thumbnail of the whole atlas in the top-right corner
+   int thumb_width = 80, thumb_height = 80 * sprites.height / sprites.width;
+   if (thumb_height > 0 && thumb_height <= HEIGHT - 8) {
+      int left = WIDTH - thumb_width - 4;
+      draw_rect(&screen, left - 1, 3, thumb_width + 2, thumb_height + 2, COLOR_WHITE);
+      scale_image(sprites.pixels, sprites.width * sizeof(uint16_t), sprites.width, sprites.height,
+                  &framebuffer[4 * WIDTH + left], WIDTH * sizeof(uint16_t), thumb_width, thumb_height,
+                  RETRO_PIXEL_FORMAT_RGB565, SCALE_FILTER_BOX);
+   }
+
+   // Caption on a translucent panel
+   char caption[64];
+   snprintf(caption, sizeof(caption), "250 sprites, %d in a %dx%d atlas",
+            sprites.sprite_count, sprites.width, sprites.height);
+   draw_rect_blend(&screen, 0, HEIGHT - 20, WIDTH, 20, 0x0000, 160);
+   draw_string(8, HEIGHT - 14, caption, COLOR_WHITE);
+
+   draw_rect(&screen, square_x, square_y, 20, 20, COLOR_RED);
+
+   if (console_enabled)
+      console_blit(&screen, HEIGHT);
+}
+
 // Called every frame
 void retro_run(void) {
    if (!initialized) {
@@ -290,48 +1366,73 @@ void retro_run(void) {
       return;
    }
 
-   clear_framebuffer();
+   bool updated = false;
+   if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
+      check_variables();
 
    // Handle input
    if (input_poll_cb)
       input_poll_cb();
    if (input_state_cb) {
-      if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_RIGHT)) {
-         square_x += 1;
-         if (square_x > WIDTH - 20) square_x = WIDTH - 20;
-      }
-      if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_LEFT)) {
-         square_x -= 1;
-         if (square_x < 0) square_x = 0;
-      }
-      // Enable for up/down movement
-      if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_DOWN)) {
-         square_y += 1;
-         if (square_y > HEIGHT - 20) square_y = HEIGHT - 20;
-      }
-      if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_UP)) {
-         square_y -= 1;
-         if (square_y < 0) square_y = 0;
-      }
-   }
+      // L/R scroll the log console, one line per press
+      int16_t l = input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_L);
+      int16_t r = input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_R);
+      if (console_enabled && l && !prev_l)
+         console_scroll(1);
+      if (console_enabled && r && !prev_r)
+         console_scroll(-1);
+      prev_l = l;
+      prev_r = r;
 
-   // Draw a 20x20 red square at (square_x, square_y)
-   for (int y = 0; y < 20; y++) {
-      for (int x = 0; x < 20; x++) {
-         if (square_x + x < WIDTH && square_y + y < HEIGHT)
-            framebuffer[(y + square_y) * WIDTH + (x + square_x)] = COLOR_RED;
+      if (scene == SCENE_RAYCAST) {
+         // The D-pad walks and turns the raycaster camera instead
+         move_raycast_view(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_UP),
+                           input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_DOWN),
+                           input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_LEFT),
+                           input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_RIGHT));
+      } else {
+         if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_RIGHT)) {
+            square_x += 1;
+            if (square_x > WIDTH - 20) square_x = WIDTH - 20;
+         }
+         if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_LEFT)) {
+            square_x -= 1;
+            if (square_x < 0) square_x = 0;
+         }
+         // Enable for up/down movement
+         if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_DOWN)) {
+            square_y += 1;
+            if (square_y > HEIGHT - 20) square_y = HEIGHT - 20;
+         }
+         if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_UP)) {
+            square_y -= 1;
+            if (square_y < 0) square_y = 0;
+         }
       }
    }
-  //  if (log_cb)
-  //     log_cb(RETRO_LOG_INFO, "[DEBUG] Drawing red square at (%d, %d)\n", square_x, square_y);
-  //  else
-  //     fallback_log_format("DEBUG", "Drawing red square at (%d, %d)\n", square_x, square_y);
 
-   // Draw "Hello World" at (50, 50)
-   draw_string(50, 50, "Hello World", COLOR_WHITE);
+   if (scene == SCENE_SHAPES)
+      draw_scene_shapes();
+   else if (scene == SCENE_GAUGES)
+      draw_scene_gauges();
+   else if (scene == SCENE_CUBES)
+      draw_scene_cubes();
+   else if (scene == SCENE_RAYCAST)
+      draw_scene_raycast();
+   else if (scene == SCENE_TERRAIN)
+      draw_scene_terrain();
+   else if (scene == SCENE_TILES)
+      draw_scene_tiles();
+   else if (scene == SCENE_SPRITES)
+      draw_scene_sprites();
+   else if (indexed_mode)
+      draw_scene_indexed();
+   else
+      draw_scene();
+   frame_count++;
 
    if (video_cb) {
-      video_cb(framebuffer, WIDTH, HEIGHT, WIDTH * sizeof(uint16_t));
+      present_frame();
       // if (log_cb)
       //    log_cb(RETRO_LOG_INFO, "[DEBUG] Framebuffer sent to video_cb\n");
       // else
@@ -344,9 +1445,33 @@ void retro_run(void) {
    }
 }
 
+// Terrain and sprite content is told apart from fonts by its extension
+static bool has_extension(const char *path, const char *lower, const char *upper) {
+   const char *dot = strrchr(path, '.');
+   return dot && (strcmp(dot, lower) == 0 || strcmp(dot, upper) == 0);
+}
+
 // Called to load a game
 bool retro_load_game(const struct retro_game_info *game) {
-   (void)game;
+   check_variables();
+   unload_font();
+   if (game && game->path && has_extension(game->path, ".hwv", ".HWV")) {
+      voxel_map_free(&terrain);
+      if (!voxel_map_load(&terrain, game->path))
+         return false;
+   } else if (game && game->path && has_extension(game->path, ".hws", ".HWS")) {
+      atlas_free(&sprites);
+      if (!atlas_load(&sprites, game->path))
+         return false;
+   } else if (game && game->path) {
+      if (!load_font(game->path))
+         return false;
+   } else if (!load_system_font()) {
+      if (log_cb)
+         log_cb(RETRO_LOG_INFO, "[DEBUG] No system font found, using built-in 8x8 font\n");
+      else
+         fallback_log("DEBUG", "No system font found, using built-in 8x8 font\n");
+   }
    if (log_cb)
       log_cb(RETRO_LOG_INFO, "[DEBUG] Game loaded (content-less): Displaying Hello World\n");
    else
@@ -373,6 +1498,10 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 
 // Called to unload a game
 void retro_unload_game(void) {
+   unload_font();
+   voxel_map_free(&terrain);
+   atlas_free(&sprites);
+   layout_cache_clear();
    if (log_cb)
       log_cb(RETRO_LOG_INFO, "[DEBUG] Game unloaded\n");
    else
@@ -0,0 +1,90 @@
+#include "mapfile.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mapfile_open(struct mapped_file *mf, const char *path) {
+   memset(mf, 0, sizeof(*mf));
+   if (!path || !*path)
+      return false;
+#ifdef _WIN32
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+      CloseHandle(file);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!mapping) {
+      CloseHandle(file);
+      return false;
+   }
+   void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (!view) {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+   mf->data = (const uint8_t *)view;
+   mf->size = (size_t)size.QuadPart;
+   mf->file = file;
+   mf->mapping = mapping;
+#else
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return false;
+   }
+   void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd); // The mapping keeps its own reference
+   if (view == MAP_FAILED)
+      return false;
+   mf->data = (const uint8_t *)view;
+   mf->size = (size_t)st.st_size;
+#endif
+   return true;
+}
+
+void mapfile_close(struct mapped_file *mf) {
+   if (mf->data) {
+#ifdef _WIN32
+      UnmapViewOfFile((void *)mf->data);
+      CloseHandle(mf->mapping);
+      CloseHandle(mf->file);
+#else
+      munmap((void *)mf->data, mf->size);
+#endif
+   }
+   memset(mf, 0, sizeof(*mf));
+}
+
+bool mapfile_next_line(const char **cur, const char *end, char *buf, size_t buf_size) {
+   if (*cur >= end)
+      return false;
+   const char *line = *cur;
+   const char *eol = memchr(line, '\n', (size_t)(end - line));
+   if (!eol)
+      eol = end;
+   size_t len = (size_t)(eol - line);
+   if (len && line[len - 1] == '\r')
+      len--;
+   if (len >= buf_size)
+      len = buf_size - 1;
+   memcpy(buf, line, len);
+   buf[len] = '\0';
+   *cur = eol < end ? eol + 1 : end;
+   return true;
+}
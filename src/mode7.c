@@ -0,0 +1,106 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "mode7.h"
+#include "workers.h"
+
+// Texture coordinates of the first pixel of a row and the step between
+// pixels, in 16.16 fixed point. Unsigned arithmetic wraps at 2^16 texels,
+// a multiple of any power-of-two texture size, so stepping never needs to
+// reduce the coordinates itself.
+struct mode7_row {
+   uint32_t u, v;
+   uint32_t du, dv;
+};
+
+struct mode7_job {
+   uint16_t *fb;
+   int fb_width;
+   int first_row;
+   const struct mode7_texture *texture;
+};
+
+static struct mode7_row *rows;
+static int row_capacity;
+
+static bool reserve_rows(int count) {
+   if (count <= row_capacity)
+      return true;
+   struct mode7_row *grown = realloc(rows, count * sizeof(*rows));
+   if (!grown)
+      return false;
+   rows = grown;
+   row_capacity = count;
+   return true;
+}
+
+void mode7_free(void) {
+   free(rows);
+   rows = NULL;
+   row_capacity = 0;
+}
+
+static inline uint32_t to_fixed(float v) {
+   // Through int64 so negative coordinates wrap instead of overflowing
+   return (uint32_t)(int64_t)llrintf(v * 65536.0f);
+}
+
+static void draw_rows(void *ctx, int begin, int end) {
+   const struct mode7_job *job = ctx;
+   const uint16_t *texels = job->texture->pixels;
+   const int width_log2 = job->texture->width_log2;
+   const uint32_t u_mask = (1u << width_log2) - 1;
+   const uint32_t v_mask = (1u << job->texture->height_log2) - 1;
+   for (int i = begin; i < end; i++) {
+      const struct mode7_row *row = &rows[i];
+      uint16_t *dst = &job->fb[(job->first_row + i) * job->fb_width];
+      uint32_t u = row->u, v = row->v;
+      for (int x = 0; x < job->fb_width; x++) {
+         dst[x] = texels[(((v >> 16) & v_mask) << width_log2) | ((u >> 16) & u_mask)];
+         u += row->du;
+         v += row->dv;
+      }
+   }
+}
+
+void mode7_draw_perspective(uint16_t *fb, int fb_width, int fb_height,
+                            const struct mode7_texture *texture, const struct mode7_view *view) {
+   int first = view->horizon < 0 ? 0 : view->horizon;
+   if (first >= fb_height || !reserve_rows(fb_height - first))
+      return;
+   float fx = cosf(view->angle), fy = sinf(view->angle);   // Forward
+   float rx = -fy, ry = fx;                                 // Right
+   for (int y = first; y < fb_height; y++) {
+      // Ground distance seen by this row, and texels per pixel across it
+      float dy = y - view->horizon + 0.5f;
+      float distance = view->height * view->focal / dy;
+      float step = view->height / dy;
+      float half = (fb_width * 0.5f - 0.5f) * step;
+      struct mode7_row *row = &rows[y - first];
+      row->u = to_fixed(view->x + fx * distance - rx * half);
+      row->v = to_fixed(view->y + fy * distance - ry * half);
+      row->du = to_fixed(rx * step);
+      row->dv = to_fixed(ry * step);
+   }
+   struct mode7_job job = { fb, fb_width, first, texture };
+   workers_run(draw_rows, &job, fb_height - first);
+}
+
+void mode7_draw_affine(uint16_t *fb, int fb_width, int fb_height,
+                       const struct mode7_texture *texture,
+                       float cx, float cy, float angle, float scale) {
+   if (scale <= 0.0f || !reserve_rows(fb_height))
+      return;
+   float c = cosf(angle) / scale, s = sinf(angle) / scale;
+   float x0 = -(fb_width * 0.5f - 0.5f);
+   for (int y = 0; y < fb_height; y++) {
+      float y0 = y - (fb_height * 0.5f - 0.5f);
+      struct mode7_row *row = &rows[y];
+      row->u = to_fixed(cx + c * x0 - s * y0);
+      row->v = to_fixed(cy + s * x0 + c * y0);
+      row->du = to_fixed(c);
+      row->dv = to_fixed(s);
+   }
+   struct mode7_job job = { fb, fb_width, 0, texture };
+   workers_run(draw_rows, &job, fb_height);
+}
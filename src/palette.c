@@ -0,0 +1,99 @@
+#include <string.h>
+#include "palette.h"
+#include "cpu.h"
+
+#ifdef HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+void palette_set(struct palette *pal, int index, uint8_t r, uint8_t g, uint8_t b) {
+   pal->xrgb8888[index] = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+   pal->rgb565[index] = ((uint32_t)(r >> 3) << 11) | ((uint32_t)(g >> 2) << 5) | (b >> 3);
+}
+
+void palette_rotate(struct palette *pal, int first, int count) {
+   if (count < 2)
+      return;
+   uint32_t last8888 = pal->xrgb8888[first + count - 1];
+   uint32_t last565 = pal->rgb565[first + count - 1];
+   memmove(&pal->xrgb8888[first + 1], &pal->xrgb8888[first], (count - 1) * sizeof(uint32_t));
+   memmove(&pal->rgb565[first + 1], &pal->rgb565[first], (count - 1) * sizeof(uint32_t));
+   pal->xrgb8888[first] = last8888;
+   pal->rgb565[first] = last565;
+}
+
+// Scalar rows, unrolled so the independent loads overlap
+static void expand_row_565_c(const uint8_t *src, uint16_t *dst, const uint32_t *table, int count) {
+   int i = 0;
+   for (; i + 4 <= count; i += 4) {
+      uint16_t p0 = (uint16_t)table[src[i]], p1 = (uint16_t)table[src[i + 1]];
+      uint16_t p2 = (uint16_t)table[src[i + 2]], p3 = (uint16_t)table[src[i + 3]];
+      dst[i] = p0; dst[i + 1] = p1; dst[i + 2] = p2; dst[i + 3] = p3;
+   }
+   for (; i < count; i++)
+      dst[i] = (uint16_t)table[src[i]];
+}
+
+static void expand_row_8888_c(const uint8_t *src, uint32_t *dst, const uint32_t *table, int count) {
+   int i = 0;
+   for (; i + 4 <= count; i += 4) {
+      uint32_t p0 = table[src[i]], p1 = table[src[i + 1]];
+      uint32_t p2 = table[src[i + 2]], p3 = table[src[i + 3]];
+      dst[i] = p0; dst[i + 1] = p1; dst[i + 2] = p2; dst[i + 3] = p3;
+   }
+   for (; i < count; i++)
+      dst[i] = table[src[i]];
+}
+
+#ifdef HAVE_AVX2_KERNELS
+// AVX2: widen 8 indices to 32 bits and gather the entries in one go
+TARGET_AVX2 static void expand_row_565_avx2(const uint8_t *src, uint16_t *dst, const uint32_t *table, int count) {
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+      __m256i i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 8)));
+      __m256i p0 = _mm256_i32gather_epi32((const int *)table, i0, 4);
+      __m256i p1 = _mm256_i32gather_epi32((const int *)table, i1, 4);
+      // Entries fit in 16 bits, so the unsigned pack is exact; it works
+      // per 128-bit half, hence the permute back into pixel order
+      __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi32(p0, p1), 0xD8);
+      _mm256_storeu_si256((__m256i *)(dst + i), p);
+   }
+   expand_row_565_c(src + i, dst + i, table, count - i);
+}
+
+TARGET_AVX2 static void expand_row_8888_avx2(const uint8_t *src, uint32_t *dst, const uint32_t *table, int count) {
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+      __m256i i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 8)));
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_i32gather_epi32((const int *)table, i0, 4));
+      _mm256_storeu_si256((__m256i *)(dst + i + 8), _mm256_i32gather_epi32((const int *)table, i1, 4));
+   }
+   expand_row_8888_c(src + i, dst + i, table, count - i);
+}
+#endif // HAVE_AVX2_KERNELS
+
+void palette_expand_rgb565(const uint8_t *src, size_t src_pitch,
+                           uint16_t *dst, size_t dst_pitch,
+                           const struct palette *pal, int width, int height) {
+   void (*row)(const uint8_t *, uint16_t *, const uint32_t *, int) = expand_row_565_c;
+#ifdef HAVE_AVX2_KERNELS
+   if (cpu_features() & CPU_FEATURE_AVX2)
+      row = expand_row_565_avx2;
+#endif
+   for (int y = 0; y < height; y++)
+      row(src + y * src_pitch, (uint16_t *)((uint8_t *)dst + y * dst_pitch), pal->rgb565, width);
+}
+
+void palette_expand_xrgb8888(const uint8_t *src, size_t src_pitch,
+                             uint32_t *dst, size_t dst_pitch,
+                             const struct palette *pal, int width, int height) {
+   void (*row)(const uint8_t *, uint32_t *, const uint32_t *, int) = expand_row_8888_c;
+#ifdef HAVE_AVX2_KERNELS
+   if (cpu_features() & CPU_FEATURE_AVX2)
+      row = expand_row_8888_avx2;
+#endif
+   for (int y = 0; y < height; y++)
+      row(src + y * src_pitch, (uint32_t *)((uint8_t *)dst + y * dst_pitch), pal->xrgb8888, width);
+}
@@ -0,0 +1,247 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "path.h"
+#include "blend.h"
+
+// Most segments a single curve is flattened into
+#define PATH_MAX_CURVE_STEPS 256
+// Sub-scanlines sampled per pixel row; horizontal coverage is exact
+#define PATH_SUBSAMPLES 8
+
+void path_init(struct path *path) {
+   memset(path, 0, sizeof(*path));
+   path->tolerance = PATH_DEFAULT_TOLERANCE;
+}
+
+void path_free(struct path *path) {
+   free(path->segments);
+   path_init(path);
+}
+
+void path_reset(struct path *path) {
+   path->count = 0;
+   path->start_x = path->start_y = 0.0f;
+   path->x = path->y = 0.0f;
+}
+
+static bool push_segment(struct path *path, float x, float y) {
+   if (path->count == path->capacity) {
+      int grown = path->capacity ? path->capacity * 2 : 32;
+      struct path_segment *segments = realloc(path->segments, grown * sizeof(*segments));
+      if (!segments)
+         return false;
+      path->segments = segments;
+      path->capacity = grown;
+   }
+   struct path_segment *s = &path->segments[path->count++];
+   s->x0 = path->x;
+   s->y0 = path->y;
+   s->x1 = x;
+   s->y1 = y;
+   path->x = x;
+   path->y = y;
+   return true;
+}
+
+bool path_close(struct path *path) {
+   if (path->x == path->start_x && path->y == path->start_y)
+      return true;
+   return push_segment(path, path->start_x, path->start_y);
+}
+
+bool path_move_to(struct path *path, float x, float y) {
+   bool ok = path_close(path);
+   path->start_x = path->x = x;
+   path->start_y = path->y = y;
+   return ok;
+}
+
+bool path_line_to(struct path *path, float x, float y) {
+   return push_segment(path, x, y);
+}
+
+// Segments needed to keep a degree-n curve within tolerance, from Wang's
+// formula: sqrt(n(n-1)/8 * max |second difference| / tolerance)
+static int curve_steps(float factor, float dd, float tolerance) {
+   float steps = ceilf(sqrtf(factor * dd / tolerance));
+   if (!(steps >= 1.0f))
+      return 1;
+   return steps > PATH_MAX_CURVE_STEPS ? PATH_MAX_CURVE_STEPS : (int)steps;
+}
+
+bool path_quad_to(struct path *path, float cx, float cy, float x, float y) {
+   float x0 = path->x, y0 = path->y;
+   float ddx = x0 - 2.0f * cx + x, ddy = y0 - 2.0f * cy + y;
+   int steps = curve_steps(0.25f, sqrtf(ddx * ddx + ddy * ddy), path->tolerance);
+   for (int i = 1; i < steps; i++) {
+      float t = (float)i / steps, u = 1.0f - t;
+      if (!push_segment(path, u * u * x0 + 2.0f * u * t * cx + t * t * x,
+                        u * u * y0 + 2.0f * u * t * cy + t * t * y))
+         return false;
+   }
+   return push_segment(path, x, y);
+}
+
+bool path_cubic_to(struct path *path, float c1x, float c1y, float c2x, float c2y, float x, float y) {
+   float x0 = path->x, y0 = path->y;
+   float ax = x0 - 2.0f * c1x + c2x, ay = y0 - 2.0f * c1y + c2y;
+   float bx = c1x - 2.0f * c2x + x, by = c1y - 2.0f * c2y + y;
+   float dd = fmaxf(sqrtf(ax * ax + ay * ay), sqrtf(bx * bx + by * by));
+   int steps = curve_steps(0.75f, dd, path->tolerance);
+   for (int i = 1; i < steps; i++) {
+      float t = (float)i / steps, u = 1.0f - t;
+      float w0 = u * u * u, w1 = 3.0f * u * u * t, w2 = 3.0f * u * t * t, w3 = t * t * t;
+      if (!push_segment(path, w0 * x0 + w1 * c1x + w2 * c2x + w3 * x,
+                        w0 * y0 + w1 * c1y + w2 * c2y + w3 * y))
+         return false;
+   }
+   return push_segment(path, x, y);
+}
+
+struct fill_edge {
+   float y_top, y_bottom;   // y_top < y_bottom
+   float x_top, dxdy;
+   int winding;             // +1 for downward segments, -1 for upward
+};
+
+struct crossing {
+   float x;
+   int winding;
+};
+
+static int compare_edges(const void *a, const void *b) {
+   float ya = ((const struct fill_edge *)a)->y_top, yb = ((const struct fill_edge *)b)->y_top;
+   return (ya > yb) - (ya < yb);
+}
+
+static void add_edge(struct fill_edge *edges, int *count, float x0, float y0, float x1, float y1,
+                     const struct surface_rect *clip) {
+   int winding = 1;
+   if (y0 == y1)
+      return;
+   if (y0 > y1) {
+      float t = x0; x0 = x1; x1 = t;
+      t = y0; y0 = y1; y1 = t;
+      winding = -1;
+   }
+   if (y1 <= (float)clip->y0 || y0 >= (float)clip->y1)
+      return;
+   struct fill_edge *e = &edges[(*count)++];
+   e->y_top = y0;
+   e->y_bottom = y1;
+   e->x_top = x0;
+   e->dxdy = (x1 - x0) / (y1 - y0);
+   e->winding = winding;
+}
+
+// Accumulate weight over [a, b) of one sub-scanline, clipped to the
+// scissor columns. acc holds per-pixel coverage as differences, so each
+// span costs the same however long it is and the row is resolved with one
+// prefix sum.
+static void accumulate_span(float *acc, const struct surface_rect *clip, float a, float b,
+                            float weight, int *min_x, int *max_x) {
+   if (a < (float)clip->x0) a = (float)clip->x0;
+   if (b > (float)clip->x1) b = (float)clip->x1;
+   if (a >= b)
+      return;
+   int ia = (int)a, ib = (int)b;
+   if (*min_x > ia) *min_x = ia;
+   if (*max_x < ib) *max_x = ib;
+   if (ia == ib) {
+      float c = (b - a) * weight;
+      acc[ia] += c;
+      acc[ia + 1] -= c;
+      return;
+   }
+   float head = (ia + 1 - a) * weight, tail = (b - ib) * weight;
+   acc[ia] += head;
+   acc[ia + 1] += weight - head;
+   acc[ib] += tail - weight;
+   acc[ib + 1] -= tail;
+}
+
+void path_fill(const struct surface *dst, const struct path *path, enum path_fill_rule rule,
+               uint16_t color) {
+   // acc and coverage are indexed by column, up to the scissor's right edge
+   const struct surface_rect *clip = &dst->clip;
+   int fb_width = clip->x1;
+   // Every subpath is closed; only the last one can still be open
+   int edge_max = path->count + 1;
+   size_t bytes = edge_max * (sizeof(struct fill_edge) + sizeof(struct fill_edge *) + sizeof(struct crossing))
+                + (fb_width + 2) * sizeof(float) + fb_width;
+   char *scratch = malloc(bytes);
+   if (!scratch)
+      return;
+   struct fill_edge **active = (struct fill_edge **)scratch;
+   struct fill_edge *edges = (struct fill_edge *)(active + edge_max);
+   struct crossing *crossings = (struct crossing *)(edges + edge_max);
+   float *acc = (float *)(crossings + edge_max);
+   uint8_t *coverage = (uint8_t *)(acc + fb_width + 2);
+   memset(acc, 0, (fb_width + 2) * sizeof(float));
+
+   int edge_count = 0;
+   for (int i = 0; i < path->count; i++) {
+      const struct path_segment *s = &path->segments[i];
+      add_edge(edges, &edge_count, s->x0, s->y0, s->x1, s->y1, clip);
+   }
+   add_edge(edges, &edge_count, path->x, path->y, path->start_x, path->start_y, clip);
+   qsort(edges, edge_count, sizeof(*edges), compare_edges);
+
+   const float weight = 1.0f / PATH_SUBSAMPLES;
+   int next = 0, active_count = 0;
+   int y = edge_count ? (int)floorf(edges[0].y_top) : clip->y1;
+   if (y < clip->y0) y = clip->y0;
+   for (; y < clip->y1 && (next < edge_count || active_count); y++) {
+      if (!active_count && (int)floorf(edges[next].y_top) > y)
+         y = (int)floorf(edges[next].y_top); // Skip rows between disjoint parts
+      int kept = 0;
+      for (int i = 0; i < active_count; i++)
+         if (active[i]->y_bottom > y)
+            active[kept++] = active[i];
+      active_count = kept;
+      while (next < edge_count && edges[next].y_top < y + 1)
+         active[active_count++] = &edges[next++];
+
+      int min_x = fb_width, max_x = -1;
+      for (int s = 0; s < PATH_SUBSAMPLES; s++) {
+         float sy = y + (s + 0.5f) * weight;
+         // Crossings of this sub-scanline, kept sorted by insertion
+         int n = 0;
+         for (int i = 0; i < active_count; i++) {
+            const struct fill_edge *e = active[i];
+            if (sy < e->y_top || sy >= e->y_bottom)
+               continue;
+            float x = e->x_top + (sy - e->y_top) * e->dxdy;
+            int j = n++;
+            for (; j > 0 && crossings[j - 1].x > x; j--)
+               crossings[j] = crossings[j - 1];
+            crossings[j].x = x;
+            crossings[j].winding = e->winding;
+         }
+         int winding = 0;
+         for (int i = 0; i + 1 < n; i++) {
+            winding += crossings[i].winding;
+            bool inside = rule == PATH_FILL_EVEN_ODD ? (winding & 1) : winding != 0;
+            if (inside)
+               accumulate_span(acc, clip, crossings[i].x, crossings[i + 1].x, weight,
+                               &min_x, &max_x);
+         }
+      }
+      if (max_x < 0)
+         continue;
+
+      // Resolve the touched range, clearing it for the next row. Spans
+      // ending on the right edge touch one entry past the last pixel.
+      float sum = 0.0f;
+      for (int x = min_x; x <= max_x + 1; x++) {
+         sum += acc[x];
+         acc[x] = 0.0f;
+         if (x < fb_width)
+            coverage[x] = sum <= 0.0f ? 0 : sum >= 1.0f ? 255 : (uint8_t)(sum * 255.0f + 0.5f);
+      }
+      int end = max_x < fb_width ? max_x : fb_width - 1;
+      blend565_coverage_span(surface_row(dst, y) + min_x, coverage + min_x, color, end - min_x + 1);
+   }
+   free(scratch);
+}
@@ -0,0 +1,407 @@
+#include <string.h>
+#include "pixconv.h"
+#include "core_log.h"
+#include "cpu.h"
+#include "simd.h"
+
+#ifdef HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+// Convert count pixels of one row; y selects the dither matrix row
+typedef void (*pixconv_row_fn)(const void *src, void *dst, int count, int y);
+
+// 4x4 Bayer matrix, thresholds 0-15
+static const uint8_t bayer4[4][4] = {
+   {  0,  8,  2, 10 },
+   { 12,  4, 14,  6 },
+   {  3, 11,  1,  9 },
+   { 15,  7, 13,  5 },
+};
+
+// Kernels indexed by [source format][destination format]
+static pixconv_row_fn kernels[3][3];
+static bool kernels_ready;
+
+static inline uint32_t expand5(uint32_t v) { return (v << 3) | (v >> 2); }
+static inline uint32_t expand6(uint32_t v) { return (v << 2) | (v >> 4); }
+
+// Drop shift bits with an ordered-dither threshold t in [0, 1 << shift),
+// leaving bits bits. Subtracting v >> bits rescales the input so that the
+// result never overflows and values that came from a bit-replicating
+// expansion convert back exactly.
+static inline uint32_t dither(uint32_t v, uint32_t t, int shift, int bits) {
+   return (v - (v >> bits) + t) >> shift;
+}
+
+// Scalar kernels; also used for the tails of the SIMD loops
+
+static void rgb565_to_xrgb8888_c(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   (void)y;
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      dst[i] = (expand5(p >> 11) << 16) | (expand6((p >> 5) & 63) << 8) | expand5(p & 31);
+   }
+}
+
+static void rgb565_to_0rgb1555_c(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint16_t *dst = dst_;
+   const uint8_t *t = bayer4[y & 3];
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      uint32_t g = dither((p >> 5) & 63, t[i & 3] >> 3, 1, 5);
+      dst[i] = (uint16_t)(((p >> 11) << 10) | (g << 5) | (p & 31));
+   }
+}
+
+static void xrgb8888_to_rgb565_c(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const uint8_t *t = bayer4[y & 3];
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      uint32_t t5 = t[i & 3] >> 1, t6 = t[i & 3] >> 2;
+      uint32_t r = dither((p >> 16) & 0xFF, t5, 3, 5);
+      uint32_t g = dither((p >> 8) & 0xFF, t6, 2, 6);
+      uint32_t b = dither(p & 0xFF, t5, 3, 5);
+      dst[i] = (uint16_t)((r << 11) | (g << 5) | b);
+   }
+}
+
+static void xrgb8888_to_0rgb1555_c(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const uint8_t *t = bayer4[y & 3];
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      uint32_t t5 = t[i & 3] >> 1;
+      uint32_t r = dither((p >> 16) & 0xFF, t5, 3, 5);
+      uint32_t g = dither((p >> 8) & 0xFF, t5, 3, 5);
+      uint32_t b = dither(p & 0xFF, t5, 3, 5);
+      dst[i] = (uint16_t)((r << 10) | (g << 5) | b);
+   }
+}
+
+static void rgb1555_to_rgb565_c(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint16_t *dst = dst_;
+   (void)y;
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      uint32_t g = (p >> 5) & 31;
+      dst[i] = (uint16_t)((((p >> 10) & 31) << 11) | (((g << 1) | (g >> 4)) << 5) | (p & 31));
+   }
+}
+
+static void rgb1555_to_xrgb8888_c(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   (void)y;
+   for (int i = 0; i < count; i++) {
+      uint32_t p = src[i];
+      dst[i] = (expand5((p >> 10) & 31) << 16) | (expand5((p >> 5) & 31) << 8) | expand5(p & 31);
+   }
+}
+
+#ifdef HAVE_SSE2
+// Dither thresholds of row y for 8 consecutive 16-bit lanes starting at x = 0
+static __m128i dither_row_sse2(int y) {
+   const uint8_t *t = bayer4[y & 3];
+   return _mm_setr_epi16(t[0], t[1], t[2], t[3], t[0], t[1], t[2], t[3]);
+}
+
+// Widen 5/6-bit channels in 16-bit lanes to 8 bits and interleave to XRGB
+static inline void store_xrgb8888_sse2(uint32_t *dst, __m128i r5, __m128i g, __m128i b5, bool g6) {
+   __m128i r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+   __m128i b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+   g = g6 ? _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4))
+          : _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+   __m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+   _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(gb, r));
+   _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(gb, r));
+}
+
+static void rgb565_to_xrgb8888_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   const __m128i mask5 = _mm_set1_epi16(31);
+   const __m128i mask6 = _mm_set1_epi16(63);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+      store_xrgb8888_sse2(dst + i, _mm_srli_epi16(p, 11),
+                          _mm_and_si128(_mm_srli_epi16(p, 5), mask6),
+                          _mm_and_si128(p, mask5), true);
+   }
+   rgb565_to_xrgb8888_c(src + i, dst + i, count - i, y);
+}
+
+static void rgb1555_to_xrgb8888_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   const __m128i mask5 = _mm_set1_epi16(31);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+      store_xrgb8888_sse2(dst + i, _mm_and_si128(_mm_srli_epi16(p, 10), mask5),
+                          _mm_and_si128(_mm_srli_epi16(p, 5), mask5),
+                          _mm_and_si128(p, mask5), false);
+   }
+   rgb1555_to_xrgb8888_c(src + i, dst + i, count - i, y);
+}
+
+static void rgb565_to_0rgb1555_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m128i mask5 = _mm_set1_epi16(31);
+   const __m128i mask6 = _mm_set1_epi16(63);
+   const __m128i t1 = _mm_srli_epi16(dither_row_sse2(y), 3);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i r = _mm_srli_epi16(p, 11);
+      __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+      __m128i b = _mm_and_si128(p, mask5);
+      g = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(g, _mm_srli_epi16(g, 5)), t1), 1);
+      p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10), _mm_slli_epi16(g, 5)), b);
+      _mm_storeu_si128((__m128i *)(dst + i), p);
+   }
+   rgb565_to_0rgb1555_c(src + i, dst + i, count - i, y);
+}
+
+static void rgb1555_to_rgb565_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m128i mask5 = _mm_set1_epi16(31);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i r = _mm_and_si128(_mm_srli_epi16(p, 10), mask5);
+      __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask5);
+      __m128i b = _mm_and_si128(p, mask5);
+      g = _mm_or_si128(_mm_slli_epi16(g, 1), _mm_srli_epi16(g, 4));
+      p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+      _mm_storeu_si128((__m128i *)(dst + i), p);
+   }
+   rgb1555_to_rgb565_c(src + i, dst + i, count - i, y);
+}
+
+// Split 8 XRGB8888 pixels into 16-bit r, g, b lanes
+static inline void load_xrgb8888_sse2(const uint32_t *src, __m128i *r, __m128i *g, __m128i *b) {
+   const __m128i mask8 = _mm_set1_epi32(0xFF);
+   __m128i p0 = _mm_loadu_si128((const __m128i *)src);
+   __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 4));
+   *r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask8),
+                        _mm_and_si128(_mm_srli_epi32(p1, 16), mask8));
+   *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask8),
+                        _mm_and_si128(_mm_srli_epi32(p1, 8), mask8));
+   *b = _mm_packs_epi32(_mm_and_si128(p0, mask8), _mm_and_si128(p1, mask8));
+}
+
+static void xrgb8888_to_rgb565_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m128i t = dither_row_sse2(y);
+   const __m128i t5 = _mm_srli_epi16(t, 1);
+   const __m128i t6 = _mm_srli_epi16(t, 2);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i r, g, b;
+      load_xrgb8888_sse2(src + i, &r, &g, &b);
+      r = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(r, _mm_srli_epi16(r, 5)), t5), 3);
+      g = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(g, _mm_srli_epi16(g, 6)), t6), 2);
+      b = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(b, _mm_srli_epi16(b, 5)), t5), 3);
+      __m128i p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+      _mm_storeu_si128((__m128i *)(dst + i), p);
+   }
+   xrgb8888_to_rgb565_c(src + i, dst + i, count - i, y);
+}
+
+static void xrgb8888_to_0rgb1555_sse2(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m128i t5 = _mm_srli_epi16(dither_row_sse2(y), 1);
+   int i = 0;
+   for (; i + 8 <= count; i += 8) {
+      __m128i r, g, b;
+      load_xrgb8888_sse2(src + i, &r, &g, &b);
+      r = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(r, _mm_srli_epi16(r, 5)), t5), 3);
+      g = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(g, _mm_srli_epi16(g, 5)), t5), 3);
+      b = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(b, _mm_srli_epi16(b, 5)), t5), 3);
+      __m128i p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10), _mm_slli_epi16(g, 5)), b);
+      _mm_storeu_si128((__m128i *)(dst + i), p);
+   }
+   xrgb8888_to_0rgb1555_c(src + i, dst + i, count - i, y);
+}
+#endif // HAVE_SSE2
+
+#ifdef HAVE_AVX2_KERNELS
+// AVX2 variants of the kernels that touch 32-bit pixels, 16 pixels a step.
+// 256-bit pack/unpack work per 128-bit half, hence the cross-lane permutes.
+
+TARGET_AVX2 static __m256i dither_row_avx2(int y) {
+   const uint8_t *t = bayer4[y & 3];
+   return _mm256_setr_epi16(t[0], t[1], t[2], t[3], t[0], t[1], t[2], t[3],
+                            t[0], t[1], t[2], t[3], t[0], t[1], t[2], t[3]);
+}
+
+TARGET_AVX2 static void store_xrgb8888_avx2(uint32_t *dst, __m256i r5, __m256i g, __m256i b5, bool g6) {
+   __m256i r = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+   __m256i b = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
+   g = g6 ? _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4))
+          : _mm256_or_si256(_mm256_slli_epi16(g, 3), _mm256_srli_epi16(g, 2));
+   __m256i gb = _mm256_or_si256(_mm256_slli_epi16(g, 8), b);
+   __m256i lo = _mm256_unpacklo_epi16(gb, r); // Pixels 0-3, 8-11
+   __m256i hi = _mm256_unpackhi_epi16(gb, r); // Pixels 4-7, 12-15
+   _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+   _mm256_storeu_si256((__m256i *)(dst + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+TARGET_AVX2 static void rgb565_to_xrgb8888_avx2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   const __m256i mask5 = _mm256_set1_epi16(31);
+   const __m256i mask6 = _mm256_set1_epi16(63);
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i p = _mm256_loadu_si256((const __m256i *)(src + i));
+      store_xrgb8888_avx2(dst + i, _mm256_srli_epi16(p, 11),
+                          _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6),
+                          _mm256_and_si256(p, mask5), true);
+   }
+   rgb565_to_xrgb8888_c(src + i, dst + i, count - i, y);
+}
+
+TARGET_AVX2 static void rgb1555_to_xrgb8888_avx2(const void *src_, void *dst_, int count, int y) {
+   const uint16_t *src = src_;
+   uint32_t *dst = dst_;
+   const __m256i mask5 = _mm256_set1_epi16(31);
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i p = _mm256_loadu_si256((const __m256i *)(src + i));
+      store_xrgb8888_avx2(dst + i, _mm256_and_si256(_mm256_srli_epi16(p, 10), mask5),
+                          _mm256_and_si256(_mm256_srli_epi16(p, 5), mask5),
+                          _mm256_and_si256(p, mask5), false);
+   }
+   rgb1555_to_xrgb8888_c(src + i, dst + i, count - i, y);
+}
+
+// Split 16 XRGB8888 pixels into 16-bit r, g, b lanes. The packs leave the
+// quads in 0-3, 8-11, 4-7, 12-15 order; dithering only depends on x & 3,
+// so callers fix the order once on the packed result.
+TARGET_AVX2 static void load_xrgb8888_avx2(const uint32_t *src, __m256i *r, __m256i *g, __m256i *b) {
+   const __m256i mask8 = _mm256_set1_epi32(0xFF);
+   __m256i p0 = _mm256_loadu_si256((const __m256i *)src);
+   __m256i p1 = _mm256_loadu_si256((const __m256i *)(src + 8));
+   *r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask8),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask8));
+   *g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask8),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask8));
+   *b = _mm256_packs_epi32(_mm256_and_si256(p0, mask8), _mm256_and_si256(p1, mask8));
+}
+
+TARGET_AVX2 static void xrgb8888_to_rgb565_avx2(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m256i t = dither_row_avx2(y);
+   const __m256i t5 = _mm256_srli_epi16(t, 1);
+   const __m256i t6 = _mm256_srli_epi16(t, 2);
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i r, g, b;
+      load_xrgb8888_avx2(src + i, &r, &g, &b);
+      r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(r, _mm256_srli_epi16(r, 5)), t5), 3);
+      g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(g, _mm256_srli_epi16(g, 6)), t6), 2);
+      b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(b, _mm256_srli_epi16(b, 5)), t5), 3);
+      __m256i p = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), b);
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(p, 0xD8));
+   }
+   xrgb8888_to_rgb565_c(src + i, dst + i, count - i, y);
+}
+
+TARGET_AVX2 static void xrgb8888_to_0rgb1555_avx2(const void *src_, void *dst_, int count, int y) {
+   const uint32_t *src = src_;
+   uint16_t *dst = dst_;
+   const __m256i t5 = _mm256_srli_epi16(dither_row_avx2(y), 1);
+   int i = 0;
+   for (; i + 16 <= count; i += 16) {
+      __m256i r, g, b;
+      load_xrgb8888_avx2(src + i, &r, &g, &b);
+      r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(r, _mm256_srli_epi16(r, 5)), t5), 3);
+      g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(g, _mm256_srli_epi16(g, 5)), t5), 3);
+      b = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(b, _mm256_srli_epi16(b, 5)), t5), 3);
+      __m256i p = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 10), _mm256_slli_epi16(g, 5)), b);
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(p, 0xD8));
+   }
+   xrgb8888_to_0rgb1555_c(src + i, dst + i, count - i, y);
+}
+#endif // HAVE_AVX2_KERNELS
+
+void pixconv_init(void) {
+   if (kernels_ready)
+      return;
+   const char *impl = "scalar";
+   kernels[RETRO_PIXEL_FORMAT_RGB565][RETRO_PIXEL_FORMAT_XRGB8888] = rgb565_to_xrgb8888_c;
+   kernels[RETRO_PIXEL_FORMAT_RGB565][RETRO_PIXEL_FORMAT_0RGB1555] = rgb565_to_0rgb1555_c;
+   kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_RGB565] = xrgb8888_to_rgb565_c;
+   kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_0RGB1555] = xrgb8888_to_0rgb1555_c;
+   kernels[RETRO_PIXEL_FORMAT_0RGB1555][RETRO_PIXEL_FORMAT_RGB565] = rgb1555_to_rgb565_c;
+   kernels[RETRO_PIXEL_FORMAT_0RGB1555][RETRO_PIXEL_FORMAT_XRGB8888] = rgb1555_to_xrgb8888_c;
+#ifdef HAVE_SSE2
+   if (cpu_features() & CPU_FEATURE_SSE2) {
+      impl = "SSE2";
+      kernels[RETRO_PIXEL_FORMAT_RGB565][RETRO_PIXEL_FORMAT_XRGB8888] = rgb565_to_xrgb8888_sse2;
+      kernels[RETRO_PIXEL_FORMAT_RGB565][RETRO_PIXEL_FORMAT_0RGB1555] = rgb565_to_0rgb1555_sse2;
+      kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_RGB565] = xrgb8888_to_rgb565_sse2;
+      kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_0RGB1555] = xrgb8888_to_0rgb1555_sse2;
+      kernels[RETRO_PIXEL_FORMAT_0RGB1555][RETRO_PIXEL_FORMAT_RGB565] = rgb1555_to_rgb565_sse2;
+      kernels[RETRO_PIXEL_FORMAT_0RGB1555][RETRO_PIXEL_FORMAT_XRGB8888] = rgb1555_to_xrgb8888_sse2;
+   }
+#endif
+#ifdef HAVE_AVX2_KERNELS
+   if (cpu_features() & CPU_FEATURE_AVX2) {
+      impl = "AVX2";
+      kernels[RETRO_PIXEL_FORMAT_RGB565][RETRO_PIXEL_FORMAT_XRGB8888] = rgb565_to_xrgb8888_avx2;
+      kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_RGB565] = xrgb8888_to_rgb565_avx2;
+      kernels[RETRO_PIXEL_FORMAT_XRGB8888][RETRO_PIXEL_FORMAT_0RGB1555] = xrgb8888_to_0rgb1555_avx2;
+      kernels[RETRO_PIXEL_FORMAT_0RGB1555][RETRO_PIXEL_FORMAT_XRGB8888] = rgb1555_to_xrgb8888_avx2;
+   }
+#endif
+   kernels_ready = true;
+   core_log(RETRO_LOG_INFO, "Pixel conversion kernels: %s\n", impl);
+}
+
+size_t pixconv_bytes_per_pixel(enum retro_pixel_format format) {
+   return format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+}
+
+const char *pixconv_format_name(enum retro_pixel_format format) {
+   switch (format) {
+      case RETRO_PIXEL_FORMAT_0RGB1555: return "0RGB1555";
+      case RETRO_PIXEL_FORMAT_XRGB8888: return "XRGB8888";
+      case RETRO_PIXEL_FORMAT_RGB565:   return "RGB565";
+      default:                          return "unknown";
+   }
+}
+
+void pixconv_convert(const void *src, size_t src_pitch, enum retro_pixel_format src_format,
+                     void *dst, size_t dst_pitch, enum retro_pixel_format dst_format,
+                     int width, int height) {
+   const uint8_t *s = src;
+   uint8_t *d = dst;
+   if ((unsigned)src_format > RETRO_PIXEL_FORMAT_RGB565 || (unsigned)dst_format > RETRO_PIXEL_FORMAT_RGB565)
+      return;
+   if (src_format == dst_format) {
+      size_t row_bytes = (size_t)width * pixconv_bytes_per_pixel(src_format);
+      for (int y = 0; y < height; y++)
+         memcpy(d + y * dst_pitch, s + y * src_pitch, row_bytes);
+      return;
+   }
+   pixconv_init();
+   pixconv_row_fn kernel = kernels[src_format][dst_format];
+   for (int y = 0; y < height; y++)
+      kernel(s + y * src_pitch, d + y * dst_pitch, width, y);
+}
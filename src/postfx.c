@@ -0,0 +1,375 @@
+#include <stdlib.h>
+#include <string.h>
+#include "postfx.h"
+#include "blend.h"
+#include "simd.h"
+#include "workers.h"
+
+#define SCANLINE_LEVEL 160 // Brightness of darkened rows, out of 256
+#define MASK_LEVEL     176 // Brightness of the two dimmed channels per column
+
+// Per-column channel multipliers (out of 256) for normal and darkened rows,
+// rebuilt only when the output width or the effects change
+static uint16_t factors[2][3][POSTFX_MAX_WIDTH];
+static int factors_width = -1;
+static bool factors_scanlines, factors_mask;
+
+// Intermediate 2x image between the two passes of a 4x filter
+static uint16_t *scratch;
+static size_t scratch_pixels;
+
+struct postfx_job {
+   const uint16_t *src;
+   size_t src_pitch;
+   int width;
+   int height;
+   uint16_t *dst;
+   size_t dst_pitch;
+   struct postfx_config cfg;
+};
+
+bool postfx_active(const struct postfx_config *cfg) {
+   return cfg->scale > 1 || cfg->scanlines || cfg->mask;
+}
+
+static void build_factors(int width, const struct postfx_config *cfg) {
+   if (factors_width == width && factors_scanlines == cfg->scanlines && factors_mask == cfg->mask)
+      return;
+   for (int dark = 0; dark < 2; dark++) {
+      int row_level = dark && cfg->scanlines ? SCANLINE_LEVEL : 256;
+      for (int c = 0; c < 3; c++) {
+         for (int x = 0; x < width; x++) {
+            int level = cfg->mask && x % 3 != c ? MASK_LEVEL : 256;
+            factors[dark][c][x] = (uint16_t)(level * row_level >> 8);
+         }
+      }
+   }
+   factors_width = width;
+   factors_scanlines = cfg->scanlines;
+   factors_mask = cfg->mask;
+}
+
+// Repeat every pixel scale times
+static void scale_row(const uint16_t *src, uint16_t *dst, int width, int scale) {
+   int x = 0;
+#ifdef HAVE_SSE2
+   if (scale == 2 || scale == 4) {
+      for (; x + 8 <= width; x += 8) {
+         __m128i p = _mm_loadu_si128((const __m128i *)(src + x));
+         __m128i lo = _mm_unpacklo_epi16(p, p);
+         __m128i hi = _mm_unpackhi_epi16(p, p);
+         uint16_t *out = dst + x * scale;
+         if (scale == 2) {
+            _mm_storeu_si128((__m128i *)out, lo);
+            _mm_storeu_si128((__m128i *)(out + 8), hi);
+         } else {
+            _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi32(lo, lo));
+            _mm_storeu_si128((__m128i *)(out + 8), _mm_unpackhi_epi32(lo, lo));
+            _mm_storeu_si128((__m128i *)(out + 16), _mm_unpacklo_epi32(hi, hi));
+            _mm_storeu_si128((__m128i *)(out + 24), _mm_unpackhi_epi32(hi, hi));
+         }
+      }
+   }
+#endif
+   for (; x < width; x++)
+      for (int i = 0; i < scale; i++)
+         dst[x * scale + i] = src[x];
+}
+
+// Multiply each channel by its per-column factor
+static void shade_row(const uint16_t *src, uint16_t *dst, uint16_t (*f)[POSTFX_MAX_WIDTH], int count) {
+   int x = 0;
+#ifdef HAVE_SSE2
+   const __m128i mask5 = _mm_set1_epi16(31);
+   const __m128i mask6 = _mm_set1_epi16(63);
+   for (; x + 8 <= count; x += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)(src + x));
+      __m128i r = _mm_srli_epi16(p, 11);
+      __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+      __m128i b = _mm_and_si128(p, mask5);
+      r = _mm_srli_epi16(_mm_mullo_epi16(r, _mm_loadu_si128((const __m128i *)(f[0] + x))), 8);
+      g = _mm_srli_epi16(_mm_mullo_epi16(g, _mm_loadu_si128((const __m128i *)(f[1] + x))), 8);
+      b = _mm_srli_epi16(_mm_mullo_epi16(b, _mm_loadu_si128((const __m128i *)(f[2] + x))), 8);
+      p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+      _mm_storeu_si128((__m128i *)(dst + x), p);
+   }
+#endif
+   for (; x < count; x++) {
+      unsigned p = src[x];
+      unsigned r = (p >> 11) * f[0][x] >> 8;
+      unsigned g = ((p >> 5) & 63) * f[1][x] >> 8;
+      unsigned b = (p & 31) * f[2][x] >> 8;
+      dst[x] = (uint16_t)((r << 11) | (g << 5) | b);
+   }
+}
+
+// Worker body: source rows [begin, end) into scale output rows each
+static void postfx_rows(void *ctx, int begin, int end) {
+   const struct postfx_job *job = ctx;
+   int scale = job->cfg.scale;
+   int out_width = job->width * scale;
+   uint16_t row[POSTFX_MAX_WIDTH];
+
+   for (int y = begin; y < end; y++) {
+      const uint16_t *src = (const uint16_t *)((const uint8_t *)job->src + y * job->src_pitch);
+      const uint16_t *scaled = src;
+      if (scale > 1) {
+         scale_row(src, row, job->width, scale);
+         scaled = row;
+      }
+      for (int s = 0; s < scale; s++) {
+         int out_y = y * scale + s;
+         uint16_t *dst = (uint16_t *)((uint8_t *)job->dst + out_y * job->dst_pitch);
+         bool dark = job->cfg.scanlines && (scale == 1 ? (y & 1) : s == scale - 1);
+         if (dark || job->cfg.mask)
+            shade_row(scaled, dst, factors[dark], out_width);
+         else
+            memcpy(dst, scaled, out_width * sizeof(uint16_t));
+      }
+   }
+}
+
+// Pixel-art filters. Both read the 3x3 neighbourhood
+//    A B C
+//    D E F
+//    G H I
+// of each source pixel E and write its 2x2 block; image edges repeat.
+
+// Colour distance with red and blue widened to green's 6 bits
+static inline int dist565(uint16_t a, uint16_t b) {
+   int dr = (a >> 11) - (b >> 11);
+   int dg = ((a >> 5) & 63) - ((b >> 5) & 63);
+   int db = (a & 31) - (b & 31);
+   return 2 * abs(dr) + abs(dg) + 2 * abs(db);
+}
+
+static void scale2x_pixel(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                          int x, int left, int right, uint16_t *out0, uint16_t *out1) {
+   uint16_t B = up[x], D = mid[left], E = mid[x], F = mid[right], H = down[x];
+   out0[2 * x]     = D == B && D != H && B != F ? B : E;
+   out0[2 * x + 1] = B == F && B != D && F != H ? F : E;
+   out1[2 * x]     = D == H && D != F && H != B ? D : E;
+   out1[2 * x + 1] = F == H && F != B && H != D ? H : E;
+}
+
+// xBR-lite corner rule: blend towards the closer side neighbour when the
+// edge across the corner is weaker than the edge along it
+static void xbr_pixel(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                      int x, int left, int right, uint16_t *out0, uint16_t *out1) {
+   uint16_t A = up[left], B = up[x], C = up[right];
+   uint16_t D = mid[left], E = mid[x], F = mid[right];
+   uint16_t G = down[left], H = down[x], I = down[right];
+   int eA = dist565(E, A), eC = dist565(E, C), eG = dist565(E, G), eI = dist565(E, I);
+   int bd = dist565(B, D), bf = dist565(B, F), dh = dist565(D, H), fh = dist565(F, H);
+   int eB = dist565(E, B), eD = dist565(E, D), eF = dist565(E, F), eH = dist565(E, H);
+
+   out0[2 * x] = E;
+   out0[2 * x + 1] = E;
+   out1[2 * x] = E;
+   out1[2 * x + 1] = E;
+   if (eC + eG + 4 * bd < bf + dh + 4 * eA)
+      out0[2 * x] = blend565_half(E, eB <= eD ? B : D);
+   if (eA + eI + 4 * bf < bd + fh + 4 * eC)
+      out0[2 * x + 1] = blend565_half(E, eB <= eF ? B : F);
+   if (eA + eI + 4 * dh < fh + bd + 4 * eG)
+      out1[2 * x] = blend565_half(E, eD <= eH ? D : H);
+   if (eC + eG + 4 * fh < dh + bf + 4 * eI)
+      out1[2 * x + 1] = blend565_half(E, eF <= eH ? F : H);
+}
+
+#ifdef HAVE_SSE2
+static inline __m128i select_epi16(__m128i mask, __m128i a, __m128i b) {
+   return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline void store_blocks(uint16_t *out0, uint16_t *out1,
+                                __m128i tl, __m128i tr, __m128i bl, __m128i br) {
+   _mm_storeu_si128((__m128i *)out0, _mm_unpacklo_epi16(tl, tr));
+   _mm_storeu_si128((__m128i *)(out0 + 8), _mm_unpackhi_epi16(tl, tr));
+   _mm_storeu_si128((__m128i *)out1, _mm_unpacklo_epi16(bl, br));
+   _mm_storeu_si128((__m128i *)(out1 + 8), _mm_unpackhi_epi16(bl, br));
+}
+
+// 8 pixels starting at x; needs x >= 1 and x + 9 <= width
+static void scale2x_block_sse2(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                               int x, uint16_t *out0, uint16_t *out1) {
+   __m128i B = _mm_loadu_si128((const __m128i *)(up + x));
+   __m128i D = _mm_loadu_si128((const __m128i *)(mid + x - 1));
+   __m128i E = _mm_loadu_si128((const __m128i *)(mid + x));
+   __m128i F = _mm_loadu_si128((const __m128i *)(mid + x + 1));
+   __m128i H = _mm_loadu_si128((const __m128i *)(down + x));
+   __m128i bd = _mm_cmpeq_epi16(B, D), bf = _mm_cmpeq_epi16(B, F);
+   __m128i dh = _mm_cmpeq_epi16(D, H), fh = _mm_cmpeq_epi16(F, H);
+   // X == Y && X != Z && Y != W, with the equalities already computed
+   __m128i tl = _mm_andnot_si128(_mm_or_si128(dh, bf), bd);
+   __m128i tr = _mm_andnot_si128(_mm_or_si128(bd, fh), bf);
+   __m128i bl = _mm_andnot_si128(_mm_or_si128(fh, bd), dh);
+   __m128i br = _mm_andnot_si128(_mm_or_si128(bf, dh), fh);
+   store_blocks(out0 + 2 * x, out1 + 2 * x,
+                select_epi16(tl, B, E), select_epi16(tr, F, E),
+                select_epi16(bl, D, E), select_epi16(br, H, E));
+}
+
+struct rgb16 {
+   __m128i r, g, b;
+};
+
+static inline struct rgb16 unpack565(__m128i p) {
+   struct rgb16 c;
+   c.r = _mm_srli_epi16(p, 11);
+   c.g = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(63));
+   c.b = _mm_and_si128(p, _mm_set1_epi16(31));
+   return c;
+}
+
+static inline __m128i absdiff_epi16(__m128i a, __m128i b) {
+   return _mm_sub_epi16(_mm_max_epi16(a, b), _mm_min_epi16(a, b));
+}
+
+static inline __m128i dist565_sse2(struct rgb16 a, struct rgb16 b) {
+   __m128i rb = _mm_add_epi16(absdiff_epi16(a.r, b.r), absdiff_epi16(a.b, b.b));
+   return _mm_add_epi16(_mm_add_epi16(rb, rb), absdiff_epi16(a.g, b.g));
+}
+
+// Corner output: mix towards p or q (whichever is closer to E) where the
+// edge test passes, else E
+static inline __m128i xbr_corner(__m128i E, __m128i across, __m128i along,
+                                 __m128i dp, __m128i dq, __m128i p, __m128i q) {
+   __m128i target = select_epi16(_mm_cmpgt_epi16(dp, dq), q, p);
+   return select_epi16(_mm_cmplt_epi16(across, along), blend565_half_sse2(E, target), E);
+}
+
+static void xbr_block_sse2(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                           int x, uint16_t *out0, uint16_t *out1) {
+   __m128i pA = _mm_loadu_si128((const __m128i *)(up + x - 1));
+   __m128i pB = _mm_loadu_si128((const __m128i *)(up + x));
+   __m128i pC = _mm_loadu_si128((const __m128i *)(up + x + 1));
+   __m128i pD = _mm_loadu_si128((const __m128i *)(mid + x - 1));
+   __m128i pE = _mm_loadu_si128((const __m128i *)(mid + x));
+   __m128i pF = _mm_loadu_si128((const __m128i *)(mid + x + 1));
+   __m128i pG = _mm_loadu_si128((const __m128i *)(down + x - 1));
+   __m128i pH = _mm_loadu_si128((const __m128i *)(down + x));
+   __m128i pI = _mm_loadu_si128((const __m128i *)(down + x + 1));
+   struct rgb16 A = unpack565(pA), B = unpack565(pB), C = unpack565(pC);
+   struct rgb16 D = unpack565(pD), E = unpack565(pE), F = unpack565(pF);
+   struct rgb16 G = unpack565(pG), H = unpack565(pH), I = unpack565(pI);
+   __m128i eA = dist565_sse2(E, A), eC = dist565_sse2(E, C);
+   __m128i eG = dist565_sse2(E, G), eI = dist565_sse2(E, I);
+   __m128i bd = dist565_sse2(B, D), bf = dist565_sse2(B, F);
+   __m128i dh = dist565_sse2(D, H), fh = dist565_sse2(F, H);
+   __m128i eB = dist565_sse2(E, B), eD = dist565_sse2(E, D);
+   __m128i eF = dist565_sse2(E, F), eH = dist565_sse2(E, H);
+   __m128i cg = _mm_add_epi16(eC, eG), ai = _mm_add_epi16(eA, eI);
+
+   __m128i tl = xbr_corner(pE, _mm_add_epi16(cg, _mm_slli_epi16(bd, 2)),
+                           _mm_add_epi16(_mm_add_epi16(bf, dh), _mm_slli_epi16(eA, 2)), eB, eD, pB, pD);
+   __m128i tr = xbr_corner(pE, _mm_add_epi16(ai, _mm_slli_epi16(bf, 2)),
+                           _mm_add_epi16(_mm_add_epi16(bd, fh), _mm_slli_epi16(eC, 2)), eB, eF, pB, pF);
+   __m128i bl = xbr_corner(pE, _mm_add_epi16(ai, _mm_slli_epi16(dh, 2)),
+                           _mm_add_epi16(_mm_add_epi16(fh, bd), _mm_slli_epi16(eG, 2)), eD, eH, pD, pH);
+   __m128i br = xbr_corner(pE, _mm_add_epi16(cg, _mm_slli_epi16(fh, 2)),
+                           _mm_add_epi16(_mm_add_epi16(dh, bf), _mm_slli_epi16(eI, 2)), eF, eH, pF, pH);
+   store_blocks(out0 + 2 * x, out1 + 2 * x, tl, tr, bl, br);
+}
+#endif // HAVE_SSE2
+
+typedef void (*filter_pixel_fn)(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                                int x, int left, int right, uint16_t *out0, uint16_t *out1);
+typedef void (*filter_block_fn)(const uint16_t *up, const uint16_t *mid, const uint16_t *down,
+                                int x, uint16_t *out0, uint16_t *out1);
+
+// Worker body: source rows [begin, end) into two output rows each
+static void filter_rows(void *ctx, int begin, int end) {
+   const struct postfx_job *job = ctx;
+   int width = job->width;
+   filter_pixel_fn pixel = job->cfg.filter == POSTFX_FILTER_SCALE2X ? scale2x_pixel : xbr_pixel;
+#ifdef HAVE_SSE2
+   filter_block_fn block = job->cfg.filter == POSTFX_FILTER_SCALE2X ? scale2x_block_sse2 : xbr_block_sse2;
+#endif
+
+   for (int y = begin; y < end; y++) {
+      const uint8_t *base = (const uint8_t *)job->src;
+      const uint16_t *mid = (const uint16_t *)(base + y * job->src_pitch);
+      const uint16_t *up = y > 0 ? (const uint16_t *)(base + (y - 1) * job->src_pitch) : mid;
+      const uint16_t *down = y + 1 < job->height ? (const uint16_t *)(base + (y + 1) * job->src_pitch) : mid;
+      uint16_t *out0 = (uint16_t *)((uint8_t *)job->dst + 2 * y * job->dst_pitch);
+      uint16_t *out1 = (uint16_t *)((uint8_t *)out0 + job->dst_pitch);
+
+      // Edge columns repeat themselves; the interior has real neighbours
+      pixel(up, mid, down, 0, 0, width > 1 ? 1 : 0, out0, out1);
+      int x = 1;
+#ifdef HAVE_SSE2
+      for (; x + 9 <= width; x += 8)
+         block(up, mid, down, x, out0, out1);
+#endif
+      for (; x < width; x++)
+         pixel(up, mid, down, x, x - 1, x + 1 < width ? x + 1 : x, out0, out1);
+   }
+}
+
+// Worker body: scanlines and mask over output rows [begin, end), in place
+static void shade_rows(void *ctx, int begin, int end) {
+   const struct postfx_job *job = ctx;
+   int scale = job->cfg.scale;
+   for (int y = begin; y < end; y++) {
+      uint16_t *row = (uint16_t *)((uint8_t *)job->dst + y * job->dst_pitch);
+      bool dark = job->cfg.scanlines && (scale == 1 ? (y & 1) : y % scale == scale - 1);
+      if (dark || job->cfg.mask)
+         shade_row(row, row, factors[dark], job->width);
+   }
+}
+
+// One 2x filter pass of a width x height image
+static void filter_pass(const uint16_t *src, size_t src_pitch, int width, int height,
+                        uint16_t *dst, size_t dst_pitch, const struct postfx_config *cfg) {
+   struct postfx_job job = { src, src_pitch, width, height, dst, dst_pitch, *cfg };
+   workers_run(filter_rows, &job, height);
+}
+
+void postfx_apply(const uint16_t *src, size_t src_pitch, int width, int height,
+                  uint16_t *dst, size_t dst_pitch, const struct postfx_config *cfg) {
+   struct postfx_job job = { src, src_pitch, width, height, dst, dst_pitch, *cfg };
+   int scale = job.cfg.scale;
+   if (scale < 1)
+      scale = job.cfg.scale = 1;
+   if (scale > POSTFX_MAX_SCALE)
+      scale = job.cfg.scale = POSTFX_MAX_SCALE;
+   if (width * scale > POSTFX_MAX_WIDTH)
+      return;
+   build_factors(width * scale, &job.cfg);
+
+   bool filtered = job.cfg.filter != POSTFX_FILTER_NEAREST && (scale == 2 || scale == 4);
+   if (filtered && scale == 4) {
+      size_t pixels = (size_t)width * height * 4;
+      if (scratch_pixels < pixels) {
+         uint16_t *grown = realloc(scratch, pixels * sizeof(uint16_t));
+         if (grown) {
+            scratch = grown;
+            scratch_pixels = pixels;
+         }
+      }
+      filtered = scratch_pixels >= pixels;
+   }
+   if (!filtered) {
+      workers_run(postfx_rows, &job, height);
+      return;
+   }
+
+   if (scale == 2) {
+      filter_pass(src, src_pitch, width, height, dst, dst_pitch, &job.cfg);
+   } else {
+      size_t scratch_pitch = (size_t)width * 2 * sizeof(uint16_t);
+      filter_pass(src, src_pitch, width, height, scratch, scratch_pitch, &job.cfg);
+      filter_pass(scratch, scratch_pitch, width * 2, height * 2, dst, dst_pitch, &job.cfg);
+   }
+   if (job.cfg.scanlines || job.cfg.mask) {
+      job.width = width * scale;
+      workers_run(shade_rows, &job, height * scale);
+   }
+}
+
+void postfx_free(void) {
+   free(scratch);
+   scratch = NULL;
+   scratch_pixels = 0;
+}
@@ -0,0 +1,543 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "raster3d.h"
+#include "workers.h"
+
+// Sub-pixel precision of screen coordinates (28.4 fixed point)
+#define SUBPIXEL_BITS 4
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
+// Side planes are clipped this many half-viewports out from the centre;
+// the rasterizer handles anything in between, so most triangles crossing
+// the screen edge never need clipping
+#define GUARD_BAND 4.0f
+// Polygon vertices after clipping a triangle against all six planes
+#define CLIP_MAX_VERTICES 9
+
+struct clip_vertex {
+   float x, y, z, w;
+   float attr[3];   // r g b for Gouraud, u v for textured
+};
+
+// A set-up screen-space triangle. Edge functions a * X + b * Y + c are
+// non-negative inside, with X and Y the fixed-point pixel centre; the
+// bias for the top-left fill rule is folded into c. Interpolated values
+// are planes p[0] + p[1] * x + p[2] * y over pixel indices.
+struct raster_tri {
+   int64_t a[3], b[3], c[3];
+   int min_x, min_y, max_x, max_y;
+   float z[3];
+   float z_min, z_max;   // Depth range of the vertices
+   float attr[3][3];
+   uint16_t color;
+   enum raster3d_shading shading;
+   const struct raster3d_texture *texture;
+};
+
+// Triangles binned into a tile, as a linked list in submission order
+struct bin_entry {
+   int tri;
+   int next;
+   bool covered;   // Whole tile inside the triangle: skip edge tests
+};
+
+static uint16_t *target;
+static int target_width, target_height;
+static float *depth;
+static size_t depth_size;
+static int tiles_x, tiles_y;
+static int *bin_head, *bin_tail;
+static int bin_capacity;
+static struct bin_entry *entries;
+static int entry_count, entry_capacity;
+static struct raster_tri *tris;
+static int tri_count, tri_capacity;
+static bool frame_open;
+
+// Per-tile counters, so worker threads never share one; summed once the
+// frame is done
+struct tile_stats {
+   unsigned rejected, accepted;
+   unsigned pixels_covered, pixels_written;
+};
+static struct tile_stats *tile_stats;
+static struct raster3d_stats last_stats;
+
+bool raster3d_begin(uint16_t *fb, int fb_width, int fb_height) {
+   frame_open = false;
+   size_t pixels = (size_t)fb_width * fb_height;
+   if (pixels > depth_size) {
+      float *grown = realloc(depth, pixels * sizeof(*depth));
+      if (!grown)
+         return false;
+      depth = grown;
+      depth_size = pixels;
+   }
+   int tx = (fb_width + RASTER3D_TILE - 1) / RASTER3D_TILE;
+   int ty = (fb_height + RASTER3D_TILE - 1) / RASTER3D_TILE;
+   if (tx * ty > bin_capacity) {
+      int *head = realloc(bin_head, tx * ty * sizeof(*head));
+      if (head)
+         bin_head = head;
+      int *tail = realloc(bin_tail, tx * ty * sizeof(*tail));
+      if (tail)
+         bin_tail = tail;
+      struct tile_stats *stats = realloc(tile_stats, tx * ty * sizeof(*stats));
+      if (stats)
+         tile_stats = stats;
+      if (!head || !tail || !stats)
+         return false;
+      bin_capacity = tx * ty;
+   }
+   target = fb;
+   target_width = fb_width;
+   target_height = fb_height;
+   tiles_x = tx;
+   tiles_y = ty;
+   for (int i = 0; i < tx * ty; i++)
+      bin_head[i] = bin_tail[i] = -1;
+   memset(tile_stats, 0, tx * ty * sizeof(*tile_stats));
+   entry_count = 0;
+   tri_count = 0;
+   frame_open = true;
+   return true;
+}
+
+void raster3d_free(void) {
+   free(depth);
+   free(bin_head);
+   free(bin_tail);
+   free(tile_stats);
+   free(entries);
+   free(tris);
+   depth = NULL;
+   bin_head = bin_tail = NULL;
+   tile_stats = NULL;
+   entries = NULL;
+   tris = NULL;
+   depth_size = 0;
+   bin_capacity = entry_capacity = tri_capacity = 0;
+   entry_count = tri_count = 0;
+   frame_open = false;
+   memset(&last_stats, 0, sizeof(last_stats));
+}
+
+static bool add_entry(int tile, int tri, bool covered) {
+   if (entry_count == entry_capacity) {
+      int grown = entry_capacity ? entry_capacity * 2 : 1024;
+      struct bin_entry *e = realloc(entries, grown * sizeof(*e));
+      if (!e)
+         return false;
+      entries = e;
+      entry_capacity = grown;
+   }
+   struct bin_entry *e = &entries[entry_count];
+   e->tri = tri;
+   e->next = -1;
+   e->covered = covered;
+   if (bin_tail[tile] < 0)
+      bin_head[tile] = entry_count;
+   else
+      entries[bin_tail[tile]].next = entry_count;
+   bin_tail[tile] = entry_count++;
+   return true;
+}
+
+// Add the triangle to every tile it overlaps. Each edge is checked at the
+// tile corners: a tile is skipped when one edge is negative at all four,
+// and marked covered when every edge is non-negative at all four.
+static void bin_triangle(int index) {
+   const struct raster_tri *t = &tris[index];
+   for (int ty = t->min_y / RASTER3D_TILE; ty <= t->max_y / RASTER3D_TILE; ty++) {
+      int y0 = ty * RASTER3D_TILE;
+      int y1 = y0 + RASTER3D_TILE - 1 < target_height ? y0 + RASTER3D_TILE - 1 : target_height - 1;
+      int64_t cy0 = (int64_t)y0 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+      int64_t cy1 = (int64_t)y1 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+      for (int tx = t->min_x / RASTER3D_TILE; tx <= t->max_x / RASTER3D_TILE; tx++) {
+         int x0 = tx * RASTER3D_TILE;
+         int x1 = x0 + RASTER3D_TILE - 1 < target_width ? x0 + RASTER3D_TILE - 1 : target_width - 1;
+         int64_t cx0 = (int64_t)x0 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+         int64_t cx1 = (int64_t)x1 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+         bool covered = true, outside = false;
+         for (int i = 0; i < 3; i++) {
+            int64_t ax0 = t->a[i] * cx0, ax1 = t->a[i] * cx1;
+            int64_t by0 = t->b[i] * cy0, by1 = t->b[i] * cy1;
+            int64_t hi = (ax0 > ax1 ? ax0 : ax1) + (by0 > by1 ? by0 : by1) + t->c[i];
+            int64_t lo = (ax0 < ax1 ? ax0 : ax1) + (by0 < by1 ? by0 : by1) + t->c[i];
+            if (hi < 0)
+               outside = true;
+            if (lo < 0)
+               covered = false;
+         }
+         if (!outside && !add_entry(ty * tiles_x + tx, index, covered))
+            return;
+      }
+   }
+}
+
+// Plane through three vertex values at screen positions xs/ys, in pixels
+static void setup_plane(float p[3], const float xs[3], const float ys[3],
+                        float v0, float v1, float v2, float area) {
+   float dx = ((v1 - v0) * (ys[2] - ys[0]) - (v2 - v0) * (ys[1] - ys[0])) / area;
+   float dy = ((v2 - v0) * (xs[1] - xs[0]) - (v1 - v0) * (xs[2] - xs[0])) / area;
+   p[0] = v0 + dx * (0.5f - xs[0]) + dy * (0.5f - ys[0]);
+   p[1] = dx;
+   p[2] = dy;
+}
+
+static void setup_triangle(const struct clip_vertex *v0, const struct clip_vertex *v1,
+                           const struct clip_vertex *v2, const struct raster3d_material *material,
+                           uint16_t color) {
+   const struct clip_vertex *v[3] = { v0, v1, v2 };
+   float xs[3], ys[3], zs[3];
+   int64_t X[3], Y[3];
+   for (int i = 0; i < 3; i++) {
+      float inv_w = 1.0f / v[i]->w;
+      xs[i] = (v[i]->x * inv_w * 0.5f + 0.5f) * target_width;
+      ys[i] = (0.5f - v[i]->y * inv_w * 0.5f) * target_height;
+      zs[i] = v[i]->z * inv_w * 0.5f + 0.5f;
+      X[i] = (int64_t)lrintf(xs[i] * SUBPIXEL_ONE);
+      Y[i] = (int64_t)lrintf(ys[i] * SUBPIXEL_ONE);
+   }
+
+   // Counter-clockwise in clip space is clockwise on a y-down screen,
+   // which gives a positive area here
+   int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+   if (area == 0 || (area < 0 && !material->double_sided))
+      return;
+   if (area < 0) {
+      const struct clip_vertex *tv = v[1]; v[1] = v[2]; v[2] = tv;
+      int64_t ti = X[1]; X[1] = X[2]; X[2] = ti;
+      ti = Y[1]; Y[1] = Y[2]; Y[2] = ti;
+      float tf = xs[1]; xs[1] = xs[2]; xs[2] = tf;
+      tf = ys[1]; ys[1] = ys[2]; ys[2] = tf;
+      tf = zs[1]; zs[1] = zs[2]; zs[2] = tf;
+      area = -area;
+   }
+
+   // Pixels whose centres fall inside the bounding box
+   int64_t min_x = X[0], max_x = X[0], min_y = Y[0], max_y = Y[0];
+   for (int i = 1; i < 3; i++) {
+      if (min_x > X[i]) min_x = X[i];
+      if (max_x < X[i]) max_x = X[i];
+      if (min_y > Y[i]) min_y = Y[i];
+      if (max_y < Y[i]) max_y = Y[i];
+   }
+   if (max_x < SUBPIXEL_ONE / 2 || max_y < SUBPIXEL_ONE / 2)
+      return;
+   int px0 = min_x < 0 ? 0 : (int)((min_x + SUBPIXEL_ONE / 2 - 1) >> SUBPIXEL_BITS);
+   int py0 = min_y < 0 ? 0 : (int)((min_y + SUBPIXEL_ONE / 2 - 1) >> SUBPIXEL_BITS);
+   int px1 = (int)((max_x - SUBPIXEL_ONE / 2) >> SUBPIXEL_BITS);
+   int py1 = (int)((max_y - SUBPIXEL_ONE / 2) >> SUBPIXEL_BITS);
+   if (px1 >= target_width) px1 = target_width - 1;
+   if (py1 >= target_height) py1 = target_height - 1;
+   if (px0 > px1 || py0 > py1)
+      return;
+
+   if (tri_count == tri_capacity) {
+      int grown = tri_capacity ? tri_capacity * 2 : 256;
+      struct raster_tri *t = realloc(tris, grown * sizeof(*t));
+      if (!t)
+         return;
+      tris = t;
+      tri_capacity = grown;
+   }
+   struct raster_tri *t = &tris[tri_count];
+   for (int i = 0; i < 3; i++) {
+      int j = (i + 1) % 3;
+      int64_t dx = X[j] - X[i], dy = Y[j] - Y[i];
+      // Top-left rule: pixel centres exactly on other edges are left out
+      bool top_left = dy < 0 || (dy == 0 && dx > 0);
+      t->a[i] = -dy;
+      t->b[i] = dx;
+      t->c[i] = dy * X[i] - dx * Y[i] - (top_left ? 0 : 1);
+   }
+   t->min_x = px0;
+   t->min_y = py0;
+   t->max_x = px1;
+   t->max_y = py1;
+   float area_px = (float)area / (SUBPIXEL_ONE * SUBPIXEL_ONE);
+   for (int i = 0; i < 3; i++) {
+      xs[i] = (float)X[i] / SUBPIXEL_ONE;
+      ys[i] = (float)Y[i] / SUBPIXEL_ONE;
+   }
+   setup_plane(t->z, xs, ys, zs[0], zs[1], zs[2], area_px);
+   t->z_min = fminf(zs[0], fminf(zs[1], zs[2]));
+   t->z_max = fmaxf(zs[0], fmaxf(zs[1], zs[2]));
+   int attrs = material->shading == RASTER3D_SHADE_GOURAUD ? 3 :
+               material->shading == RASTER3D_SHADE_TEXTURED ? 2 : 0;
+   for (int k = 0; k < attrs; k++)
+      setup_plane(t->attr[k], xs, ys, v[0]->attr[k], v[1]->attr[k], v[2]->attr[k], area_px);
+   t->color = color;
+   t->shading = material->texture || material->shading != RASTER3D_SHADE_TEXTURED ?
+                material->shading : RASTER3D_SHADE_FLAT;
+   t->texture = material->texture;
+   bin_triangle(tri_count++);
+}
+
+// Signed distance to clip plane i; negative is outside
+static float plane_distance(const struct clip_vertex *v, int plane) {
+   switch (plane) {
+   case 0: return v->w + v->z;                 // Near
+   case 1: return v->w - v->z;                 // Far
+   case 2: return GUARD_BAND * v->w + v->x;
+   case 3: return GUARD_BAND * v->w - v->x;
+   case 4: return GUARD_BAND * v->w + v->y;
+   default: return GUARD_BAND * v->w - v->y;
+   }
+}
+
+static int outcode(const struct clip_vertex *v) {
+   int code = 0;
+   for (int p = 0; p < 6; p++)
+      if (plane_distance(v, p) < 0.0f)
+         code |= 1 << p;
+   return code;
+}
+
+// Sutherland-Hodgman against one plane; returns the new vertex count
+static int clip_polygon(const struct clip_vertex *in, int count, struct clip_vertex *out, int plane) {
+   int n = 0;
+   for (int i = 0; i < count; i++) {
+      const struct clip_vertex *a = &in[i], *b = &in[(i + 1) % count];
+      float da = plane_distance(a, plane), db = plane_distance(b, plane);
+      if (da >= 0.0f)
+         out[n++] = *a;
+      if ((da >= 0.0f) != (db >= 0.0f)) {
+         float t = da / (da - db);
+         struct clip_vertex *v = &out[n++];
+         v->x = a->x + (b->x - a->x) * t;
+         v->y = a->y + (b->y - a->y) * t;
+         v->z = a->z + (b->z - a->z) * t;
+         v->w = a->w + (b->w - a->w) * t;
+         for (int k = 0; k < 3; k++)
+            v->attr[k] = a->attr[k] + (b->attr[k] - a->attr[k]) * t;
+      }
+   }
+   return n;
+}
+
+static void transform(const float m[16], const struct raster3d_vertex *in,
+                      enum raster3d_shading shading, struct clip_vertex *out) {
+   out->x = m[0] * in->x + m[4] * in->y + m[8] * in->z + m[12];
+   out->y = m[1] * in->x + m[5] * in->y + m[9] * in->z + m[13];
+   out->z = m[2] * in->x + m[6] * in->y + m[10] * in->z + m[14];
+   out->w = m[3] * in->x + m[7] * in->y + m[11] * in->z + m[15];
+   if (shading == RASTER3D_SHADE_TEXTURED) {
+      out->attr[0] = in->u;
+      out->attr[1] = in->v;
+      out->attr[2] = 0.0f;
+   } else {
+      // Colour channels in their own 5/6/5-bit units
+      out->attr[0] = (float)(in->color >> 11);
+      out->attr[1] = (float)((in->color >> 5) & 0x3F);
+      out->attr[2] = (float)(in->color & 0x1F);
+   }
+}
+
+void raster3d_draw(const float mvp[16], const struct raster3d_vertex *vertices,
+                   const uint16_t *indices, int triangle_count,
+                   const struct raster3d_material *material) {
+   if (!frame_open)
+      return;
+   for (int i = 0; i < triangle_count; i++) {
+      struct clip_vertex poly[CLIP_MAX_VERTICES], scratch[CLIP_MAX_VERTICES];
+      const struct raster3d_vertex *first = &vertices[indices[i * 3]];
+      int codes_and = ~0, codes_or = 0;
+      for (int k = 0; k < 3; k++) {
+         transform(mvp, &vertices[indices[i * 3 + k]], material->shading, &poly[k]);
+         int code = outcode(&poly[k]);
+         codes_and &= code;
+         codes_or |= code;
+      }
+      if (codes_and)
+         continue;   // Entirely outside one plane
+
+      int count = 3;
+      struct clip_vertex *cur = poly, *next = scratch;
+      for (int p = 0; p < 6 && count >= 3; p++) {
+         if (!(codes_or & (1 << p)))
+            continue;
+         count = clip_polygon(cur, count, next, p);
+         struct clip_vertex *swap = cur; cur = next; next = swap;
+      }
+      for (int k = 1; k + 1 < count; k++)
+         setup_triangle(&cur[0], &cur[k], &cur[k + 1], material, first->color);
+   }
+}
+
+static inline uint16_t pack565(const float p[3][3], float x, float y) {
+   int r = (int)(p[0][0] + p[0][1] * x + p[0][2] * y + 0.5f);
+   int g = (int)(p[1][0] + p[1][1] * x + p[1][2] * y + 0.5f);
+   int b = (int)(p[2][0] + p[2][1] * x + p[2][2] * y + 0.5f);
+   r = r < 0 ? 0 : r > 31 ? 31 : r;
+   g = g < 0 ? 0 : g > 63 ? 63 : g;
+   b = b < 0 ? 0 : b > 31 ? 31 : b;
+   return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void shade_tile(int tile) {
+   if (bin_head[tile] < 0)
+      return;   // Nothing here; depth is only read inside the frame
+   struct tile_stats *stats = &tile_stats[tile];
+   int x0 = tile % tiles_x * RASTER3D_TILE, y0 = tile / tiles_x * RASTER3D_TILE;
+   int x1 = x0 + RASTER3D_TILE < target_width ? x0 + RASTER3D_TILE : target_width;
+   int y1 = y0 + RASTER3D_TILE < target_height ? y0 + RASTER3D_TILE : target_height;
+   for (int y = y0; y < y1; y++)
+      for (int x = x0; x < x1; x++)
+         depth[y * target_width + x] = FLT_MAX;
+   // Bounds on the depths stored in the tile: every pixel is at least
+   // tile_near, and at most tile_far once a triangle has covered it all
+   float tile_near = FLT_MAX, tile_far = FLT_MAX;
+
+   for (int e = bin_head[tile]; e >= 0; e = entries[e].next) {
+      const struct raster_tri *t = &tris[entries[e].tri];
+      bool covered = entries[e].covered;
+      int bx0 = x0 > t->min_x ? x0 : t->min_x, bx1 = x1 - 1 < t->max_x ? x1 - 1 : t->max_x;
+      int by0 = y0 > t->min_y ? y0 : t->min_y, by1 = y1 - 1 < t->max_y ? y1 - 1 : t->max_y;
+
+      // Depth range of the triangle over this part of the tile: the plane
+      // at the corners, narrowed by the vertex range
+      float zx0 = t->z[1] * bx0, zx1 = t->z[1] * bx1;
+      float zy0 = t->z[2] * by0, zy1 = t->z[2] * by1;
+      float z_lo = t->z[0] + fminf(zx0, zx1) + fminf(zy0, zy1);
+      float z_hi = t->z[0] + fmaxf(zx0, zx1) + fmaxf(zy0, zy1);
+      if (z_lo < t->z_min) z_lo = t->z_min;
+      if (z_hi > t->z_max) z_hi = t->z_max;
+      if (z_lo >= tile_far) {
+         stats->rejected++;
+         continue;
+      }
+      bool test_depth = z_hi >= tile_near;
+      if (!test_depth)
+         stats->accepted++;
+
+      int64_t cx = (int64_t)bx0 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+      int64_t cy = (int64_t)by0 * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+      int64_t row0 = t->a[0] * cx + t->b[0] * cy + t->c[0];
+      int64_t row1 = t->a[1] * cx + t->b[1] * cy + t->c[1];
+      int64_t row2 = t->a[2] * cx + t->b[2] * cy + t->c[2];
+      int64_t step_x0 = t->a[0] * SUBPIXEL_ONE, step_y0 = t->b[0] * SUBPIXEL_ONE;
+      int64_t step_x1 = t->a[1] * SUBPIXEL_ONE, step_y1 = t->b[1] * SUBPIXEL_ONE;
+      int64_t step_x2 = t->a[2] * SUBPIXEL_ONE, step_y2 = t->b[2] * SUBPIXEL_ONE;
+      unsigned pixels_covered = 0, pixels_written = 0;
+
+      for (int y = by0; y <= by1; y++) {
+         int64_t e0 = row0, e1 = row1, e2 = row2;
+         float z = t->z[0] + t->z[1] * bx0 + t->z[2] * y;
+         float *zrow = &depth[y * target_width];
+         uint16_t *dst = &target[y * target_width];
+         for (int x = bx0; x <= bx1; x++) {
+            if (covered || (e0 | e1 | e2) >= 0) {
+               pixels_covered++;
+               if (!test_depth || z < zrow[x]) {
+                  pixels_written++;
+                  zrow[x] = z;
+                  if (t->shading == RASTER3D_SHADE_FLAT) {
+                     dst[x] = t->color;
+                  } else if (t->shading == RASTER3D_SHADE_GOURAUD) {
+                     dst[x] = pack565(t->attr, (float)x, (float)y);
+                  } else {
+                     const struct raster3d_texture *tex = t->texture;
+                     int u = (int)floorf(t->attr[0][0] + t->attr[0][1] * x + t->attr[0][2] * y);
+                     int v = (int)floorf(t->attr[1][0] + t->attr[1][1] * x + t->attr[1][2] * y);
+                     dst[x] = tex->pixels[(v & (tex->height - 1)) * tex->width + (u & (tex->width - 1))];
+                  }
+               }
+            }
+            e0 += step_x0;
+            e1 += step_x1;
+            e2 += step_x2;
+            z += t->z[1];
+         }
+         row0 += step_y0;
+         row1 += step_y1;
+         row2 += step_y2;
+      }
+      stats->pixels_covered += pixels_covered;
+      stats->pixels_written += pixels_written;
+
+      if (tile_near > z_lo)
+         tile_near = z_lo;
+      // A triangle over the whole tile leaves no pixel farther than it
+      if (covered && tile_far > z_hi)
+         tile_far = z_hi;
+   }
+}
+
+static void shade_tiles(void *ctx, int begin, int end) {
+   (void)ctx;
+   for (int tile = begin; tile < end; tile++)
+      shade_tile(tile);
+}
+
+void raster3d_end(void) {
+   if (!frame_open)
+      return;
+   frame_open = false;
+   if (tri_count)
+      workers_run(shade_tiles, NULL, tiles_x * tiles_y);
+
+   memset(&last_stats, 0, sizeof(last_stats));
+   last_stats.triangles = (unsigned)tri_count;
+   last_stats.tile_tests = (unsigned)entry_count;
+   for (int i = 0; i < tiles_x * tiles_y; i++) {
+      last_stats.tiles_rejected += tile_stats[i].rejected;
+      last_stats.tiles_accepted += tile_stats[i].accepted;
+      last_stats.pixels_covered += tile_stats[i].pixels_covered;
+      last_stats.pixels_written += tile_stats[i].pixels_written;
+   }
+}
+
+void raster3d_get_stats(struct raster3d_stats *stats) {
+   *stats = last_stats;
+}
+
+void raster3d_mat_identity(float m[16]) {
+   memset(m, 0, 16 * sizeof(float));
+   m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+void raster3d_mat_perspective(float m[16], float fovy, float aspect, float znear, float zfar) {
+   float f = 1.0f / tanf(fovy * 0.5f);
+   memset(m, 0, 16 * sizeof(float));
+   m[0] = f / aspect;
+   m[5] = f;
+   m[10] = (zfar + znear) / (znear - zfar);
+   m[11] = -1.0f;
+   m[14] = 2.0f * zfar * znear / (znear - zfar);
+}
+
+void raster3d_mat_multiply(float out[16], const float a[16], const float b[16]) {
+   float r[16];
+   for (int c = 0; c < 4; c++)
+      for (int row = 0; row < 4; row++)
+         r[c * 4 + row] = a[row] * b[c * 4] + a[4 + row] * b[c * 4 + 1] +
+                          a[8 + row] * b[c * 4 + 2] + a[12 + row] * b[c * 4 + 3];
+   memcpy(out, r, sizeof(r));
+}
+
+void raster3d_mat_translate(float m[16], float x, float y, float z) {
+   float t[16];
+   raster3d_mat_identity(t);
+   t[12] = x;
+   t[13] = y;
+   t[14] = z;
+   raster3d_mat_multiply(m, m, t);
+}
+
+void raster3d_mat_rotate(float m[16], float angle, float x, float y, float z) {
+   float len = sqrtf(x * x + y * y + z * z);
+   if (len == 0.0f)
+      return;
+   x /= len; y /= len; z /= len;
+   float c = cosf(angle), s = sinf(angle), k = 1.0f - c;
+   float r[16] = {
+      x * x * k + c,     y * x * k + z * s, z * x * k - y * s, 0.0f,
+      x * y * k - z * s, y * y * k + c,     z * y * k + x * s, 0.0f,
+      x * z * k + y * s, y * z * k - x * s, z * z * k + c,     0.0f,
+      0.0f,              0.0f,              0.0f,              1.0f,
+   };
+   raster3d_mat_multiply(m, m, r);
+}
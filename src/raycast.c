@@ -0,0 +1,164 @@
+#include <math.h>
+#include <stdlib.h>
+#include "raycast.h"
+#include "workers.h"
+
+#define TEXTURE_MASK (RAYCAST_TEXTURE_SIZE - 1)
+#define TEXTURE_TEXELS (RAYCAST_TEXTURE_SIZE * RAYCAST_TEXTURE_SIZE)
+
+// Floor texture coordinates along one row below the horizon. Every pixel
+// of a row is the same distance away, so the coordinates are linear in x:
+// column x samples (u + du * x, v + dv * x), in 16.16 fixed-point texels
+// that wrap like the textures do. The ceiling row mirrored above the
+// horizon uses the same values.
+struct floor_row {
+   uint32_t u, v;
+   uint32_t du, dv;
+};
+
+struct raycast_job {
+   uint16_t *fb;
+   int fb_width, fb_height;
+   const struct raycast_world *world;
+   const struct raycast_view *view;
+   float dir_x, dir_y;       // Ray through the left screen edge
+   float step_x, step_y;     // Change per column
+};
+
+static struct floor_row *floor_rows;
+static int floor_capacity;
+
+void raycast_free(void) {
+   free(floor_rows);
+   floor_rows = NULL;
+   floor_capacity = 0;
+}
+
+static inline int cell_at(const struct raycast_world *world, int x, int y) {
+   if (x < 0 || y < 0 || x >= world->width || y >= world->height)
+      return 1;
+   return world->cells[y * world->width + x];
+}
+
+bool raycast_solid(const struct raycast_world *world, float x, float y) {
+   return cell_at(world, (int)floorf(x), (int)floorf(y)) != 0;
+}
+
+static inline uint32_t to_fixed(float v) {
+   return (uint32_t)(int64_t)llrintf(v * 65536.0f);
+}
+
+static void render_columns(void *ctx, int begin, int end) {
+   const struct raycast_job *job = ctx;
+   const struct raycast_world *world = job->world;
+   const int width = job->fb_width, height = job->fb_height;
+   const int horizon = height / 2;
+   const int max_steps = world->width + world->height + 2;
+
+   for (int x = begin; x < end; x++) {
+      float ray_x = job->dir_x + job->step_x * x, ray_y = job->dir_y + job->step_y * x;
+      int map_x = (int)floorf(job->view->x), map_y = (int)floorf(job->view->y);
+      // Ray length between successive vertical and horizontal grid lines
+      float delta_x = ray_x != 0.0f ? fabsf(1.0f / ray_x) : 1e30f;
+      float delta_y = ray_y != 0.0f ? fabsf(1.0f / ray_y) : 1e30f;
+      int step_x = ray_x < 0.0f ? -1 : 1, step_y = ray_y < 0.0f ? -1 : 1;
+      float side_x = (ray_x < 0.0f ? job->view->x - map_x : map_x + 1.0f - job->view->x) * delta_x;
+      float side_y = (ray_y < 0.0f ? job->view->y - map_y : map_y + 1.0f - job->view->y) * delta_y;
+
+      // DDA to the first wall
+      int cell = 0, side = 0;
+      for (int i = 0; i < max_steps && !cell; i++) {
+         if (side_x < side_y) {
+            side_x += delta_x;
+            map_x += step_x;
+            side = 0;
+         } else {
+            side_y += delta_y;
+            map_y += step_y;
+            side = 1;
+         }
+         cell = cell_at(world, map_x, map_y);
+      }
+      // Distance along the view direction, which avoids fisheye distortion
+      float distance = side == 0 ? side_x - delta_x : side_y - delta_y;
+      if (distance < 1e-4f)
+         distance = 1e-4f;
+
+      int line = (int)(height / distance);
+      int top = horizon - line / 2, bottom = top + line - 1;
+      int y0 = top < 0 ? 0 : top, y1 = bottom >= height ? height - 1 : bottom;
+
+      // Texture column from where the ray struck the wall
+      float hit = side == 0 ? job->view->y + distance * ray_y : job->view->x + distance * ray_x;
+      int tex_x = (int)((hit - floorf(hit)) * RAYCAST_TEXTURE_SIZE) & TEXTURE_MASK;
+      if ((side == 0 && ray_x < 0.0f) || (side == 1 && ray_y > 0.0f))
+         tex_x = TEXTURE_MASK - tex_x;
+      int texture = (cell - 1) % world->wall_count;
+      const uint16_t *column = &world->walls[texture * TEXTURE_TEXELS + tex_x * RAYCAST_TEXTURE_SIZE];
+
+      // Wall slice, stepping down the texture column in 16.16
+      int32_t tex_step = (int32_t)(((int64_t)RAYCAST_TEXTURE_SIZE << 16) / (line > 0 ? line : 1));
+      int32_t tex_pos = (int32_t)((int64_t)(y0 - top) * tex_step);
+      uint16_t *dst = &job->fb[x];
+      for (int y = y0; y <= y1; y++) {
+         uint16_t c = column[(tex_pos >> 16) & TEXTURE_MASK];
+         // Shade walls facing north/south to tell the sides apart
+         dst[y * width] = side ? (uint16_t)((c >> 1) & 0x7BEF) : c;
+         tex_pos += tex_step;
+      }
+
+      // Floor below the slice and ceiling above it
+      for (int y = y1 + 1 > horizon ? y1 + 1 : horizon; y < height; y++) {
+         const struct floor_row *row = &floor_rows[y - horizon];
+         uint32_t u = ((row->u + row->du * (uint32_t)x) >> 16) & TEXTURE_MASK;
+         uint32_t v = ((row->v + row->dv * (uint32_t)x) >> 16) & TEXTURE_MASK;
+         dst[y * width] = world->floor[u * RAYCAST_TEXTURE_SIZE + v];
+      }
+      for (int y = 0; y < y0 && y < horizon; y++) {
+         const struct floor_row *row = &floor_rows[horizon - 1 - y];
+         uint32_t u = ((row->u + row->du * (uint32_t)x) >> 16) & TEXTURE_MASK;
+         uint32_t v = ((row->v + row->dv * (uint32_t)x) >> 16) & TEXTURE_MASK;
+         dst[y * width] = world->ceiling[u * RAYCAST_TEXTURE_SIZE + v];
+      }
+   }
+}
+
+void raycast_render(uint16_t *fb, int fb_width, int fb_height,
+                    const struct raycast_world *world, const struct raycast_view *view) {
+   int horizon = fb_height / 2;
+   int rows = fb_height - horizon;
+   if (rows > floor_capacity) {
+      struct floor_row *grown = realloc(floor_rows, rows * sizeof(*grown));
+      if (!grown)
+         return;
+      floor_rows = grown;
+      floor_capacity = rows;
+   }
+
+   // Camera plane perpendicular to the view direction; rays run from
+   // dir - plane at the left edge to dir + plane at the right
+   float dir_x = cosf(view->angle), dir_y = sinf(view->angle);
+   float half = tanf(view->fov * 0.5f);
+   float plane_x = -dir_y * half, plane_y = dir_x * half;
+   struct raycast_job job = {
+      fb, fb_width, fb_height, world, view,
+      dir_x - plane_x, dir_y - plane_y,
+      2.0f * plane_x / fb_width, 2.0f * plane_y / fb_width,
+   };
+   // Centre ray offsets by half a column so pixel centres are sampled
+   job.dir_x += job.step_x * 0.5f;
+   job.dir_y += job.step_y * 0.5f;
+
+   for (int i = 0; i < rows; i++) {
+      // Eye at mid height: a row p pixels below the horizon sees the floor
+      // at distance (height / 2) / p
+      float distance = fb_height * 0.5f / (i + 0.5f);
+      float u = (view->x + distance * job.dir_x) * RAYCAST_TEXTURE_SIZE;
+      float v = (view->y + distance * job.dir_y) * RAYCAST_TEXTURE_SIZE;
+      floor_rows[i].u = to_fixed(u);
+      floor_rows[i].v = to_fixed(v);
+      floor_rows[i].du = to_fixed(distance * job.step_x * RAYCAST_TEXTURE_SIZE);
+      floor_rows[i].dv = to_fixed(distance * job.step_y * RAYCAST_TEXTURE_SIZE);
+   }
+   workers_run(render_columns, &job, fb_width);
+}
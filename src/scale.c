@@ -0,0 +1,302 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scale.h"
+#include "simd.h"
+#include "workers.h"
+
+// Tap weights are 2.14 fixed point and sum to exactly 1.0 per output
+// pixel. Channels travel as int16: 0-255 in the source, 8.6 fixed point
+// between the two passes, so every product pair fits a 32-bit madd.
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define MID_SHIFT (WEIGHT_BITS - 6)            // Source channels to 8.6
+#define OUT_SHIFT (WEIGHT_BITS + 6)            // 8.6 channels back to 0-255
+
+// Filter taps of one axis: output i reads count[i] consecutive source
+// pixels from start[i], weighted by weights[i * max_taps ...]
+struct taps {
+   int *start;
+   int *count;
+   int16_t *weights;
+   int max_taps;
+   size_t capacity;   // Weight slots allocated
+   int outputs;       // Entries in start/count
+};
+
+static struct taps x_taps, y_taps;
+
+struct scale_job {
+   const uint8_t *src;
+   size_t src_pitch;
+   int src_width;
+   uint8_t *dst;
+   size_t dst_pitch;
+   int dst_width;
+   enum retro_pixel_format format;
+};
+
+static bool taps_reserve(struct taps *t, int outputs, int max_taps) {
+   size_t slots = (size_t)outputs * max_taps;
+   if (t->outputs < outputs) {
+      int *start = realloc(t->start, outputs * sizeof(*start));
+      if (start)
+         t->start = start;
+      int *count = realloc(t->count, outputs * sizeof(*count));
+      if (count)
+         t->count = count;
+      if (!start || !count)
+         return false;
+      t->outputs = outputs;
+   }
+   if (t->capacity < slots) {
+      int16_t *weights = realloc(t->weights, slots * sizeof(*weights));
+      if (!weights)
+         return false;
+      t->weights = weights;
+      t->capacity = slots;
+   }
+   t->max_taps = max_taps;
+   return true;
+}
+
+// Scale weights to sum to exactly WEIGHT_ONE, trimming zero taps at both ends
+static void taps_store(struct taps *t, int i, int start, const float *w, int n) {
+   while (n > 1 && w[n - 1] <= 0.0f)
+      n--;
+   while (n > 1 && w[0] <= 0.0f) {
+      w++;
+      n--;
+      start++;
+   }
+   float sum = 0.0f;
+   for (int k = 0; k < n; k++)
+      sum += w[k];
+   int16_t *out = &t->weights[(size_t)i * t->max_taps];
+   int total = 0, largest = 0;
+   for (int k = 0; k < n; k++) {
+      out[k] = (int16_t)lrintf(w[k] / sum * WEIGHT_ONE);
+      total += out[k];
+      if (out[k] > out[largest])
+         largest = k;
+   }
+   out[largest] = (int16_t)(out[largest] + WEIGHT_ONE - total);
+   t->start[i] = start;
+   t->count[i] = n;
+}
+
+static bool build_bilinear(struct taps *t, int src_size, int dst_size) {
+   if (!taps_reserve(t, dst_size, 2))
+      return false;
+   float ratio = (float)src_size / dst_size;
+   for (int i = 0; i < dst_size; i++) {
+      // Pixel centres line up: output i samples source (i + 0.5) * ratio - 0.5
+      float pos = (i + 0.5f) * ratio - 0.5f;
+      int first = (int)floorf(pos);
+      float w[2] = { 1.0f - (pos - first), pos - first };
+      if (first < 0) {
+         first = 0;
+         w[0] = 1.0f;
+         w[1] = 0.0f;
+      }
+      if (first >= src_size - 1) {
+         first = src_size - 1;
+         w[0] = 1.0f;
+         w[1] = 0.0f;
+      }
+      taps_store(t, i, first, w, 2);
+   }
+   return true;
+}
+
+static bool build_box(struct taps *t, int src_size, int dst_size) {
+   float ratio = (float)src_size / dst_size;
+   int max_taps = (int)ceilf(ratio) + 1;
+   if (!taps_reserve(t, dst_size, max_taps))
+      return false;
+   float w[SCALE_MAX_SIZE + 1];
+   for (int i = 0; i < dst_size; i++) {
+      // Output i covers source [lo, hi); weight each pixel by its overlap
+      float lo = i * ratio, hi = (i + 1) * ratio;
+      int first = (int)floorf(lo);
+      int n = 0;
+      for (int k = first; k < hi && k < src_size && n < max_taps; k++) {
+         float a = k < lo ? lo : (float)k;
+         float b = k + 1 > hi ? hi : (float)(k + 1);
+         w[n++] = b > a ? b - a : 0.0f;
+      }
+      if (n == 0) {
+         first = src_size - 1;
+         w[n++] = 1.0f;
+      }
+      taps_store(t, i, first, w, n);
+   }
+   return true;
+}
+
+// Source pixel x of a row as B, G, R, X channels in 0-255
+static inline void load_channels(const uint8_t *row, int x, enum retro_pixel_format format, int16_t *c) {
+   if (format == RETRO_PIXEL_FORMAT_XRGB8888) {
+      const uint8_t *p = row + x * 4;
+      c[0] = p[0];
+      c[1] = p[1];
+      c[2] = p[2];
+      c[3] = p[3];
+   } else {
+      unsigned p = ((const uint16_t *)row)[x];
+      unsigned r = p >> 11, g = (p >> 5) & 63, b = p & 31;
+      c[0] = (int16_t)(b << 3 | b >> 2);
+      c[1] = (int16_t)(g << 2 | g >> 4);
+      c[2] = (int16_t)(r << 3 | r >> 2);
+      c[3] = 0;
+   }
+}
+
+#ifdef HAVE_SSE2
+// Two source pixels x and x + 1 as eight int16 channels
+static inline __m128i load_pair(const uint8_t *row, int x, enum retro_pixel_format format) {
+   if (format == RETRO_PIXEL_FORMAT_XRGB8888)
+      return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(row + x * 4)), _mm_setzero_si128());
+   int16_t c[8];
+   load_channels(row, x, format, c);
+   load_channels(row, x + 1, format, c + 4);
+   return _mm_loadu_si128((const __m128i *)c);
+}
+#endif
+
+// Vertical pass: source columns filtered into one row of 8.6 channels
+static void filter_columns(const struct scale_job *job, int y, int16_t *out) {
+   int first = y_taps.start[y], n = y_taps.count[y];
+   const int16_t *w = &y_taps.weights[(size_t)y * y_taps.max_taps];
+   const uint8_t *rows = job->src + first * job->src_pitch;
+   int width = job->src_width;
+   int x = 0;
+#ifdef HAVE_SSE2
+   // Two pixels per step; source rows are taken in pairs so each madd
+   // applies two taps to the interleaved channels
+   const __m128i round = _mm_set1_epi32(1 << (MID_SHIFT - 1));
+   for (; x + 2 <= width; x += 2) {
+      __m128i lo = round, hi = round;
+      for (int k = 0; k < n; k += 2) {
+         __m128i a = load_pair(rows + k * job->src_pitch, x, job->format);
+         __m128i b = _mm_setzero_si128();
+         int16_t wb = 0;
+         if (k + 1 < n) {
+            b = load_pair(rows + (k + 1) * job->src_pitch, x, job->format);
+            wb = w[k + 1];
+         }
+         __m128i weights = _mm_set1_epi32((int)((uint32_t)(uint16_t)wb << 16 | (uint16_t)w[k]));
+         lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+         hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+      }
+      lo = _mm_srai_epi32(lo, MID_SHIFT);
+      hi = _mm_srai_epi32(hi, MID_SHIFT);
+      _mm_storeu_si128((__m128i *)&out[x * 4], _mm_packs_epi32(lo, hi));
+   }
+#endif
+   for (; x < width; x++) {
+      int32_t sum[4] = { 1 << (MID_SHIFT - 1), 1 << (MID_SHIFT - 1), 1 << (MID_SHIFT - 1), 1 << (MID_SHIFT - 1) };
+      for (int k = 0; k < n; k++) {
+         int16_t c[4];
+         load_channels(rows + k * job->src_pitch, x, job->format, c);
+         for (int ch = 0; ch < 4; ch++)
+            sum[ch] += c[ch] * w[k];
+      }
+      for (int ch = 0; ch < 4; ch++)
+         out[x * 4 + ch] = (int16_t)(sum[ch] >> MID_SHIFT);
+   }
+}
+
+static inline void store_pixel(uint8_t *row, int x, enum retro_pixel_format format, const int32_t *c) {
+   if (format == RETRO_PIXEL_FORMAT_XRGB8888) {
+      ((uint32_t *)row)[x] = (uint32_t)c[0] | (uint32_t)c[1] << 8 | (uint32_t)c[2] << 16 | (uint32_t)c[3] << 24;
+   } else {
+      int r = (c[2] * 31 + 127) / 255, g = (c[1] * 63 + 127) / 255, b = (c[0] * 31 + 127) / 255;
+      ((uint16_t *)row)[x] = (uint16_t)(r << 11 | g << 5 | b);
+   }
+}
+
+// Horizontal pass: one filtered row into the destination format
+static void filter_row(const struct scale_job *job, const int16_t *in, uint8_t *row) {
+   for (int x = 0; x < job->dst_width; x++) {
+      int first = x_taps.start[x], n = x_taps.count[x];
+      const int16_t *w = &x_taps.weights[(size_t)x * x_taps.max_taps];
+      const int16_t *p = &in[first * 4];
+      int32_t c[4];
+#ifdef HAVE_SSE2
+      // Neighbouring pixels are regrouped so one madd applies two taps
+      // to each channel
+      __m128i sum = _mm_set1_epi32(1 << (OUT_SHIFT - 1));
+      int k = 0;
+      for (; k + 2 <= n; k += 2) {
+         __m128i pair = _mm_loadu_si128((const __m128i *)&p[k * 4]);
+         __m128i mixed = _mm_unpacklo_epi16(pair, _mm_unpackhi_epi64(pair, pair));
+         __m128i weights = _mm_set1_epi32((int)((uint32_t)(uint16_t)w[k + 1] << 16 | (uint16_t)w[k]));
+         sum = _mm_add_epi32(sum, _mm_madd_epi16(mixed, weights));
+      }
+      if (k < n) {
+         __m128i one = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)&p[k * 4]), _mm_setzero_si128());
+         sum = _mm_add_epi32(sum, _mm_madd_epi16(one, _mm_set1_epi32((uint16_t)w[k])));
+      }
+      sum = _mm_srai_epi32(sum, OUT_SHIFT);
+      _mm_storeu_si128((__m128i *)c, sum);
+#else
+      for (int ch = 0; ch < 4; ch++)
+         c[ch] = 1 << (OUT_SHIFT - 1);
+      for (int k = 0; k < n; k++)
+         for (int ch = 0; ch < 4; ch++)
+            c[ch] += p[k * 4 + ch] * w[k];
+      for (int ch = 0; ch < 4; ch++)
+         c[ch] >>= OUT_SHIFT;
+#endif
+      for (int ch = 0; ch < 4; ch++)
+         c[ch] = c[ch] < 0 ? 0 : c[ch] > 255 ? 255 : c[ch];
+      store_pixel(row, x, job->format, c);
+   }
+}
+
+// Worker body: output rows [begin, end), each through both passes. The
+// column-filtered row is consumed straight away, so one row of scratch
+// (32 KB at SCALE_MAX_SIZE) per call is enough.
+static void scale_rows(void *ctx, int begin, int end) {
+   const struct scale_job *job = ctx;
+   int16_t row[SCALE_MAX_SIZE * 4];
+   for (int y = begin; y < end; y++) {
+      filter_columns(job, y, row);
+      filter_row(job, row, job->dst + y * job->dst_pitch);
+   }
+}
+
+void scale_image(const void *src, size_t src_pitch, int src_width, int src_height,
+                 void *dst, size_t dst_pitch, int dst_width, int dst_height,
+                 enum retro_pixel_format format, enum scale_filter filter) {
+   if (format != RETRO_PIXEL_FORMAT_RGB565 && format != RETRO_PIXEL_FORMAT_XRGB8888)
+      return;
+   if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0 ||
+       src_width > SCALE_MAX_SIZE || src_height > SCALE_MAX_SIZE ||
+       dst_width > SCALE_MAX_SIZE || dst_height > SCALE_MAX_SIZE)
+      return;
+
+   bool ok = filter == SCALE_FILTER_BOX
+                ? build_box(&x_taps, src_width, dst_width) && build_box(&y_taps, src_height, dst_height)
+                : build_bilinear(&x_taps, src_width, dst_width) && build_bilinear(&y_taps, src_height, dst_height);
+   if (!ok)
+      return;
+
+   struct scale_job job = {
+      src, src_pitch, src_width, dst, dst_pitch, dst_width, format,
+   };
+   workers_run(scale_rows, &job, dst_height);
+}
+
+static void taps_free(struct taps *t) {
+   free(t->start);
+   free(t->count);
+   free(t->weights);
+   memset(t, 0, sizeof(*t));
+}
+
+void scale_free(void) {
+   taps_free(&x_taps);
+   taps_free(&y_taps);
+}
@@ -0,0 +1,55 @@
+// Shared by the core (fonts loaded at run time) and tools/fontgen.c (the
+// built-in font's atlas), so both produce identical fields.
+#include <math.h>
+#include "sdf.h"
+
+int sdf_scale_for_height(int height) {
+   int scale = SDF_TARGET_HEIGHT / (height > 0 ? height : 1);
+   return scale > 0 ? scale : 1;
+}
+
+static int glyph_bit(const uint8_t *bits, int stride, int width, int height, int x, int y) {
+   if (x < 0 || y < 0 || x >= width || y >= height)
+      return 0;
+   return (bits[y * stride + (x >> 3)] >> (7 - (x & 7))) & 1;
+}
+
+// Exact distance from (px, py) to the unit square of source pixel (x, y)
+static float square_distance(float px, float py, int x, int y) {
+   float dx = px < x ? x - px : px > x + 1 ? px - (x + 1) : 0.0f;
+   float dy = py < y ? y - py : py > y + 1 ? py - (y + 1) : 0.0f;
+   return sqrtf(dx * dx + dy * dy);
+}
+
+void sdf_generate_glyph(const uint8_t *bits, int stride, int width, int height,
+                        int scale, uint8_t *out) {
+   int cell_w = SDF_CELL_SIZE(width, scale);
+   int cell_h = SDF_CELL_SIZE(height, scale);
+   float spread = (float)SDF_SPREAD / scale; // In source pixels
+   int reach = (int)ceilf(spread) + 1;
+
+   for (int sy = 0; sy < cell_h; sy++) {
+      for (int sx = 0; sx < cell_w; sx++) {
+         // Sample centre in source pixel coordinates
+         float px = (sx - SDF_SPREAD + 0.5f) / scale;
+         float py = (sy - SDF_SPREAD + 0.5f) / scale;
+         int cx = (int)floorf(px), cy = (int)floorf(py);
+         int inside = glyph_bit(bits, stride, width, height, cx, cy);
+
+         // Nearest pixel of the opposite state within the encoded range
+         float best = spread;
+         for (int y = cy - reach; y <= cy + reach; y++) {
+            for (int x = cx - reach; x <= cx + reach; x++) {
+               if (glyph_bit(bits, stride, width, height, x, y) == inside)
+                  continue;
+               float d = square_distance(px, py, x, y);
+               if (d < best)
+                  best = d;
+            }
+         }
+         float signed_dist = inside ? best : -best;
+         int v = SDF_EDGE + (int)lrintf(signed_dist / spread * 127.0f);
+         out[sy * cell_w + sx] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+   }
+}
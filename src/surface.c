@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include "surface.h"
+#include "simd.h"
+
+void surface_init(struct surface *s, uint16_t *pixels, int pitch, int width, int height) {
+   memset(s, 0, sizeof(*s));
+   s->pixels = pixels;
+   s->pitch = pitch;
+   s->width = width;
+   s->height = height;
+   s->clip.x1 = width;
+   s->clip.y1 = height;
+}
+
+bool surface_alloc(struct surface *s, int width, int height) {
+   memset(s, 0, sizeof(*s));
+   if (width <= 0 || height <= 0)
+      return false;
+   uint16_t *pixels = calloc((size_t)width * height, sizeof(*pixels));
+   if (!pixels)
+      return false;
+   surface_init(s, pixels, width, width, height);
+   s->owned = true;
+   return true;
+}
+
+void surface_free(struct surface *s) {
+   if (s->owned)
+      free(s->pixels);
+   memset(s, 0, sizeof(*s));
+}
+
+bool surface_push_scissor(struct surface *s, int x, int y, int width, int height) {
+   if (s->depth == SURFACE_SCISSOR_DEPTH)
+      return false;
+   s->saved[s->depth++] = s->clip;
+   struct surface_rect *c = &s->clip;
+   // Widen before adding so huge rectangles cannot overflow
+   long long x1 = (long long)x + width, y1 = (long long)y + height;
+   if (c->x0 < x) c->x0 = x;
+   if (c->y0 < y) c->y0 = y;
+   if (c->x1 > x1) c->x1 = (int)x1;
+   if (c->y1 > y1) c->y1 = (int)y1;
+   // Rectangles off the surface leave an empty scissor still inside it
+   if (c->x0 > s->width) c->x0 = s->width;
+   if (c->y0 > s->height) c->y0 = s->height;
+   if (c->x1 < 0) c->x1 = 0;
+   if (c->y1 < 0) c->y1 = 0;
+   // Empty scissors keep x0 <= x1 so spans computed from them stay empty
+   if (c->x1 < c->x0) c->x1 = c->x0;
+   if (c->y1 < c->y0) c->y1 = c->y0;
+   return true;
+}
+
+void surface_pop_scissor(struct surface *s) {
+   if (s->depth > 0)
+      s->clip = s->saved[--s->depth];
+}
+
+bool surface_clip(const struct surface *s, int x, int y, int width, int height,
+                  struct surface_rect *out) {
+   const struct surface_rect *c = &s->clip;
+   long long x1 = (long long)x + width, y1 = (long long)y + height;
+   out->x0 = x > c->x0 ? x : c->x0;
+   out->y0 = y > c->y0 ? y : c->y0;
+   out->x1 = x1 < c->x1 ? (int)x1 : c->x1;
+   out->y1 = y1 < c->y1 ? (int)y1 : c->y1;
+   return out->x0 < out->x1 && out->y0 < out->y1;
+}
+
+void surface_clear(const struct surface *s, uint16_t color) {
+   const struct surface_rect *c = &s->clip;
+   int count = c->x1 - c->x0;
+   for (int y = c->y0; y < c->y1; y++) {
+      uint16_t *dst = surface_row(s, y) + c->x0;
+      int i = 0;
+#ifdef HAVE_SSE2
+      const __m128i v = _mm_set1_epi16((short)color);
+      for (; i + 8 <= count; i += 8)
+         _mm_storeu_si128((__m128i *)(dst + i), v);
+#endif
+      for (; i < count; i++)
+         dst[i] = color;
+   }
+}
+
+void surface_blit(const struct surface *dst, const struct surface *src, int x, int y) {
+   struct surface_rect r;
+   if (!surface_clip(dst, x, y, src->width, src->height, &r))
+      return;
+   for (int row = r.y0; row < r.y1; row++)
+      memcpy(surface_row(dst, row) + r.x0, surface_row(src, row - y) + r.x0 - x,
+             (size_t)(r.x1 - r.x0) * sizeof(uint16_t));
+}
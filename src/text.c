@@ -0,0 +1,185 @@
+#include <string.h>
+#include "text.h"
+#include "core_log.h"
+#include "utf8.h"
+
+// Codepoint -> glyph resolution cache (open addressing, linear probing).
+// Each entry records where the fallback chain landed, so lookups through
+// the selected font, the built-in font and missing-glyph handling all
+// happen once per codepoint rather than once per drawn character.
+#define GLYPH_CACHE_SIZE 1024
+#define GLYPH_CACHE_MAX_USED (GLYPH_CACHE_SIZE * 3 / 4)
+
+struct glyph_cache_slot {
+   uint32_t key;               // codepoint + 1, 0 marks a free slot
+   const struct font *font;
+   int glyph;                  // -1 when nothing could be drawn
+};
+
+static const struct font *current_font;
+static unsigned font_generation;
+static struct glyph_cache_slot glyph_cache[GLYPH_CACHE_SIZE];
+static unsigned glyph_cache_used;
+
+// Codepoints already reported missing. Kept apart from the cache, which is
+// cleared when it fills up, so text with many distinct codepoints does not
+// repeat the warning every frame.
+static uint8_t missing_reported[(0x10FFFF >> 3) + 1];
+
+static void glyph_cache_clear(void) {
+   memset(glyph_cache, 0, sizeof(glyph_cache));
+   glyph_cache_used = 0;
+}
+
+void text_set_font(const struct font *font) {
+   current_font = font;
+   font_generation++;
+   glyph_cache_clear();
+}
+
+unsigned text_font_generation(void) {
+   return font_generation;
+}
+
+const struct font *text_font(void) {
+   return current_font ? current_font : font_builtin();
+}
+
+// Clip the trimmed glyph box once instead of testing every pixel; false
+// when nothing of the glyph is visible
+static bool clip_glyph(const struct font_glyph_box *box, int x, int y,
+                       const struct surface_rect *clip, int *gx0, int *gy0, int *gx1, int *gy1) {
+   if (box->y0 > box->y1)
+      return false; // Blank glyph
+   *gy0 = box->y0; *gy1 = box->y1;
+   *gx0 = box->x0; *gx1 = box->x1;
+   if (y + *gy0 < clip->y0) *gy0 = clip->y0 - y;
+   if (y + *gy1 >= clip->y1) *gy1 = clip->y1 - 1 - y;
+   if (x + *gx0 < clip->x0) *gx0 = clip->x0 - x;
+   if (x + *gx1 >= clip->x1) *gx1 = clip->x1 - 1 - x;
+   return *gy0 <= *gy1 && *gx0 <= *gx1;
+}
+
+static void draw_glyph(const struct surface *dst, int x, int y,
+                       const struct font *font, int glyph, uint16_t color) {
+   int gx0, gy0, gx1, gy1;
+   if (!clip_glyph(&font->boxes[glyph], x, y, &dst->clip, &gx0, &gy0, &gx1, &gy1))
+      return;
+
+   const uint8_t *bits = font_glyph_bits(font, glyph);
+   for (int gy = gy0; gy <= gy1; gy++) {
+      const uint8_t *row = bits + gy * font->stride;
+      uint16_t *out = surface_row(dst, y + gy) + x;
+      for (int gx = gx0; gx <= gx1; gx++) {
+         uint16_t mask = font_row_mask[row[gx >> 3]][gx & 7];
+         out[gx] = (uint16_t)((out[gx] & ~mask) | (color & mask));
+      }
+   }
+}
+
+static void draw_glyph8(uint8_t *fb, int fb_width, int fb_height, int x, int y,
+                        const struct font *font, int glyph, uint8_t index) {
+   const struct surface_rect clip = { 0, 0, fb_width, fb_height };
+   int gx0, gy0, gx1, gy1;
+   if (!clip_glyph(&font->boxes[glyph], x, y, &clip, &gx0, &gy0, &gx1, &gy1))
+      return;
+
+   const uint8_t *bits = font_glyph_bits(font, glyph);
+   for (int gy = gy0; gy <= gy1; gy++) {
+      const uint8_t *row = bits + gy * font->stride;
+      uint8_t *dst = &fb[(y + gy) * fb_width + x];
+      for (int gx = gx0; gx <= gx1; gx++) {
+         uint8_t mask = (uint8_t)font_row_mask[row[gx >> 3]][gx & 7];
+         dst[gx] = (uint8_t)((dst[gx] & ~mask) | (index & mask));
+      }
+   }
+}
+
+// Resolve a codepoint to a font and glyph, logging missing glyphs once
+static const struct glyph_cache_slot *resolve_glyph(uint32_t codepoint) {
+   uint32_t key = codepoint + 1;
+   uint32_t slot = (key * 2654435761u >> 8) & (GLYPH_CACHE_SIZE - 1);
+   while (glyph_cache[slot].key) {
+      if (glyph_cache[slot].key == key)
+         return &glyph_cache[slot];
+      slot = (slot + 1) & (GLYPH_CACHE_SIZE - 1);
+   }
+   if (glyph_cache_used >= GLYPH_CACHE_MAX_USED) {
+      // Rare with real text; starting over keeps probes short
+      glyph_cache_clear();
+      return resolve_glyph(codepoint);
+   }
+
+   struct glyph_cache_slot *entry = &glyph_cache[slot];
+   entry->key = key;
+   glyph_cache_used++;
+
+   const struct font *font = text_font();
+   entry->font = font;
+   entry->glyph = font_find_glyph(font, codepoint);
+   if (entry->glyph >= 0)
+      return entry;
+   if (font != font_builtin()) {
+      entry->font = font_builtin();
+      entry->glyph = font_find_glyph(entry->font, codepoint);
+      if (entry->glyph >= 0)
+         return entry;
+   }
+
+   // Missing everywhere: report it the first time, then draw a replacement
+   // glyph
+   if (codepoint <= 0x10FFFF && !(missing_reported[codepoint >> 3] & (1 << (codepoint & 7)))) {
+      missing_reported[codepoint >> 3] |= (uint8_t)(1 << (codepoint & 7));
+      core_log(RETRO_LOG_WARN, "Missing glyph for U+%04X\n", (unsigned)codepoint);
+   }
+   entry->font = font;
+   entry->glyph = font_find_glyph(font, UTF8_REPLACEMENT);
+   if (entry->glyph < 0) {
+      entry->font = font_builtin();
+      entry->glyph = font_find_glyph(entry->font, '?');
+   }
+   return entry;
+}
+
+bool text_find_glyph(uint32_t codepoint, const struct font **font, int *glyph) {
+   const struct glyph_cache_slot *entry = resolve_glyph(codepoint);
+   *font = entry->font;
+   *glyph = entry->glyph;
+   return entry->glyph >= 0;
+}
+
+void text_draw_char(const struct surface *dst, int x, int y, uint32_t codepoint, uint16_t color) {
+   const struct glyph_cache_slot *entry = resolve_glyph(codepoint);
+   if (entry->glyph >= 0)
+      draw_glyph(dst, x, y, entry->font, entry->glyph, color);
+}
+
+void text_draw_string(const struct surface *dst, int x, int y, const char *str, uint16_t color) {
+   text_draw_span(dst, x, y, str, strlen(str), color);
+}
+
+void text_draw_span(const struct surface *dst, int x, int y, const char *str, size_t len,
+                    uint16_t color) {
+   const uint8_t *p = (const uint8_t *)str;
+   const uint8_t *end = p + len;
+   int advance = text_font()->width;
+   int cx = x;
+   while (p < end) {
+      text_draw_char(dst, cx, y, utf8_decode(&p, end), color);
+      cx += advance;
+   }
+}
+
+void text_draw_span8(uint8_t *fb, int fb_width, int fb_height,
+                     int x, int y, const char *str, size_t len, uint8_t index) {
+   const uint8_t *p = (const uint8_t *)str;
+   const uint8_t *end = p + len;
+   int advance = text_font()->width;
+   int cx = x;
+   while (p < end) {
+      const struct glyph_cache_slot *entry = resolve_glyph(utf8_decode(&p, end));
+      if (entry->glyph >= 0)
+         draw_glyph8(fb, fb_width, fb_height, cx, y, entry->font, entry->glyph, index);
+      cx += advance;
+   }
+}
@@ -0,0 +1,170 @@
+#include <string.h>
+#include "text_aa.h"
+#include "text.h"
+#include "blend.h"
+#include "utf8.h"
+
+// Coverage glyph cache: (font, glyph, size) -> 8-bit coverage bitmap in a
+// fixed pool. When either fills up, or the selected font changes, the
+// whole cache starts over; text on screen is re-rasterized within a frame.
+#define AA_CACHE_SLOTS 1024
+#define AA_CACHE_MAX_USED (AA_CACHE_SLOTS * 3 / 4)
+#define AA_POOL_SIZE (256 * 1024)
+
+struct aa_glyph {
+   const struct font *font;   // NULL marks a free slot
+   int glyph;
+   int size;
+   int width, height;
+   uint32_t offset;           // Coverage bitmap in aa_pool, width * height
+};
+
+static struct aa_glyph aa_cache[AA_CACHE_SLOTS];
+static unsigned aa_cache_used;
+static uint8_t aa_pool[AA_POOL_SIZE];
+static uint32_t aa_pool_used;
+static unsigned aa_generation;
+
+static void aa_cache_clear(void) {
+   memset(aa_cache, 0, sizeof(aa_cache));
+   aa_cache_used = 0;
+   aa_pool_used = 0;
+}
+
+static int aa_glyph_width(const struct font *font, int size) {
+   int width = (font->width * size + font->height / 2) / font->height;
+   if (width > TEXT_AA_MAX_SIZE * 2)
+      width = TEXT_AA_MAX_SIZE * 2;
+   return width > 0 ? width : 1;
+}
+
+// Area-average n_in samples into n_out samples, for any ratio
+static void resample_area(const float *in, int n_in, int in_step,
+                          float *out, int n_out, int out_step) {
+   float scale = (float)n_in / n_out;
+   for (int o = 0; o < n_out; o++) {
+      float x0 = o * scale, x1 = x0 + scale;
+      float sum = 0.0f;
+      for (int i = (int)x0; i < n_in && i < x1; i++) {
+         float lo = i > x0 ? (float)i : x0;
+         float hi = i + 1 < x1 ? (float)(i + 1) : x1;
+         sum += in[i * in_step] * (hi - lo);
+      }
+      out[o * out_step] = sum / scale;
+   }
+}
+
+// Resample a 1bpp glyph into an 8-bit coverage bitmap of width x height
+static void rasterize_coverage(const struct font *font, int glyph,
+                               uint8_t *out, int width, int height) {
+   static float src[FONT_MAX_SIZE * FONT_MAX_SIZE];
+   static float tmp[FONT_MAX_SIZE * TEXT_AA_MAX_SIZE * 2];
+   static float dst[TEXT_AA_MAX_SIZE * TEXT_AA_MAX_SIZE * 2];
+   const uint8_t *bits = font_glyph_bits(font, glyph);
+   int sw = font->width, sh = font->height;
+
+   for (int y = 0; y < sh; y++) {
+      const uint8_t *row = bits + y * font->stride;
+      for (int x = 0; x < sw; x++)
+         src[y * sw + x] = (row[x >> 3] & (0x80 >> (x & 7))) ? 1.0f : 0.0f;
+   }
+   // Separable: rows first (sh x width), then columns (height x width)
+   for (int y = 0; y < sh; y++)
+      resample_area(src + y * sw, sw, 1, tmp + y * width, width, 1);
+   for (int x = 0; x < width; x++)
+      resample_area(tmp + x, sh, width, dst + x, height, width);
+   for (int i = 0; i < width * height; i++) {
+      float v = dst[i] * 255.0f + 0.5f;
+      out[i] = (uint8_t)(v > 255.0f ? 255.0f : v);
+   }
+}
+
+static const struct aa_glyph *aa_lookup(const struct font *font, int glyph, int size) {
+   if (aa_generation != text_font_generation()) {
+      aa_generation = text_font_generation();
+      aa_cache_clear();
+   }
+   uint32_t hash = ((uint32_t)glyph * 2654435761u) ^ ((uint32_t)size * 40503u);
+   uint32_t slot = (hash >> 6) & (AA_CACHE_SLOTS - 1);
+   while (aa_cache[slot].font) {
+      struct aa_glyph *entry = &aa_cache[slot];
+      if (entry->font == font && entry->glyph == glyph && entry->size == size)
+         return entry;
+      slot = (slot + 1) & (AA_CACHE_SLOTS - 1);
+   }
+
+   int width = aa_glyph_width(font, size);
+   uint32_t bytes = (uint32_t)(width * size);
+   if (bytes > AA_POOL_SIZE)
+      return NULL;
+   if (aa_cache_used >= AA_CACHE_MAX_USED || aa_pool_used + bytes > AA_POOL_SIZE) {
+      aa_cache_clear();
+      return aa_lookup(font, glyph, size);
+   }
+
+   struct aa_glyph *entry = &aa_cache[slot];
+   entry->font = font;
+   entry->glyph = glyph;
+   entry->size = size;
+   entry->width = width;
+   entry->height = size;
+   entry->offset = aa_pool_used;
+   aa_pool_used += bytes;
+   aa_cache_used++;
+   rasterize_coverage(font, glyph, aa_pool + entry->offset, width, size);
+   return entry;
+}
+
+static void blend_glyph(const struct surface *dst, int x, int y,
+                        const struct aa_glyph *g, uint16_t color) {
+   const struct surface_rect *c = &dst->clip;
+   int gx0 = 0, gy0 = 0, gx1 = g->width, gy1 = g->height;
+   if (x + gx0 < c->x0) gx0 = c->x0 - x;
+   if (y + gy0 < c->y0) gy0 = c->y0 - y;
+   if (x + gx1 > c->x1) gx1 = c->x1 - x;
+   if (y + gy1 > c->y1) gy1 = c->y1 - y;
+   if (gx0 >= gx1 || gy0 >= gy1)
+      return;
+   const uint8_t *coverage = aa_pool + g->offset;
+   for (int gy = gy0; gy < gy1; gy++)
+      blend565_coverage_span(surface_row(dst, y + gy) + x + gx0,
+                             coverage + gy * g->width + gx0, color, gx1 - gx0);
+}
+
+void text_aa_draw_string(const struct surface *dst, int x, int y, const char *str, int size,
+                         uint16_t color) {
+   if (size <= 0)
+      return;
+   if (size > TEXT_AA_MAX_SIZE)
+      size = TEXT_AA_MAX_SIZE;
+   const uint8_t *p = (const uint8_t *)str;
+   const uint8_t *end = p + strlen(str);
+   int advance = aa_glyph_width(text_font(), size);
+   int cx = x;
+   while (p < end) {
+      const struct font *font;
+      int glyph;
+      if (text_find_glyph(utf8_decode(&p, end), &font, &glyph) &&
+          font->boxes[glyph].y0 <= font->boxes[glyph].y1) {
+         const struct aa_glyph *g = aa_lookup(font, glyph, size);
+         if (g)
+            blend_glyph(dst, cx, y, g, color);
+      }
+      cx += advance;
+   }
+}
+
+int text_aa_string_width(const char *str, int size) {
+   if (size <= 0)
+      return 0;
+   if (size > TEXT_AA_MAX_SIZE)
+      size = TEXT_AA_MAX_SIZE;
+   const uint8_t *p = (const uint8_t *)str;
+   const uint8_t *end = p + strlen(str);
+   int count = 0;
+   while (p < end) {
+      utf8_decode(&p, end);
+      count++;
+   }
+   return count * aa_glyph_width(text_font(), size);
+}
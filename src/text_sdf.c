@@ -0,0 +1,212 @@
+#include <math.h>
+#include <string.h>
+#include "text_sdf.h"
+#include "text.h"
+#include "blend.h"
+#include "sdf.h"
+#include "simd.h"
+#include "utf8.h"
+
+// Distance fields of loaded-font glyphs, generated lazily into a fixed
+// pool and dropped wholesale when full or when the selected font changes
+#define SDF_CACHE_SLOTS 1024
+#define SDF_CACHE_MAX_USED (SDF_CACHE_SLOTS * 3 / 4)
+#define SDF_POOL_SIZE (1024 * 1024)
+
+// Widest destination span of one glyph, padding included
+#define SDF_MAX_SPAN (TEXT_SDF_MAX_SIZE * 4)
+
+// Widest field row: a FONT_MAX_SIZE-wide, one-row-high loaded font gets the
+// full SDF_TARGET_HEIGHT scale
+#define SDF_MAX_CELL_W (SDF_CELL_SIZE(FONT_MAX_SIZE, SDF_TARGET_HEIGHT) + 1)
+
+struct sdf_glyph {
+   const struct font *font;   // NULL marks a free slot
+   int glyph;
+   uint32_t offset;           // Field in sdf_pool
+};
+
+// A glyph's distance field and its geometry
+struct sdf_view {
+   const uint8_t *field;
+   int cell_w, cell_h;
+   int scale;                 // Samples per font pixel
+};
+
+static struct sdf_glyph sdf_cache[SDF_CACHE_SLOTS];
+static unsigned sdf_cache_used;
+static uint8_t sdf_pool[SDF_POOL_SIZE];
+static uint32_t sdf_pool_used;
+static unsigned sdf_generation;
+
+static void sdf_cache_clear(void) {
+   memset(sdf_cache, 0, sizeof(sdf_cache));
+   sdf_cache_used = 0;
+   sdf_pool_used = 0;
+}
+
+static bool sdf_lookup(const struct font *font, int glyph, struct sdf_view *view) {
+   if (font == font_builtin()) {
+      view->field = font_8x8_sdf[glyph];
+      view->cell_w = view->cell_h = FONT_SDF_CELL;
+      view->scale = FONT_SDF_SCALE;
+      return true;
+   }
+
+   if (sdf_generation != text_font_generation()) {
+      sdf_generation = text_font_generation();
+      sdf_cache_clear();
+   }
+   view->scale = sdf_scale_for_height(font->height);
+   view->cell_w = SDF_CELL_SIZE(font->width, view->scale);
+   view->cell_h = SDF_CELL_SIZE(font->height, view->scale);
+
+   uint32_t slot = ((uint32_t)glyph * 2654435761u >> 6) & (SDF_CACHE_SLOTS - 1);
+   while (sdf_cache[slot].font) {
+      if (sdf_cache[slot].font == font && sdf_cache[slot].glyph == glyph) {
+         view->field = sdf_pool + sdf_cache[slot].offset;
+         return true;
+      }
+      slot = (slot + 1) & (SDF_CACHE_SLOTS - 1);
+   }
+
+   uint32_t bytes = (uint32_t)(view->cell_w * view->cell_h);
+   if (bytes > SDF_POOL_SIZE)
+      return false;
+   if (sdf_cache_used >= SDF_CACHE_MAX_USED || sdf_pool_used + bytes > SDF_POOL_SIZE) {
+      sdf_cache_clear();
+      return sdf_lookup(font, glyph, view);
+   }
+   struct sdf_glyph *entry = &sdf_cache[slot];
+   entry->font = font;
+   entry->glyph = glyph;
+   entry->offset = sdf_pool_used;
+   sdf_pool_used += bytes;
+   sdf_cache_used++;
+   sdf_generate_glyph(font_glyph_bits(font, glyph), font->stride, font->width, font->height,
+                      view->scale, sdf_pool + entry->offset);
+   view->field = sdf_pool + entry->offset;
+   return true;
+}
+
+// Linear interpolation between two field rows: out = a + (b - a) * t
+static void lerp_rows(const uint8_t *a, const uint8_t *b, float t, float *out, int count) {
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 vt = _mm_set1_ps(t);
+   for (; i + 4 <= count; i += 4) {
+      int32_t wa, wb;
+      memcpy(&wa, a + i, 4);
+      memcpy(&wb, b + i, 4);
+      __m128 fa = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(wa), zero), zero));
+      __m128 fb = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(wb), zero), zero));
+      _mm_storeu_ps(out + i, _mm_add_ps(fa, _mm_mul_ps(_mm_sub_ps(fb, fa), vt)));
+   }
+#endif
+   for (; i < count; i++)
+      out[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+// Map distances to 8-bit coverage: clamp((d - edge) * k + 0.5, 0, 1) * 255.
+// The SSE2 path relies on the saturating packs for the clamp.
+static void threshold_span(const float *dist, uint8_t *coverage, int count, float k) {
+   const float scale = k * 255.0f;
+   const float bias = 127.5f - SDF_EDGE * scale;
+   int i = 0;
+#ifdef HAVE_SSE2
+   const __m128 vscale = _mm_set1_ps(scale);
+   const __m128 vbias = _mm_set1_ps(bias);
+   for (; i + 8 <= count; i += 8) {
+      __m128i lo = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dist + i), vscale), vbias));
+      __m128i hi = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dist + i + 4), vscale), vbias));
+      __m128i packed = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+      _mm_storel_epi64((__m128i *)(coverage + i), packed);
+   }
+#endif
+   for (; i < count; i++) {
+      float v = dist[i] * scale + bias;
+      coverage[i] = (uint8_t)(v <= 0.0f ? 0 : v >= 255.0f ? 255 : (int)(v + 0.5f));
+   }
+}
+
+// Render one glyph whose unpadded box spans size pixels vertically with its
+// top-left corner at (x, y)
+static void draw_sdf_glyph(const struct surface *dst, int x, int y,
+                           const struct font *font, const struct sdf_view *view,
+                           int size, uint16_t color) {
+   static int col_index[SDF_MAX_SPAN];
+   static float col_frac[SDF_MAX_SPAN];
+   static float row_dist[SDF_MAX_CELL_W];
+   static float span_dist[SDF_MAX_SPAN];
+   static uint8_t coverage[SDF_MAX_SPAN];
+
+   // Destination pixels per field sample, and the padded destination box
+   float ratio = (float)size / (font->height * view->scale);
+   int pad = (int)ceilf(SDF_SPREAD * ratio);
+   int width = (font->width * size + font->height / 2) / font->height;
+   int dx0 = -pad, dx1 = width + pad;
+   int dy0 = -pad, dy1 = size + pad;
+   const struct surface_rect *c = &dst->clip;
+   if (x + dx0 < c->x0) dx0 = c->x0 - x;
+   if (y + dy0 < c->y0) dy0 = c->y0 - y;
+   if (x + dx1 > c->x1) dx1 = c->x1 - x;
+   if (y + dy1 > c->y1) dy1 = c->y1 - y;
+   if (dx1 - dx0 > SDF_MAX_SPAN) dx1 = dx0 + SDF_MAX_SPAN;
+   if (dx0 >= dx1 || dy0 >= dy1)
+      return;
+
+   // Horizontal sample positions are the same for every row
+   float inv = 1.0f / ratio;
+   int first = view->cell_w, last = 0;
+   for (int dx = dx0; dx < dx1; dx++) {
+      float s = (dx + 0.5f) * inv + SDF_SPREAD - 0.5f;
+      if (s < 0.0f) s = 0.0f;
+      if (s > view->cell_w - 1.001f) s = view->cell_w - 1.001f;
+      int i = (int)s;
+      col_index[dx - dx0] = i;
+      col_frac[dx - dx0] = s - i;
+      if (first > i) first = i;
+      if (last < i + 1) last = i + 1;
+   }
+
+   // Smooth over roughly one destination pixel
+   float k = (float)SDF_SPREAD / 127.0f * ratio;
+   for (int dy = dy0; dy < dy1; dy++) {
+      float s = (dy + 0.5f) * inv + SDF_SPREAD - 0.5f;
+      if (s < 0.0f) s = 0.0f;
+      if (s > view->cell_h - 1.001f) s = view->cell_h - 1.001f;
+      int row = (int)s;
+      const uint8_t *a = view->field + row * view->cell_w;
+      lerp_rows(a + first, a + view->cell_w + first, s - row, row_dist, last - first + 1);
+      for (int i = 0; i < dx1 - dx0; i++) {
+         const float *d = row_dist + col_index[i] - first;
+         span_dist[i] = d[0] + (d[1] - d[0]) * col_frac[i];
+      }
+      threshold_span(span_dist, coverage, dx1 - dx0, k);
+      blend565_coverage_span(surface_row(dst, y + dy) + x + dx0, coverage, color, dx1 - dx0);
+   }
+}
+
+void text_sdf_draw_string(const struct surface *dst, int x, int y, const char *str, int size,
+                          uint16_t color) {
+   if (size <= 0)
+      return;
+   if (size > TEXT_SDF_MAX_SIZE)
+      size = TEXT_SDF_MAX_SIZE;
+   const struct font *selected = text_font();
+   int advance = (selected->width * size + selected->height / 2) / selected->height;
+   const uint8_t *p = (const uint8_t *)str;
+   const uint8_t *end = p + strlen(str);
+   int cx = x;
+   while (p < end) {
+      const struct font *font;
+      int glyph;
+      struct sdf_view view;
+      if (text_find_glyph(utf8_decode(&p, end), &font, &glyph) &&
+          font->boxes[glyph].y0 <= font->boxes[glyph].y1 &&
+          sdf_lookup(font, glyph, &view))
+         draw_sdf_glyph(dst, cx, y, font, &view, size, color);
+      cx += advance;
+   }
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tilemap.h"
+#include "font.h"
+#include "simd.h"
+
+#define TILE_PIXELS (TILEMAP_TILE * TILEMAP_TILE)
+// Expanded tiles cached across maps, direct mapped
+#define TILE_CACHE_SLOTS 1024
+
+struct cached_tile {
+   const uint8_t *pattern;   // NULL if the slot is empty
+   uint16_t fg, bg;
+   uint16_t pixels[TILE_PIXELS];
+};
+
+static struct cached_tile tile_cache[TILE_CACHE_SLOTS];
+
+bool tilemap_init(struct tilemap *map, int width, int height,
+                  const uint8_t (*patterns)[8], int pattern_count,
+                  int view_width, int view_height) {
+   memset(map, 0, sizeof(*map));
+   if (width <= 0 || height <= 0 || pattern_count <= 0 || view_width <= 0 || view_height <= 0)
+      return false;
+   map->width = width;
+   map->height = height;
+   map->patterns = patterns;
+   map->pattern_count = pattern_count;
+   map->view_width = view_width;
+   map->view_height = view_height;
+   // One spare tile each way holds the partly visible edge while scrolling
+   map->layer_columns = (view_width + TILEMAP_TILE - 1) / TILEMAP_TILE + 1;
+   map->layer_rows = (view_height + TILEMAP_TILE - 1) / TILEMAP_TILE + 1;
+   size_t cells = (size_t)width * height;
+   size_t layer_tiles = (size_t)map->layer_columns * map->layer_rows;
+   map->cells = calloc(cells, sizeof(*map->cells));
+   map->dirty = malloc(cells);
+   map->layer = malloc(layer_tiles * TILE_PIXELS * sizeof(*map->layer));
+   map->layer_cells = malloc(layer_tiles * sizeof(*map->layer_cells));
+   if (!map->cells || !map->dirty || !map->layer || !map->layer_cells) {
+      tilemap_free(map);
+      return false;
+   }
+   memset(map->dirty, 1, cells);
+   for (size_t i = 0; i < layer_tiles; i++)
+      map->layer_cells[i] = -1;
+   for (int i = 0; i < TILEMAP_PALETTES; i++) {
+      map->colors[i][0] = 0xFFFF;
+      map->colors[i][1] = 0x0000;
+   }
+   return true;
+}
+
+void tilemap_free(struct tilemap *map) {
+   // Drop cached tiles of this pattern set in case its storage is reused
+   for (int i = 0; i < TILE_CACHE_SLOTS; i++)
+      if (map->patterns && tile_cache[i].pattern >= map->patterns[0] &&
+          tile_cache[i].pattern < map->patterns[0] + (size_t)map->pattern_count * 8)
+         tile_cache[i].pattern = NULL;
+   free(map->cells);
+   free(map->dirty);
+   free(map->layer);
+   free(map->layer_cells);
+   memset(map, 0, sizeof(*map));
+}
+
+static inline int wrap(int v, int size) {
+   v %= size;
+   return v < 0 ? v + size : v;
+}
+
+void tilemap_set(struct tilemap *map, int x, int y, uint16_t cell) {
+   size_t i = (size_t)wrap(y, map->height) * map->width + wrap(x, map->width);
+   if (map->cells[i] != cell) {
+      map->cells[i] = cell;
+      map->dirty[i] = 1;
+   }
+}
+
+void tilemap_set_colors(struct tilemap *map, int palette, uint16_t fg, uint16_t bg) {
+   if (palette < 0 || palette >= TILEMAP_PALETTES)
+      return;
+   if (map->colors[palette][0] == fg && map->colors[palette][1] == bg)
+      return;
+   map->colors[palette][0] = fg;
+   map->colors[palette][1] = bg;
+   size_t cells = (size_t)map->width * map->height;
+   for (size_t i = 0; i < cells; i++)
+      if (TILEMAP_CELL_PALETTE(map->cells[i]) == palette)
+         map->dirty[i] = 1;
+}
+
+// Expanded pixels of a pattern in fg/bg, from the cache or built into it
+static const uint16_t *expand_tile(const uint8_t *pattern, uint16_t fg, uint16_t bg) {
+   uintptr_t key = (uintptr_t)pattern / 8 * 31 + fg * 7 + bg;
+   struct cached_tile *slot = &tile_cache[key % TILE_CACHE_SLOTS];
+   if (slot->pattern == pattern && slot->fg == fg && slot->bg == bg)
+      return slot->pixels;
+   slot->pattern = pattern;
+   slot->fg = fg;
+   slot->bg = bg;
+#ifdef HAVE_SSE2
+   const __m128i vfg = _mm_set1_epi16((short)fg), vbg = _mm_set1_epi16((short)bg);
+   for (int row = 0; row < TILEMAP_TILE; row++) {
+      __m128i mask = _mm_loadu_si128((const __m128i *)font_row_mask[pattern[row]]);
+      __m128i px = _mm_or_si128(_mm_and_si128(mask, vfg), _mm_andnot_si128(mask, vbg));
+      _mm_storeu_si128((__m128i *)&slot->pixels[row * TILEMAP_TILE], px);
+   }
+#else
+   for (int row = 0; row < TILEMAP_TILE; row++) {
+      const uint16_t *mask = font_row_mask[pattern[row]];
+      for (int col = 0; col < TILEMAP_TILE; col++)
+         slot->pixels[row * TILEMAP_TILE + col] = (uint16_t)((mask[col] & fg) | (~mask[col] & bg));
+   }
+#endif
+   return slot->pixels;
+}
+
+static void draw_layer_tile(struct tilemap *map, int column, int row, int32_t cell) {
+   uint16_t value = map->cells[cell];
+   int tile = TILEMAP_CELL_TILE(value);
+   if (tile >= map->pattern_count)
+      tile = 0;
+   const uint16_t *colors = map->colors[TILEMAP_CELL_PALETTE(value)];
+   const uint16_t *src = expand_tile(map->patterns[tile], colors[0], colors[1]);
+   int pitch = map->layer_columns * TILEMAP_TILE;
+   uint16_t *dst = &map->layer[(size_t)row * TILEMAP_TILE * pitch + column * TILEMAP_TILE];
+   for (int y = 0; y < TILEMAP_TILE; y++)
+      memcpy(&dst[y * pitch], &src[y * TILEMAP_TILE], TILEMAP_TILE * sizeof(*dst));
+   map->layer_cells[row * map->layer_columns + column] = cell;
+   map->redrawn++;
+}
+
+void tilemap_render(struct tilemap *map, const struct surface *dst, int scroll_x, int scroll_y) {
+   if (!map->layer)
+      return;
+   int sx = wrap(scroll_x, map->width * TILEMAP_TILE);
+   int sy = wrap(scroll_y, map->height * TILEMAP_TILE);
+   int first_x = sx / TILEMAP_TILE, first_y = sy / TILEMAP_TILE;
+   map->redrawn = 0;
+
+   // Map tile first_x + i always lands in layer column (first_x + i) % columns,
+   // so tiles that stay in view keep their place and need no redraw
+   for (int j = 0; j < map->layer_rows; j++) {
+      int my = (first_y + j) % map->height;
+      int row = (first_y + j) % map->layer_rows;
+      for (int i = 0; i < map->layer_columns; i++) {
+         int mx = (first_x + i) % map->width;
+         int column = (first_x + i) % map->layer_columns;
+         int32_t cell = my * map->width + mx;
+         if (map->dirty[cell] || map->layer_cells[row * map->layer_columns + column] != cell)
+            draw_layer_tile(map, column, row, cell);
+      }
+   }
+   // Clear flags afterwards: a small map can show one cell several times
+   for (int j = 0; j < map->layer_rows; j++)
+      for (int i = 0; i < map->layer_columns; i++)
+         map->dirty[((first_y + j) % map->height) * map->width + (first_x + i) % map->width] = 0;
+
+   // Copy the scissored part of the view out of the wrapping layer, in up
+   // to two runs per row
+   struct surface_rect r;
+   if (!surface_clip(dst, 0, 0, map->view_width, map->view_height, &r))
+      return;
+   int layer_width = map->layer_columns * TILEMAP_TILE;
+   int layer_height = map->layer_rows * TILEMAP_TILE;
+   int width = r.x1 - r.x0;
+   int x0 = (sx + r.x0) % layer_width;
+   int first_run = layer_width - x0 < width ? layer_width - x0 : width;
+   for (int y = r.y0; y < r.y1; y++) {
+      const uint16_t *src = &map->layer[(size_t)((sy + y) % layer_height) * layer_width];
+      uint16_t *out = surface_row(dst, y) + r.x0;
+      memcpy(out, src + x0, first_run * sizeof(*out));
+      if (first_run < width)
+         memcpy(out + first_run, src, (width - first_run) * sizeof(*out));
+   }
+}
@@ -0,0 +1,230 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "voxel.h"
+#include "core_log.h"
+#include "workers.h"
+
+// Added before truncating sample coordinates so negative positions round
+// down too; a multiple of every map size, so it vanishes in the wrap mask
+#define COORD_BIAS 1048576.0f
+
+struct voxel_job {
+   uint16_t *fb;
+   int fb_width, fb_height;
+   const struct voxel_map *map;
+   const struct voxel_view *view;
+   uint16_t sky;
+   float dir_x, dir_y;        // View direction
+   float plane_x, plane_y;    // Half the screen width, at distance 1
+};
+
+static bool little_endian(void) {
+   const uint16_t probe = 1;
+   return *(const uint8_t *)&probe == 1;
+}
+
+bool voxel_map_load(struct voxel_map *map, const char *path) {
+   memset(map, 0, sizeof(*map));
+   if (!mapfile_open(&map->file, path)) {
+      core_log(RETRO_LOG_ERROR, "Failed to map terrain file: %s\n", path);
+      return false;
+   }
+   const uint8_t *data = map->file.data;
+   if (map->file.size < VOXEL_HEADER_SIZE || memcmp(data, VOXEL_MAGIC, 8) != 0) {
+      core_log(RETRO_LOG_ERROR, "Not a terrain file: %s\n", path);
+      voxel_map_free(map);
+      return false;
+   }
+   int width_log2 = data[8], height_log2 = data[9];
+   if (width_log2 < 1 || width_log2 > VOXEL_MAX_LOG2 || height_log2 < 1 || height_log2 > VOXEL_MAX_LOG2) {
+      core_log(RETRO_LOG_ERROR, "Unsupported terrain size: %s\n", path);
+      voxel_map_free(map);
+      return false;
+   }
+   size_t samples = (size_t)1 << (width_log2 + height_log2);
+   if (map->file.size < VOXEL_HEADER_SIZE + samples * 3) {
+      core_log(RETRO_LOG_ERROR, "Truncated terrain file: %s\n", path);
+      voxel_map_free(map);
+      return false;
+   }
+
+   map->width_log2 = width_log2;
+   map->height_log2 = height_log2;
+   map->heights = data + VOXEL_HEADER_SIZE;
+   const uint8_t *colors = data + VOXEL_HEADER_SIZE + samples;
+   if (little_endian()) {
+      // Even offset into a page-aligned mapping, so already aligned
+      map->colors = (const uint16_t *)colors;
+   } else {
+      uint16_t *swapped = malloc(samples * sizeof(*swapped));
+      if (!swapped) {
+         voxel_map_free(map);
+         return false;
+      }
+      for (size_t i = 0; i < samples; i++)
+         swapped[i] = (uint16_t)(colors[i * 2] | colors[i * 2 + 1] << 8);
+      map->owned = swapped;
+      map->colors = swapped;
+   }
+   core_log(RETRO_LOG_INFO, "Loaded terrain %s: %dx%d\n", path, 1 << width_log2, 1 << height_log2);
+   return true;
+}
+
+void voxel_map_free(struct voxel_map *map) {
+   mapfile_close(&map->file);
+   free(map->owned);
+   memset(map, 0, sizeof(*map));
+}
+
+static uint32_t next_random(uint32_t *state) {
+   *state ^= *state << 13;
+   *state ^= *state >> 17;
+   *state ^= *state << 5;
+   return *state;
+}
+
+static uint16_t pack565(int r, int g, int b) {
+   r = r < 0 ? 0 : r > 255 ? 255 : r;
+   g = g < 0 ? 0 : g > 255 ? 255 : g;
+   b = b < 0 ? 0 : b > 255 ? 255 : b;
+   return (uint16_t)((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+}
+
+bool voxel_map_generate(struct voxel_map *map, int size_log2, uint32_t seed) {
+   memset(map, 0, sizeof(*map));
+   if (size_log2 < 2 || size_log2 > VOXEL_MAX_LOG2)
+      return false;
+   const int n = 1 << size_log2, mask = n - 1;
+   const size_t samples = (size_t)n * n;
+   int32_t *h = malloc(samples * sizeof(*h));
+   uint8_t *storage = malloc(samples * 3);
+   if (!h || !storage) {
+      free(h);
+      free(storage);
+      return false;
+   }
+   uint32_t state = seed ? seed : 1;
+#define AT(x, y) h[((y) & mask) * n + ((x) & mask)]
+
+   // Diamond-square on a wrapping grid, so the terrain tiles seamlessly
+   h[0] = 0;
+   int amplitude = 1 << 16;
+   for (int step = n; step > 1; step /= 2) {
+      int half = step / 2;
+      for (int y = 0; y < n; y += step)
+         for (int x = 0; x < n; x += step)
+            AT(x + half, y + half) = (AT(x, y) + AT(x + step, y) + AT(x, y + step) + AT(x + step, y + step)) / 4 +
+                                     (int32_t)(next_random(&state) % (2 * amplitude + 1)) - amplitude;
+      for (int y = 0; y < n; y += half)
+         for (int x = (y / half) % 2 ? 0 : half; x < n; x += step)
+            AT(x, y) = (AT(x - half, y) + AT(x + half, y) + AT(x, y - half) + AT(x, y + half)) / 4 +
+                       (int32_t)(next_random(&state) % (2 * amplitude + 1)) - amplitude;
+      amplitude = amplitude * 9 / 16;
+   }
+
+   int32_t lo = h[0], hi = h[0];
+   for (size_t i = 1; i < samples; i++) {
+      if (lo > h[i]) lo = h[i];
+      if (hi < h[i]) hi = h[i];
+   }
+   uint8_t *heights = storage;
+   uint16_t *colors = (uint16_t *)(storage + samples);
+   for (size_t i = 0; i < samples; i++)
+      heights[i] = (uint8_t)((int64_t)(h[i] - lo) * 255 / (hi > lo ? hi - lo : 1));
+
+   // Colour by altitude band, lit from the north-west by the local slope
+   const int water = 70;
+   for (int y = 0; y < n; y++) {
+      for (int x = 0; x < n; x++) {
+         int v = heights[y * n + x];
+         int slope = v - heights[((y - 1) & mask) * n + ((x - 1) & mask)];
+         int light = 256 + slope * 24;
+         int r, g, b;
+         if (v <= water) {
+            r = 30; g = 70 + v / 2; b = 150 + v / 2;
+            light = 256;
+         } else if (v < water + 8) {
+            r = 200; g = 185; b = 130;
+         } else if (v < 150) {
+            r = 50 + (v - water) / 2; g = 130 - (v - water) / 4; b = 40;
+         } else if (v < 205) {
+            r = 120; g = 110; b = 100;
+         } else {
+            r = 235; g = 235; b = 240;
+         }
+         colors[y * n + x] = pack565(r * light >> 8, g * light >> 8, b * light >> 8);
+      }
+   }
+   // Flatten water so it renders as a level surface
+   for (size_t i = 0; i < samples; i++)
+      if (heights[i] < water)
+         heights[i] = (uint8_t)water;
+#undef AT
+   free(h);
+
+   map->heights = heights;
+   map->colors = colors;
+   map->width_log2 = map->height_log2 = size_log2;
+   map->owned = storage;
+   return true;
+}
+
+int voxel_height_at(const struct voxel_map *map, float x, float y) {
+   uint32_t sx = (uint32_t)(int32_t)(x + COORD_BIAS) & ((1u << map->width_log2) - 1);
+   uint32_t sy = (uint32_t)(int32_t)(y + COORD_BIAS) & ((1u << map->height_log2) - 1);
+   return map->heights[sy << map->width_log2 | sx];
+}
+
+static void render_columns(void *ctx, int begin, int end) {
+   const struct voxel_job *job = ctx;
+   const struct voxel_view *view = job->view;
+   const uint8_t *heights = job->map->heights;
+   const uint16_t *colors = job->map->colors;
+   const int width_log2 = job->map->width_log2;
+   const uint32_t u_mask = (1u << width_log2) - 1;
+   const uint32_t v_mask = (1u << job->map->height_log2) - 1;
+   const int width = job->fb_width;
+
+   for (int x = begin; x < end; x++) {
+      float t = 2.0f * (x + 0.5f) / width - 1.0f;
+      float ray_x = job->dir_x + job->plane_x * t, ray_y = job->dir_y + job->plane_y * t;
+      uint16_t *dst = &job->fb[x];
+      int visible = job->fb_height;   // Rows [0, visible) are still open
+
+      // Front to back with a step that grows with distance, since far
+      // samples cover less of the screen
+      float z = 1.0f, dz = 0.5f;
+      while (z < view->distance && visible > 0) {
+         uint32_t u = (uint32_t)(int32_t)(view->x + ray_x * z + COORD_BIAS) & u_mask;
+         uint32_t v = (uint32_t)(int32_t)(view->y + ray_y * z + COORD_BIAS) & v_mask;
+         uint32_t sample = v << width_log2 | u;
+         int top = (int)((view->altitude - heights[sample]) / z * view->scale + view->horizon);
+         if (top < visible) {
+            if (top < 0)
+               top = 0;
+            uint16_t c = colors[sample];
+            for (int y = top; y < visible; y++)
+               dst[y * width] = c;
+            visible = top;
+         }
+         z += dz;
+         dz += 0.01f;
+      }
+      for (int y = 0; y < visible; y++)
+         dst[y * width] = job->sky;
+   }
+}
+
+void voxel_render(uint16_t *fb, int fb_width, int fb_height,
+                  const struct voxel_map *map, const struct voxel_view *view, uint16_t sky) {
+   if (!map->heights)
+      return;
+   float dir_x = cosf(view->angle), dir_y = sinf(view->angle);
+   float half = tanf(view->fov * 0.5f);
+   struct voxel_job job = {
+      fb, fb_width, fb_height, map, view, sky,
+      dir_x, dir_y, -dir_y * half, dir_x * half,
+   };
+   workers_run(render_columns, &job, fb_width);
+}
@@ -0,0 +1,165 @@
+#include "workers.h"
+#include "cpu.h"
+#include "core_log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+#define mutex_init(m)   InitializeCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+#define mutex_lock(m)   EnterCriticalSection(m)
+#define mutex_unlock(m) LeaveCriticalSection(m)
+#define cond_init(c)    InitializeConditionVariable(c)
+#define cond_destroy(c) ((void)(c))
+#define cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+#define mutex_init(m)   pthread_mutex_init(m, NULL)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m)   pthread_mutex_lock(m)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+#define cond_init(c)    pthread_cond_init(c, NULL)
+#define cond_destroy(c) pthread_cond_destroy(c)
+#define cond_wait(c, m) pthread_cond_wait(c, m)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+static thread_t threads[WORKERS_MAX];
+static int thread_count = 1;     // Including the caller
+static bool running;
+
+// Current job, published under lock with a new generation number
+static mutex_t lock;
+static cond_t job_ready;
+static cond_t job_done;
+static unsigned generation;
+static int pending;
+static bool quitting;
+static workers_fn job_fn;
+static void *job_ctx;
+static int job_total;
+
+static void run_share(int index) {
+   int begin = (int)((long long)job_total * index / thread_count);
+   int end = (int)((long long)job_total * (index + 1) / thread_count);
+   if (begin < end)
+      job_fn(job_ctx, begin, end);
+}
+
+static void worker_loop(int index) {
+   unsigned seen = 0;
+   mutex_lock(&lock);
+   for (;;) {
+      while (!quitting && generation == seen)
+         cond_wait(&job_ready, &lock);
+      if (quitting)
+         break;
+      seen = generation;
+      mutex_unlock(&lock);
+      run_share(index);
+      mutex_lock(&lock);
+      if (--pending == 0)
+         cond_broadcast(&job_done);
+   }
+   mutex_unlock(&lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+   worker_loop((int)(intptr_t)arg);
+   return 0;
+}
+#else
+static void *worker_main(void *arg) {
+   worker_loop((int)(intptr_t)arg);
+   return NULL;
+}
+#endif
+
+void workers_init(int count) {
+   workers_shutdown();
+   if (count <= 0)
+      count = cpu_count();
+   if (count > WORKERS_MAX)
+      count = WORKERS_MAX;
+   thread_count = 1;
+   if (count <= 1)
+      return;
+
+   mutex_init(&lock);
+   cond_init(&job_ready);
+   cond_init(&job_done);
+   quitting = false;
+   generation = 0;
+   running = true;
+   for (int i = 1; i < count; i++) {
+#ifdef _WIN32
+      threads[i] = CreateThread(NULL, 0, worker_main, (LPVOID)(intptr_t)i, 0, NULL);
+      bool ok = threads[i] != NULL;
+#else
+      bool ok = pthread_create(&threads[i], NULL, worker_main, (void *)(intptr_t)i) == 0;
+#endif
+      if (!ok) {
+         core_log(RETRO_LOG_WARN, "Failed to start worker thread %d\n", i);
+         break;
+      }
+      thread_count++;
+   }
+   core_log(RETRO_LOG_INFO, "Worker threads: %d\n", thread_count);
+}
+
+void workers_shutdown(void) {
+   if (!running)
+      return;
+   mutex_lock(&lock);
+   quitting = true;
+   cond_broadcast(&job_ready);
+   mutex_unlock(&lock);
+   for (int i = 1; i < thread_count; i++) {
+#ifdef _WIN32
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+#else
+      pthread_join(threads[i], NULL);
+#endif
+   }
+   cond_destroy(&job_done);
+   cond_destroy(&job_ready);
+   mutex_destroy(&lock);
+   running = false;
+   thread_count = 1;
+}
+
+int workers_count(void) {
+   return thread_count;
+}
+
+void workers_run(workers_fn fn, void *ctx, int total) {
+   if (total <= 0)
+      return;
+   if (thread_count == 1) {
+      fn(ctx, 0, total);
+      return;
+   }
+   mutex_lock(&lock);
+   job_fn = fn;
+   job_ctx = ctx;
+   job_total = total;
+   pending = thread_count - 1;
+   generation++;
+   cond_broadcast(&job_ready);
+   mutex_unlock(&lock);
+
+   run_share(0);
+
+   mutex_lock(&lock);
+   while (pending > 0)
+      cond_wait(&job_done, &lock);
+   mutex_unlock(&lock);
+}
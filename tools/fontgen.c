@@ -0,0 +1,105 @@
+// Build-time generator for the core's font tables.
+//
+// Usage: fontgen <output.c>
+//
+// Emits a single translation unit holding font_8x8, the per-glyph bounding
+// boxes and the byte-to-pixel-mask table declared in include/font.h, so the
+// core never decodes glyph bits or scans for empty rows at run time. The
+// signed distance field atlas used for scalable text is generated here too.
+#include <stdio.h>
+#include <stdint.h>
+#include "font.h"
+#include "sdf.h"
+
+#if FONT_SDF_SCALE != SDF_TARGET_HEIGHT / 8
+#error "FONT_SDF_SCALE must match sdf_scale_for_height(8)"
+#endif
+
+static const uint8_t font_src[FONT_GLYPH_COUNT][8] = {
+#include "font_8x8.inc"
+};
+
+static void emit_font(FILE *out) {
+   fprintf(out, "const uint8_t font_8x8[FONT_GLYPH_COUNT][8] = {\n");
+   for (int g = 0; g < FONT_GLYPH_COUNT; g++) {
+      fprintf(out, "   {");
+      for (int row = 0; row < 8; row++)
+         fprintf(out, "0x%02X%s", font_src[g][row], row < 7 ? ", " : "");
+      fprintf(out, "}, // %d\n", g + 32);
+   }
+   fprintf(out, "};\n\n");
+}
+
+static void emit_boxes(FILE *out) {
+   fprintf(out, "const struct font_glyph_box font_8x8_box[FONT_GLYPH_COUNT] = {\n");
+   for (int g = 0; g < FONT_GLYPH_COUNT; g++) {
+      int x0 = 8, y0 = 8, x1 = -1, y1 = -1;
+      for (int row = 0; row < 8; row++) {
+         uint8_t bits = font_src[g][row];
+         if (!bits)
+            continue;
+         if (y0 > row) y0 = row;
+         y1 = row;
+         for (int col = 0; col < 8; col++) {
+            if (bits & (0x80 >> col)) {
+               if (x0 > col) x0 = col;
+               if (x1 < col) x1 = col;
+            }
+         }
+      }
+      // Empty glyphs keep y0 > y1; clamp into uint8_t range
+      if (y1 < 0) {
+         x0 = 1; y0 = 1;
+         x1 = 0; y1 = 0;
+      }
+      fprintf(out, "   {%d, %d, %d, %d}, // %d\n", x0, y0, x1, y1, g + 32);
+   }
+   fprintf(out, "};\n\n");
+}
+
+static void emit_row_masks(FILE *out) {
+   fprintf(out, "const uint16_t font_row_mask[256][8] = {\n");
+   for (int b = 0; b < 256; b++) {
+      fprintf(out, "   {");
+      for (int col = 0; col < 8; col++)
+         fprintf(out, "0x%s%s", (b & (0x80 >> col)) ? "FFFF" : "0000", col < 7 ? ", " : "");
+      fprintf(out, "},\n");
+   }
+   fprintf(out, "};\n\n");
+}
+
+static void emit_sdf(FILE *out) {
+   static uint8_t cell[FONT_SDF_CELL * FONT_SDF_CELL];
+   fprintf(out, "const uint8_t font_8x8_sdf[FONT_GLYPH_COUNT][FONT_SDF_CELL * FONT_SDF_CELL] = {\n");
+   for (int g = 0; g < FONT_GLYPH_COUNT; g++) {
+      sdf_generate_glyph(font_src[g], 1, 8, 8, FONT_SDF_SCALE, cell);
+      fprintf(out, "   { // %d", g + 32);
+      for (int i = 0; i < FONT_SDF_CELL * FONT_SDF_CELL; i++)
+         fprintf(out, "%s%d,", i % FONT_SDF_CELL ? "" : "\n      ", cell[i]);
+      fprintf(out, "\n   },\n");
+   }
+   fprintf(out, "};\n");
+}
+
+int main(int argc, char **argv) {
+   if (argc != 2) {
+      fprintf(stderr, "usage: %s <output.c>\n", argv[0]);
+      return 1;
+   }
+   FILE *out = fopen(argv[1], "w");
+   if (!out) {
+      fprintf(stderr, "[ERROR] fontgen: failed to open %s\n", argv[1]);
+      return 1;
+   }
+   fprintf(out, "// Generated by tools/fontgen.c - do not edit.\n");
+   fprintf(out, "#include \"font.h\"\n\n");
+   emit_font(out);
+   emit_boxes(out);
+   emit_row_masks(out);
+   emit_sdf(out);
+   if (fclose(out) != 0) {
+      fprintf(stderr, "[ERROR] fontgen: failed to write %s\n", argv[1]);
+      return 1;
+   }
+   return 0;
+}